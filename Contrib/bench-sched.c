@@ -0,0 +1,142 @@
+/*
+ * Scheduling latency benchmark for ExpressOS.
+ *
+ * A UI thread at THREAD_PRIORITY_DISPLAY (nice -4) wakes up periodically
+ * while CPU-bound background threads at THREAD_PRIORITY_BACKGROUND
+ * (nice 10) keep every CPU busy. The delay between the due time and the
+ * actual wakeup of the UI thread is reported in microseconds.
+ *
+ * The second part measures how fast two threads hand a token over when
+ * they spin on it with sched_yield(), like Dalvik does on contended
+ * locks.
+ *
+ * Build it with the Android toolchain and run it from the boot manifest:
+ *
+ *   process /data/bench-sched [-n] [background threads]
+ *
+ * -n leaves every thread at nice 0, as a baseline.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define UI_NICE                 (-4)
+#define BACKGROUND_NICE         10
+#define UI_PERIOD_US            4000
+#define UI_SAMPLES              500
+#define HANDOFF_ROUNDS          2000
+#define MAX_BACKGROUND          16
+
+static volatile int stop;
+static volatile int token;
+static int use_nice = 1;
+
+static long long now_us(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void set_nice(int nice)
+{
+        if (use_nice)
+                setpriority(PRIO_PROCESS, syscall(__NR_gettid), nice);
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+        long long x = *(const long long *)a, y = *(const long long *)b;
+        return x < y ? -1 : x > y;
+}
+
+static void *background(void *arg)
+{
+        volatile unsigned long n = 0;
+        (void)arg;
+
+        set_nice(BACKGROUND_NICE);
+        while (!stop)
+                ++n;
+
+        return NULL;
+}
+
+static void *ui(void *arg)
+{
+        long long *lat = arg;
+        int i;
+
+        set_nice(UI_NICE);
+        for (i = 0; i < UI_SAMPLES; ++i) {
+                struct timespec ts = { 0, UI_PERIOD_US * 1000 };
+                long long due = now_us() + UI_PERIOD_US;
+                nanosleep(&ts, NULL);
+                lat[i] = now_us() - due;
+                if (lat[i] < 0)
+                        lat[i] = 0;
+        }
+        return NULL;
+}
+
+static void *handoff(void *arg)
+{
+        int self = (int)(long)arg;
+        int i;
+
+        for (i = 0; i < HANDOFF_ROUNDS; ++i) {
+                while (token != self)
+                        sched_yield();
+                token = !self;
+        }
+        return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+        pthread_t bg[MAX_BACKGROUND], thr[2];
+        long long lat[UI_SAMPLES], start, elapsed;
+        int nbg = 4, i;
+
+        for (i = 1; i < argc; ++i) {
+                if (!strcmp(argv[i], "-n"))
+                        use_nice = 0;
+                else
+                        nbg = atoi(argv[i]);
+        }
+        if (nbg < 0 || nbg > MAX_BACKGROUND)
+                nbg = MAX_BACKGROUND;
+
+        for (i = 0; i < nbg; ++i)
+                pthread_create(&bg[i], NULL, background, NULL);
+
+        pthread_create(&thr[0], NULL, ui, lat);
+        pthread_join(thr[0], NULL);
+
+        qsort(lat, UI_SAMPLES, sizeof(lat[0]), cmp_ll);
+        printf("bench,sched-ui-wakeup,nice=%d,background=%d,p50=%lld,p99=%lld,max=%lld\n",
+               use_nice, nbg, lat[UI_SAMPLES / 2], lat[UI_SAMPLES * 99 / 100],
+               lat[UI_SAMPLES - 1]);
+
+        start = now_us();
+        pthread_create(&thr[0], NULL, handoff, (void *)0L);
+        pthread_create(&thr[1], NULL, handoff, (void *)1L);
+        pthread_join(thr[0], NULL);
+        pthread_join(thr[1], NULL);
+        elapsed = now_us() - start;
+
+        printf("bench,sched-yield-handoff,background=%d,rounds=%d,us=%lld\n",
+               nbg, HANDOFF_ROUNDS, elapsed);
+
+        stop = 1;
+        for (i = 0; i < nbg; ++i)
+                pthread_join(bg[i], NULL);
+
+        return 0;
+}
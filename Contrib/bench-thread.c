@@ -0,0 +1,61 @@
+/*
+ * Thread creation benchmark for ExpressOS.
+ *
+ * Creates and joins short-lived pthreads back to back, the pattern of
+ * apps that hand small jobs to fresh worker threads, and reports the
+ * throughput. With the thread pool of the kernel, all but the first
+ * batch reuse parked L4 threads.
+ *
+ * Build it with the Android toolchain and run it from the boot manifest:
+ *
+ *   process /data/bench-thread [threads per batch]
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define ROUNDS          200
+#define MAX_BATCH       16
+
+static long long now_us(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void *worker(void *arg)
+{
+        return arg;
+}
+
+int main(int argc, char *argv[])
+{
+        pthread_t thr[MAX_BATCH];
+        long long start, elapsed;
+        int batch = 4, i, j;
+
+        if (argc > 1)
+                batch = atoi(argv[1]);
+        if (batch < 1 || batch > MAX_BATCH)
+                batch = MAX_BATCH;
+
+        start = now_us();
+        for (i = 0; i < ROUNDS; ++i) {
+                for (j = 0; j < batch; ++j) {
+                        if (pthread_create(&thr[j], NULL, worker, NULL)) {
+                                printf("bench-thread: pthread_create failed at round %d\n", i);
+                                return 1;
+                        }
+                }
+
+                for (j = 0; j < batch; ++j)
+                        pthread_join(thr[j], NULL);
+        }
+        elapsed = now_us() - start;
+
+        printf("bench,pthread-create-join,threads=%d,us=%lld,per-thread-us=%lld\n",
+               ROUNDS * batch, elapsed, elapsed / (ROUNDS * batch));
+        return 0;
+}
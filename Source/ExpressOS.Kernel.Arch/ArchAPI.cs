@@ -35,16 +35,24 @@ namespace ExpressOS.Kernel.Arch
             faultType = ((pfa & WRITE_BIT) != 0) ? L4FPage.L4_FPAGE_FAULT_WRITE : L4FPage.L4_FPAGE_FAULT_READ;
         }
 
-        public static void ReturnFromPageFault(L4Handle target, out Msgtag tag, ref MessageRegisters mr, uint pfa, Pointer physicalPage, uint permssion)
+        public static void ReturnFromPageFault(L4Handle target, out Msgtag tag, ref MessageRegisters mr, uint pfa, Pointer physicalPage, uint permssion, int pageShift)
         {
-            var virt_page_addr = ArchDefinition.PageIndex(physicalPage.ToUInt32());
-            var fpage = new L4FPage(virt_page_addr, ArchDefinition.PageShift, (int)permssion);
+            // Both the page and the faulting address are aligned to the size of the mapping
+            var mask = ~((1U << pageShift) - 1);
+            var virt_page_addr = physicalPage.ToUInt32() & mask;
+            var fpage = new L4FPage(virt_page_addr, pageShift, (int)permssion);
             tag = new Msgtag(0, 0, 1, 0);
-            mr.mr0 = (int)(ArchDefinition.PageIndex(pfa) | Msgtag.L4_ITEM_MAP);
+            mr.mr0 = (int)((pfa & mask) | Msgtag.L4_ITEM_MAP);
             mr.mr1 = (int)fpage.raw;
             NativeMethods.l4api_ipc_send(target, NativeMethods.l4api_utcb(), tag, Timeout.Never);
         }
 
+        /* Reply to a page fault whose handling has been deferred */
+        public static unsafe void ReturnFromPageFault(L4Handle target, uint pfa, Pointer physicalPage, uint permssion, int pageShift)
+        {
+            Msgtag tag;
+            ReturnFromPageFault(target, out tag, ref *NativeMethods.l4api_utcb_mr(), pfa, physicalPage, permssion, pageShift);
+        }
 
     }
 }
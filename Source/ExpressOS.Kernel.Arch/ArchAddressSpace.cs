@@ -33,5 +33,11 @@ namespace ExpressOS.Kernel.Arch
             return new ArchAddressSpace(handle, utcb_start, utcb_size_log2);
         }
 
+        /* Delete the task, which drops all of its mappings */
+        public void Destroy()
+        {
+            NativeMethods.l4api_delete_task(_value);
+        }
+
     }
 }
@@ -7,6 +7,9 @@ namespace ExpressOS.Kernel.Arch
         public const int PageShift = 12;
         public const int PageSize = 1 << PageShift;
         public const int PageIndexMask = ~(PageSize - 1);
+        public const int SuperPageShift = 22;
+        public const int SuperPageSize = 1 << SuperPageShift;
+        public const int SuperPageIndexMask = ~(SuperPageSize - 1);
         public const int UTCBOffset = PageSize;
         public const int UTCBSizeShift = PageShift;
         public const int MaxThreadPerTaskLog2 = 5;
@@ -24,6 +24,7 @@ namespace ExpressOS.Kernel.Arch
                 ArchDefinition.Panic();
 
             LinuxServerTid = param.LinuxServerTid;
+            Trace.Initialize();
         }
     }
 }
@@ -29,6 +29,11 @@ namespace ExpressOS.Kernel.Arch
             NativeMethods.l4api_start_thread(_value.thread, ip, sp);
         }
 
+        public int SetPriority(int priority)
+        {
+            return NativeMethods.l4api_set_priority(_value.thread, priority);
+        }
+
         public void Destroy()
         {
             NativeMethods.l4api_delete_thread(_value);
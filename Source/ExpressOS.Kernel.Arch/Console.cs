@@ -3,21 +3,86 @@ namespace ExpressOS.Kernel.Arch
 {
     public static class Console
     {
+        /* At most RateLimitBurst rate-limited messages per RateLimitInterval (us) */
+        private const ulong RateLimitInterval = 5000000;
+        private const int RateLimitBurst = 10;
+
+        private static ConsoleBuffer buffer;
+        private static ulong rateLimitBegin;
+        private static int rateLimitPrinted;
+        private static int rateLimitMissed;
+
+        /* The console is in use before anything is initialized */
+        private static ConsoleBuffer Buffer
+        {
+            get
+            {
+                if (buffer == null)
+                    buffer = new ConsoleBuffer(false);
+
+                return buffer;
+            }
+        }
+
         public static void Flush()
         {
+            Buffer.Drain();
             NativeMethods.console_flush();
         }
 
+        /*
+         * Whether a repeated diagnostic message may be printed. It keeps
+         * messages in fault storms from monopolizing the server loop.
+         */
+        public static bool RateLimit()
+        {
+            var now = NativeMethods.l4api_get_system_clock();
+            if (rateLimitBegin == 0 || now - rateLimitBegin >= RateLimitInterval)
+            {
+                if (rateLimitMissed != 0)
+                {
+                    Write("console: ");
+                    Write(rateLimitMissed);
+                    WriteLine(" messages suppressed");
+                }
+
+                rateLimitBegin = now;
+                rateLimitPrinted = 0;
+                rateLimitMissed = 0;
+            }
+
+            if (rateLimitPrinted < RateLimitBurst)
+            {
+                rateLimitPrinted++;
+                return true;
+            }
+
+            rateLimitMissed++;
+            return false;
+        }
+
+        /*
+         * Formatted write through the printf engine of the native side. fmt
+         * can consume up to four 32-bit arguments.
+         */
+        public static unsafe void WriteFormat(string fmt, uint a0, uint a1, uint a2, uint a3)
+        {
+            var s = Util.StringToByteArray(fmt, true);
+            Buffer.Drain();
+            fixed (byte* p = &s[0])
+            {
+                NativeMethods.console_format(p, a0, a1, a2, a3);
+            }
+        }
+
         public static void Write(string s)
         {
-            foreach (var c in s)
-                Write(c);
+            Buffer.Put(s);
         }
 
         public static void Write(ASCIIString s)
         {
-            foreach (var c in s.GetByteString())
-                Write(c);
+            Buffer.Put(s);
         }
 
         public static void WriteLine(string s)
@@ -28,22 +93,19 @@ namespace ExpressOS.Kernel.Arch
 
         public static void Write(char c)
         {
-            NativeMethods.console_putchar(c);
+            Buffer.Put(c);
         }
 
         public static void Write(byte v)
         {
             Write("0x");
-            WriteByte(v);
+            Buffer.PutHex(v, 2);
         }
 
         public static void Write(int v)
         {
             Write("0x");
-            WriteByte(v >> 24);
-            WriteByte((v & 0xff0000) >> 16);
-            WriteByte((v & 0xff00) >> 8);
-            WriteByte(v & 0xff);
+            Buffer.PutHex((uint)v, 8);
         }
 
         public static void Write(bool v)
@@ -54,45 +116,13 @@ namespace ExpressOS.Kernel.Arch
         public static void Write(ulong v)
         {
             Write("0x");
-            WriteIntNoPrefix((uint)(v >> 32));
-            WriteIntNoPrefix((uint)(v & 0xffffffff));
+            Buffer.PutHex(v, 16);
         }
 
         public static void Write(uint v)
         {
             Write("0x");
-            WriteIntNoPrefix(v);
-        }
-
-        private static void WriteIntNoPrefix(uint v)
-        {
-            WriteByte((int)(v >> 24));
-            WriteByte((int)((v & 0xff0000) >> 16));
-            WriteByte((int)((v & 0xff00) >> 8));
-            WriteByte((int)(v & 0xff));
-        }
-
-
-        private static void WriteByte(int b)
-        {
-            WriteHex((b & 0xff) >> 4);
-            WriteHex(b & 0xf);
-        }
-
-        private static void WriteHex(int b)
-        {
-            if (0 <= b && b <= 9)
-            {
-                NativeMethods.console_putchar('0' + b);
-            }
-            else if (10 <= b && b <= 15)
-            {
-                NativeMethods.console_putchar('a' + b - 10);
-            }
-            else
-            {
-                NativeMethods.console_putchar('?');
-            }
+            Buffer.PutHex(v, 8);
         }
 
         public static void WriteLine()
@@ -103,17 +133,8 @@ namespace ExpressOS.Kernel.Arch
 
         public static void Write(long p)
         {
-            ulong v = (ulong)p;
             Write("0x");
-            WriteByte((int)(v >> 56));
-            WriteByte((int)((v >> 48) & 0xff));
-            WriteByte((int)((v >> 40) & 0xff));
-            WriteByte((int)((v >> 32) & 0xff));
-            WriteByte((int)((v >> 24) & 0xff));
-            WriteByte((int)((v >> 16) & 0xff));
-            WriteByte((int)((v >> 8) & 0xff));
-            WriteByte((int)(v & 0xff));
+            Buffer.PutHex((ulong)p, 16);
         }
     }
 }
-
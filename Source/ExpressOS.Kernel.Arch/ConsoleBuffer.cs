@@ -0,0 +1,68 @@
+﻿namespace ExpressOS.Kernel.Arch
+{
+    /*
+     * Line buffer of a console. Characters and numbers are formatted into
+     * the buffer, which is passed to the native side in one call when a
+     * line ends or the buffer fills up.
+     */
+    internal sealed class ConsoleBuffer
+    {
+        private const int Size = 256;
+
+        private readonly byte[] buf;
+        private readonly bool toLinux;
+        private int cursor;
+
+        internal ConsoleBuffer(bool toLinux)
+        {
+            this.buf = new byte[Size];
+            this.toLinux = toLinux;
+            this.cursor = 0;
+        }
+
+        internal void Put(char c)
+        {
+            if (cursor == buf.Length)
+                Drain();
+
+            buf[cursor++] = (byte)c;
+        }
+
+        internal void Put(string s)
+        {
+            foreach (var c in s)
+                Put(c);
+        }
+
+        internal void Put(ASCIIString s)
+        {
+            foreach (var c in s.GetByteString())
+                Put((char)c);
+        }
+
+        /* Hexadecimal with the given number of digits, without prefix */
+        internal void PutHex(ulong v, int digits)
+        {
+            for (var i = digits - 1; i >= 0; --i)
+            {
+                var d = (int)((v >> (i * 4)) & 0xf);
+                Put((char)(d < 10 ? '0' + d : 'a' + d - 10));
+            }
+        }
+
+        internal unsafe void Drain()
+        {
+            if (cursor == 0)
+                return;
+
+            fixed (byte* p = &buf[0])
+            {
+                if (toLinux)
+                    NativeMethods.linux_console_write(p, cursor);
+                else
+                    NativeMethods.console_write(p, cursor);
+            }
+            cursor = 0;
+        }
+    }
+}
@@ -14,11 +14,13 @@ namespace ExpressOS.Kernel.Arch
 
         private static Msgtag l4_ipc_send(L4Handle dest, Msgtag tag, Timeout timeout)
         {
+            Trace.Log(Trace.Event.IPCSend, dest._value, (uint)tag.Label, (uint)GetMR(0));
             return NativeMethods.l4api_ipc_send(dest, NativeMethods.l4api_utcb(), tag, timeout);
         }
 
         private static Msgtag l4_stub_ipc_call(L4Handle dest, Msgtag tag, Timeout timeout)
         {
+            Trace.Log(Trace.Event.IPCCall, dest._value, (uint)tag.Label, (uint)GetMR(0));
             return NativeMethods.l4api_ipc_call(dest, NativeMethods.l4api_utcb(), tag, timeout);
         }
 
@@ -30,6 +32,21 @@ namespace ExpressOS.Kernel.Arch
         public const int MAX_MR = 62;
         private const int SIZEOF_STAT64 = 96;
 
+        /*
+         * Ops that older helpers do not implement. The kernel only sends
+         * them when the boot manifest says that the helper has them, see
+         * BootManifest, and falls back to the synchronous ops otherwise.
+         */
+        public const int OPTIONAL_SENDTO_ASYNC = 1;
+        public const int OPTIONAL_MMSG_ASYNC = 2;
+        public const int OPTIONAL_GET_USER_PAGES_ASYNC = 4;
+        public static int OptionalOps;
+
+        public static bool HasOptionalOp(int op)
+        {
+            return (OptionalOps & op) != 0;
+        }
+
         public enum Type
         {
             EXPRESSOS_OP_TAKE_HELPER = 2,
@@ -70,6 +87,10 @@ namespace ExpressOS.Kernel.Arch
             EXPRESSOS_OP_BINDER_WRITE_READ,
             EXPRESSOS_OP_WRITE_APP_INFO,
             EXPRESSOS_OP_CONSOLE_WRITE,
+            EXPRESSOS_OP_SENDTO_ASYNC,
+            EXPRESSOS_OP_SENDMMSG_ASYNC,
+            EXPRESSOS_OP_RECVMMSG_ASYNC,
+            EXPRESSOS_OP_GET_USER_PAGES_ASYNC,
             EXPRESSOS_OP_DOWNCALL_COUNT,
         };
 
@@ -477,6 +498,63 @@ namespace ExpressOS.Kernel.Arch
             return GetMR(1);
         }
 
+        /*
+         * The payload is at the beginning of buf, followed by the address.
+         */
+        public static int SendtoAsync(int helper_pid, uint handle, Pointer buf, int sockfd, int len, int flags, int addrlen)
+        {
+            SetMR(0, (int)Type.EXPRESSOS_OP_SENDTO_ASYNC);
+            SetMR(1, helper_pid);
+            SetMR(2, handle);
+            SetMR(3, RelativeBufferPos(buf));
+            SetMR(4, sockfd);
+            SetMR(5, len);
+            SetMR(6, flags);
+            SetMR(7, addrlen);
+
+            var tag = new Msgtag((int)IPCTag.EXPRESSOS_IPC, 8, 0, 0);
+            var res = l4_ipc_send(ArchGlobals.LinuxServerTid, tag, Timeout.Never);
+            return l4_stub_ipc_error(res) != 0 ? -1 : 0;
+        }
+
+        /*
+         * buf holds vlen records of the form
+         *
+         *   int name_size, payload_size, name_len, payload_len, msg_flags
+         *   name[name_size], payload[payload_size] (both padded to 4 bytes)
+         *
+         * The helper fills in name_len, payload_len and msg_flags of every
+         * message it has handled, and replies with the number of messages.
+         * payload_len is the length of the datagram, which exceeds
+         * payload_size if it was truncated.
+         */
+        public static int SendmmsgAsync(int helper_pid, uint handle, Pointer buf, int sockfd, int vlen, int flags)
+        {
+            return MmsgAsync((int)Type.EXPRESSOS_OP_SENDMMSG_ASYNC, helper_pid, handle, buf, sockfd, vlen, flags, -1);
+        }
+
+        /* timeout is the timeout of recvmmsg() in milliseconds, -1 for none */
+        public static int RecvmmsgAsync(int helper_pid, uint handle, Pointer buf, int sockfd, int vlen, int flags, int timeout)
+        {
+            return MmsgAsync((int)Type.EXPRESSOS_OP_RECVMMSG_ASYNC, helper_pid, handle, buf, sockfd, vlen, flags, timeout);
+        }
+
+        private static int MmsgAsync(int type, int helper_pid, uint handle, Pointer buf, int sockfd, int vlen, int flags, int timeout)
+        {
+            SetMR(0, type);
+            SetMR(1, helper_pid);
+            SetMR(2, handle);
+            SetMR(3, RelativeBufferPos(buf));
+            SetMR(4, sockfd);
+            SetMR(5, vlen);
+            SetMR(6, flags);
+            SetMR(7, timeout);
+
+            var tag = new Msgtag((int)IPCTag.EXPRESSOS_IPC, 8, 0, 0);
+            var res = l4_ipc_send(ArchGlobals.LinuxServerTid, tag, Timeout.Never);
+            return l4_stub_ipc_error(res) != 0 ? -1 : 0;
+        }
+
         public static int Shutdown(int helper_pid, int sockfd, int how)
         {
             SetMR(0, (int)Type.EXPRESSOS_OP_SHUTDOWN);
@@ -527,7 +605,19 @@ namespace ExpressOS.Kernel.Arch
         {
             Contract.Requires(addresses.Length + 2 <= MAX_MR);
             
-            var len = addresses.Length;
+            return linux_sys_free_linux_pages(addresses, addresses.Length);
+        }
+
+        /*
+         * The offsets of the pages are passed in the IPC buffer, thus a
+         * single message can free as many pages as the buffer holds. It is
+         * a call, as the next request may overwrite the buffer once Linux
+         * has answered, but not before.
+         */
+        public static int linux_sys_free_linux_pages(Pointer[] addresses, int len)
+        {
+            Contract.Requires(len >= 0 && len <= addresses.Length);
+            Contract.Requires(len * sizeof(int) <= ArchGlobals.LinuxIPCBuffer.Length);
 
             SetMR(0, (int)Type.EXPRESSOS_OP_FREE_LINUX_PAGE);
             SetMR(1, len);
@@ -536,7 +626,7 @@ namespace ExpressOS.Kernel.Arch
                 Deserializer.WriteInt(addresses[i] - ArchGlobals.LinuxMainMemoryStart, ArchGlobals.LinuxIPCBuffer, i * sizeof(int));
 
             var tag = new Msgtag((int)IPCTag.EXPRESSOS_IPC, 2, 0, 0);
-            var res = l4_ipc_send(ArchGlobals.LinuxServerTid, tag, Timeout.Never);
+            var res = l4_stub_ipc_call(ArchGlobals.LinuxServerTid, tag, Timeout.Never);
             return l4_stub_ipc_error(res) != 0 ? -1 : 0;
         }
 
@@ -558,6 +648,26 @@ namespace ExpressOS.Kernel.Arch
             return ArchGlobals.LinuxMainMemoryStart + relative_pos;
         }
 
+        /*
+         * Grab npages consecutive pages of the helper starting from
+         * shadowAddress. Linux writes the offset of each page into buf, or -1
+         * if it cannot grab the page, and completes handle afterwards.
+         */
+        public static int linux_sys_get_user_pages_async(int helper_pid, uint handle, Pointer buf, uint faultType, Pointer shadowAddress, int npages)
+        {
+            SetMR(0, (int)Type.EXPRESSOS_OP_GET_USER_PAGES_ASYNC);
+            SetMR(1, helper_pid);
+            SetMR(2, handle);
+            SetMR(3, RelativeBufferPos(buf));
+            SetMR(4, faultType & L4FPage.L4_FPAGE_FAULT_WRITE);
+            SetMR(5, shadowAddress.ToUInt32());
+            SetMR(6, npages);
+
+            var tag = new Msgtag((int)IPCTag.EXPRESSOS_IPC, 7, 0, 0);
+            var res = l4_ipc_send(ArchGlobals.LinuxServerTid, tag, Timeout.Never);
+            return l4_stub_ipc_error(res) != 0 ? -1 : 0;
+        }
+
         public static uint linux_sys_alien_mmap2(int helper_pid, Pointer addr, int length, int prot, int flags, int fd, int pgoffset)
         {
             SetMR(0, (int)Type.EXPRESSOS_OP_ALIEN_MMAP2);
@@ -10,19 +10,40 @@ namespace ExpressOS.Kernel.Arch
         internal static extern int console_putchar(int c);
         [DllImport("glue")]
         internal static extern void console_flush();
+        [DllImport("glue")]
+        internal static unsafe extern void console_write(byte* s, int len);
+        [DllImport("glue")]
+        internal static unsafe extern int console_format(byte* fmt, uint a0, uint a1, uint a2, uint a3);
+        [DllImport("glue")]
+        internal static extern void trace_event(int e, uint thread, uint a0, uint a1, uint a2, uint a3);
+        [DllImport("glue")]
+        internal static extern int trace_drain();
 
         //[DllImport("glue")]
         //internal static extern int linux_console_putchar(int c);
         //[DllImport("glue")]
         //internal static extern void linux_console_flush();
         internal static int linux_console_putchar(int c) { return 0; }
-        internal static void linux_console_flush() { }
+        //[DllImport("glue")]
+        //internal static unsafe extern void linux_console_write(byte* s, int len);
+
+        /*
+         * The console of L4Linux is not wired up, so the reports written to
+         * the LinuxConsole (the profile, zpage and pool statistics) go to
+         * the kernel console instead of being dropped.
+         */
+        internal static unsafe void linux_console_write(byte* s, int len) { console_write(s, len); }
+        internal static void linux_console_flush() { console_flush(); }
 
         [DllImport("glue")]
         public static extern IntPtr l4api_tls_array_alloc();
         [DllImport("glue")]
         public static extern void l4api_tls_array_free(IntPtr tls);
         [DllImport("glue")]
+        public static extern IntPtr l4api_tls_array_clone(L4Handle thread_id, IntPtr src);
+        [DllImport("glue")]
+        public static extern void l4api_tls_slab_grow(Pointer page);
+        [DllImport("glue")]
         public static extern int l4api_set_thread_area(L4Handle thread_id, IntPtr tls_array, int idx,
             ref userdesc info, int can_allocate);
 
@@ -31,13 +52,23 @@ namespace ExpressOS.Kernel.Arch
         [DllImport("glue")]
         internal static extern L4Handle l4api_create_task(byte[] name, Pointer utcb_area, int utcb_log2_size);
         [DllImport("glue")]
+        internal static extern int l4api_delete_task(L4Handle task);
+        [DllImport("glue")]
         internal static extern int l4api_create_thread(Pointer utcb, L4Handle parent, out ThreadInfo info);
         [DllImport("glue")]
         internal static extern void l4api_delete_thread(ThreadInfo info);
         [DllImport("glue")]
         internal static extern int l4api_start_thread(L4Handle thread, Pointer ip, Pointer sp);
         [DllImport("glue")]
+        internal static extern int l4api_set_priority(L4Handle thread, int priority);
+        [DllImport("glue")]
         public static extern void l4api_flush_regions(L4Handle l4Handle, Pointer StartAddress, Pointer End, int unmap_rights);
+        [DllImport("glue")]
+        public static extern void l4api_gather_flush(L4Handle l4Handle, Pointer StartAddress, Pointer End, int unmap_rights);
+        [DllImport("glue")]
+        public static extern void l4api_map_range(L4Handle l4Handle, Pointer KernelStart, Pointer UserStart, int size, int rights);
+        [DllImport("glue")]
+        public static extern void l4api_gather_finish();
 
         // L4-specific calls;
         [DllImport("glue")]
@@ -0,0 +1,50 @@
+﻿namespace ExpressOS.Kernel.Arch
+{
+    /*
+     * Binary trace of kernel events. The records are kept unformatted in a
+     * ring of the native glue, and Linux drains them for offline decoding
+     * (see expressos/trace.h).
+     */
+    public static class Trace
+    {
+        /* Keep in sync with expressos/trace.h */
+        public enum Event
+        {
+            SyscallEnter = 1,
+            SyscallExit,
+            PageFault,
+            Completion,
+            IPCSend,
+            IPCCall,
+            TimerExpire,
+            SyscallArgs,
+            ThreadCreate,
+            Map,
+        }
+
+        public static bool Enable;
+
+        public static void Initialize()
+        {
+            Enable = false;
+        }
+
+        public static void Log(Event e, uint thread, uint a0, uint a1, uint a2, uint a3)
+        {
+            if (!Enable)
+                return;
+
+            NativeMethods.trace_event((int)e, thread, a0, a1, a2, a3);
+        }
+
+        public static void Log(Event e, uint thread, uint a0, uint a1)
+        {
+            Log(e, thread, a0, a1, 0, 0);
+        }
+
+        public static int Drain()
+        {
+            return NativeMethods.trace_drain();
+        }
+    }
+}
@@ -48,8 +48,10 @@ namespace ExpressOS.Kernel
         public const int ENOLCK = 37;
         public const int ENOSYS = 38;
         public const int ENOTEMPTY = 39;
+        public const int ELOOP = 40;
         public const int EWOULDBLOCK = EAGAIN;
         public const int ENOTSOCK = 88;
+        public const int EMSGSIZE = 90;   /* Message too long */
         public const int ENOBUFS = 105;
         public const int ETIMEDOUT = 110;
         public int Code;
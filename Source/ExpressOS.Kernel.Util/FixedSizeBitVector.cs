@@ -34,6 +34,20 @@ namespace ExpressOS.Kernel
             Buffer[byte_offset] |= (byte)(1 << (b % BitsPerByte));
         }
 
+        public bool IsSet(int b)
+        {
+            if (b < 0 || b >= n)
+                return false;
+
+            return (Buffer[b / BitsPerByte] & (1 << (b % BitsPerByte))) != 0;
+        }
+
+        public void Clear()
+        {
+            for (var i = 0; i < Buffer.Length; ++i)
+                Buffer[i] = 0;
+        }
+
         public int FindNextOne(int b)
         {
             int i = b + 1;
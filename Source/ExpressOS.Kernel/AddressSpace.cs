@@ -20,6 +20,8 @@ namespace ExpressOS.Kernel
         internal readonly Arch.ArchAddressSpace impl;
         public uint StartBrk;
         public uint Brk;
+        /* The region that ends at Brk, which brk() grows in place */
+        private MemoryRegion heapRegion;
         public const uint KERNEL_OFFSET = 0xc0000000;
         public const int KERNEL_SIZE = 0x10000000 - 1;
    
@@ -40,6 +42,27 @@ namespace ExpressOS.Kernel
             this.Head = MemoryRegion.CreateUserSpaceRegion(owner);
             this.GhostOwner = owner;
             this.Brk = this.StartBrk = 0;
+            AddTimePageMapping();
+        }
+
+        private void AddTimePageMapping()
+        {
+            Insert(new MemoryRegion(GhostOwner, MemoryRegion.FAULT_READ, 0, null, 0, 0, new Pointer(TimePage.Location), TimePage.Size, true));
+            TimePage.AddIntoWorkingSet(workingSet);
+        }
+
+        /*
+         * Tear down the address space when its process exits. Deleting the
+         * task drops all of its mappings at once, then the working set is
+         * released in one sweep. The TimePage is shared by all address
+         * spaces and stays. The gathered flushes may name the
+         * task, so they are carried out while it still exists.
+         */
+        internal void Destroy()
+        {
+            MmuGather.Finish();
+            impl.Destroy();
+            workingSet.Destroy(new UserPtr(TimePage.Location));
         }
 
         private void RemoveWorkingSet(Pointer vaddr, int size)
@@ -58,26 +81,429 @@ namespace ExpressOS.Kernel
         {
             Contract.Requires(newBrk > Brk);
 
+            /*
+             * Extend the heap region without walking the regions, as long as
+             * it still ends at the break and nothing lies in the way.
+             */
+            var h = heapRegion;
+            if (h != null && h.End == new Pointer(Brk) && !h.IsFixed && h.BackingFile == null
+                && h.Access == (MemoryRegion.FAULT_READ | MemoryRegion.FAULT_WRITE)
+                && (h.Next == null || h.Next.StartAddress >= new Pointer(newBrk)))
+            {
+                h.Size += (int)(newBrk - Brk);
+                TryMergeWithNext(h);
+                Brk = newBrk;
+                return true;
+            }
+
             var r = AddMapping(MemoryRegion.FAULT_READ | MemoryRegion.FAULT_WRITE, 0, null, 0, 0, new Pointer(Brk), (int)(newBrk - Brk));
             Contract.Assert(newBrk > Brk);
             if (r == 0)
             {
                 Brk = newBrk;
+                heapRegion = Find(new Pointer(newBrk - 1));
                 return true;
             }
             return false;
         }
 
+        /*
+         * Shrink the heap to newBrk. The pages above it are unmapped and go
+         * back to the PageAllocator.
+         */
+        internal bool RemoveHeapMapping(uint newBrk)
+        {
+            Contract.Requires(newBrk >= StartBrk && newBrk < Brk);
+
+            if (RemoveMapping(new Pointer(newBrk), (int)(Brk - newBrk)) != 0)
+                return false;
+
+            Brk = newBrk;
+            return true;
+        }
+
         public Pointer UserToVirt(UserPtr addr)
         {
             return workingSet.UserToVirt(addr);
         }
 
+        /* The pages that the process holds, see Pager.OutOfMemory() */
+        internal int ResidentPages
+        {
+            get
+            {
+                return workingSet.Size;
+            }
+        }
+
         public void AddIntoWorkingSet(UserPtr userPtr, Pointer virtualAddr)
         {
             workingSet.Add(userPtr, virtualAddr);
         }
 
+        internal bool IsSuperPageEmpty(UserPtr superPage)
+        {
+            return workingSet.IsSuperPageEmpty(superPage);
+        }
+
+        internal void AddSuperPageIntoWorkingSet(UserPtr superPage, Pointer virtualAddr)
+        {
+            // The 4K mappings of the zero page would shadow the superpage
+            if (workingSet.AddSuperPage(superPage, virtualAddr))
+                MmuGather.Flush(this, superPage.Value, superPage.Value + Arch.ArchDefinition.SuperPageSize, MemoryRegion.FAULT_MASK);
+        }
+
+        /*
+         * Same as UserToVirt(), except that a page shared copy-on-write is
+         * copied first so that the kernel can write into it. Pages of a
+         * MAP_SHARED region are written in place.
+         */
+        internal Pointer UserToVirtForWrite(UserPtr addr)
+        {
+            var virtualAddr = workingSet.UserToVirt(addr);
+            if (virtualAddr == Pointer.Zero)
+                return virtualAddr;
+
+            if (Pager.PageIndex(virtualAddr) == Globals.ZeroPage)
+            {
+                var p = PromoteZeroPage(Pager.PageIndex(addr));
+                if (p == Pointer.Zero)
+                    return Pointer.Zero;
+
+                return p + Arch.ArchDefinition.PageOffset(addr.Value.ToInt32());
+            }
+
+            if (!Globals.PageAllocator.IsShared(Pager.PageIndex(virtualAddr)) || IsSharedMapping(addr))
+            {
+                Globals.PageReclaimer.MarkDirty(Pager.PageIndex(virtualAddr));
+                return virtualAddr;
+            }
+
+            var page = BreakCopyOnWrite(Pager.PageIndex(addr), Pager.PageIndex(virtualAddr));
+            if (page == Pointer.Zero)
+                return Pointer.Zero;
+
+            return page + Arch.ArchDefinition.PageOffset(addr.Value.ToInt32());
+        }
+
+        private bool IsSharedMapping(UserPtr addr)
+        {
+            var region = Find(addr.Value);
+            return region != null && region.IsSharedMapping;
+        }
+
+        /*
+         * Give the address space a private copy of a page that it shares
+         * copy-on-write with other address spaces.
+         */
+        internal Pointer BreakCopyOnWrite(UserPtr userPage, Pointer page)
+        {
+            var buf = Pager.AllocPage();
+            if (!buf.isValid)
+                return Pointer.Zero;
+
+            buf.CopyFrom(0, new ByteBufferRef(page.ToIntPtr(), Arch.ArchDefinition.PageSize));
+            var copy = new Pointer(buf.Location);
+            workingSet.Replace(userPage, copy);
+            Globals.PageReclaimer.Track(this, userPage, copy, true);
+
+            // Drops our reference of the shared page
+            MmuGather.FreePage(page);
+
+            // The read-only mapping of the old page is stale now
+            MmuGather.Flush(this, userPage.Value, userPage.Value + Arch.ArchDefinition.PageSize, MemoryRegion.FAULT_MASK);
+            return copy;
+        }
+
+        /*
+         * Drop a clean page picked by the PageReclaimer. The caller frees the
+         * page. Fails if userPage is no longer backed by page.
+         */
+        internal bool EvictPage(UserPtr userPage, Pointer page)
+        {
+            if (workingSet.UserToVirt(userPage) != page)
+                return false;
+
+            workingSet.Evict(userPage);
+            MmuGather.Flush(this, userPage.Value, userPage.Value + Arch.ArchDefinition.PageSize, MemoryRegion.FAULT_MASK);
+            return true;
+        }
+
+        /*
+         * Give the address space a private page in place of the zero page
+         * at userPage, on the first write.
+         */
+        internal Pointer PromoteZeroPage(UserPtr userPage)
+        {
+            var buf = Pager.AllocZeroedPage();
+            if (!buf.isValid)
+                return Pointer.Zero;
+
+            var page = new Pointer(buf.Location);
+            workingSet.Replace(userPage, page);
+            Globals.PageReclaimer.Track(this, userPage, page, true);
+
+            // The read-only mapping of the zero page is stale now
+            MmuGather.Flush(this, userPage.Value, userPage.Value + Arch.ArchDefinition.PageSize, MemoryRegion.FAULT_MASK);
+            return page;
+        }
+
+        /*
+         * Move a dirty page picked by the PageReclaimer into the
+         * CompressedPageStore. The caller frees the page. Returns -1 if
+         * userPage is no longer backed by page, 0 if the store is full,
+         * and CompressedPageStore.Incompressible if the page does not
+         * compress.
+         */
+        internal int CompressPage(UserPtr userPage, Pointer page)
+        {
+            if (workingSet.UserToVirt(userPage) != page)
+                return -1;
+
+            var handle = Globals.CompressedPages.Store(page);
+            if (handle == CompressedPageStore.Incompressible)
+                return handle;
+
+            if (handle < 0)
+                return 0;
+
+            workingSet.SetCompressed(userPage, handle);
+            MmuGather.Flush(this, userPage.Value, userPage.Value + Arch.ArchDefinition.PageSize, MemoryRegion.FAULT_MASK);
+            return 1;
+        }
+
+        internal bool IsCompressed(UserPtr userPage)
+        {
+            return workingSet.CompressedHandle(userPage) >= 0;
+        }
+
+        /*
+         * Record the madvise() hint of [start, start + size). The regions
+         * are split at the boundaries, and merged again with neighbours
+         * that carry the same hint. Fixed regions keep theirs.
+         */
+        internal void UpdateAdviceRange(Pointer start, int size, int advice)
+        {
+            UpdateHintRange(start, size, false, advice, false);
+        }
+
+        /* Same as UpdateAdviceRange(), for MADV_HUGEPAGE and MADV_NOHUGEPAGE */
+        internal void UpdateHugePageRange(Pointer start, int size, bool noHugePage)
+        {
+            UpdateHintRange(start, size, true, 0, noHugePage);
+        }
+
+        private void UpdateHintRange(Pointer start, int size, bool hugePageHint, int advice, bool noHugePage)
+        {
+            var end = start + size;
+            var prev = Head;
+            var r = prev.Next;
+
+            while (r != null && r.StartAddress < end)
+            {
+                var same = hugePageHint ? r.NoHugePage == noHugePage : r.Advice == advice;
+                if (r.IsFixed || same || !r.OverlappedInt(start, size))
+                {
+                    prev = r;
+                    r = r.Next;
+                    continue;
+                }
+
+                if (r.StartAddress < start)
+                {
+                    prev = r;
+                    r = Split(r, start - r.StartAddress);
+                }
+
+                if (end < r.End)
+                    Split(r, end - r.StartAddress);
+
+                if (hugePageHint)
+                    r.NoHugePage = noHugePage;
+                else
+                    r.Advice = advice;
+
+                TryMergeWithNext(r);
+                if (TryMergeWithNext(prev))
+                    r = prev;
+
+                prev = r;
+                r = r.Next;
+            }
+        }
+
+        /*
+         * Map the present pages of [start, end) of region into the task
+         * ahead of the faults, see Pager.Populate(). Runs of pages that are
+         * contiguous in the kernel as well are mapped with as few fpages as
+         * possible. Shared pages and the zero page are mapped read-only, so
+         * are clean pages, whose first write has to fault to make them dirty
+         * for the PageReclaimer.
+         */
+        internal void MapPresent(MemoryRegion region, Pointer start, Pointer end)
+        {
+            // Pending flushes of the range must not revoke the new mappings
+            MmuGather.Finish();
+
+            var page = new UserPtr(start);
+            var runUser = Pointer.Zero;
+            var runKernel = Pointer.Zero;
+            var runSize = 0;
+            uint runRights = 0;
+            Pointer entry;
+
+            while (workingSet.NextEntry(ref page, new UserPtr(end), out entry))
+            {
+                var kernelPage = workingSet.UserToVirt(page);
+                if (kernelPage != Pointer.Zero)
+                {
+                    var rights = region.Access & MemoryRegion.FAULT_MASK;
+                    if (kernelPage == Globals.ZeroPage || Globals.PageReclaimer.IsClean(kernelPage)
+                        || (Globals.PageAllocator.IsShared(kernelPage) && !region.IsSharedMapping))
+                        rights &= ~MemoryRegion.FAULT_WRITE;
+
+                    if (runSize != 0 && rights == runRights && page.Value == runUser + runSize && kernelPage == runKernel + runSize)
+                    {
+                        runSize += Arch.ArchDefinition.PageSize;
+                    }
+                    else
+                    {
+                        if (runSize != 0)
+                            Arch.NativeMethods.l4api_map_range(impl._value, runKernel, runUser, runSize, (int)runRights);
+
+                        runUser = page.Value;
+                        runKernel = kernelPage;
+                        runSize = Arch.ArchDefinition.PageSize;
+                        runRights = rights;
+                    }
+                }
+
+                page += Arch.ArchDefinition.PageSize;
+            }
+
+            if (runSize != 0)
+                Arch.NativeMethods.l4api_map_range(impl._value, runKernel, runUser, runSize, (int)runRights);
+        }
+
+        /*
+         * MADV_FREE. The private anonymous pages of [start, end) can be
+         * dropped by the PageReclaimer instead of compressed, after which
+         * they read back as zeroes. Their mappings are revoked, so that an
+         * access before the reclaim makes them dirty again.
+         */
+        internal void MarkLazyFree(UserPtr start, UserPtr end)
+        {
+            for (var r = Head.Next; r != null && r.StartAddress < end.Value; r = r.Next)
+            {
+                if (r.IsFixed || r.BackingFile != null || (r.Flags & Memory.MAP_SHARED) != 0 || r.End <= start.Value)
+                    continue;
+
+                var page = new UserPtr(r.StartAddress < start.Value ? start.Value : r.StartAddress);
+                var regionEnd = new UserPtr(r.End < end.Value ? r.End : end.Value);
+                Pointer entry;
+                while (workingSet.NextEntry(ref page, regionEnd, out entry))
+                {
+                    if (Globals.PageReclaimer.MarkClean(entry))
+                        MmuGather.Flush(this, page.Value, page.Value + Arch.ArchDefinition.PageSize, MemoryRegion.FAULT_MASK);
+
+                    page += Arch.ArchDefinition.PageSize;
+                }
+            }
+        }
+
+        /* Bring a compressed page back into the working set */
+        internal Pointer LoadCompressedPage(UserPtr userPage)
+        {
+            var buf = Pager.AllocPage();
+            if (!buf.isValid)
+                return Pointer.Zero;
+
+            // The allocation might have reclaimed, but never this page
+            var handle = workingSet.CompressedHandle(userPage);
+            var page = new Pointer(buf.Location);
+            if (!Globals.CompressedPages.Load(handle, page))
+            {
+                Arch.Console.WriteLine("LoadCompressedPage: corrupted page");
+                Globals.PageAllocator.FreePage(page);
+                return Pointer.Zero;
+            }
+
+            workingSet.Replace(userPage, page);
+            Globals.CompressedPages.Release(handle);
+            Globals.PageReclaimer.Track(this, userPage, page, true);
+            return page;
+        }
+
+        /*
+         * Populate the empty address space of a forked child. Private pages
+         * are shared copy-on-write, pages of alien shared regions are faulted
+         * in again from Linux. The pages of other MAP_SHARED regions are
+         * brought in first and shared writable, see Pager.PopulateShared().
+         * Returns -ENOMEM or -EAGAIN on failure, the caller tears the child
+         * down.
+         */
+        internal int ForkInto(AddressSpace child)
+        {
+            Contract.Requires(child != this);
+
+            File lastFile = null;
+            File lastChildFile = null;
+            var ret = 0;
+
+            for (var r = Head.Next; r != null; r = r.Next)
+            {
+                if (r.IsFixed)
+                    continue;
+
+                File childFile = null;
+                if (r.BackingFile != null)
+                {
+                    if (r.BackingFile != lastFile)
+                    {
+                        // The regions hold their own references of the inodes
+                        if (lastChildFile != null)
+                            lastChildFile.Close();
+
+                        lastFile = r.BackingFile;
+                        lastChildFile = new File(child.GhostOwner, lastFile.inode, lastFile.flags, lastFile.mode);
+                    }
+                    childFile = lastChildFile;
+                }
+
+                var childRegion = new MemoryRegion(child.GhostOwner, r.Access, r.Flags, childFile, (uint)r.FileOffset,
+                    (int)r.FileSize, r.StartAddress, r.Size, false);
+                childRegion.Advice = r.Advice;
+                childRegion.NoHugePage = r.NoHugePage;
+                child.Insert(childRegion);
+
+                if (Pager.IsAlienSharedRegion(r))
+                    continue;
+
+                if (r.IsSharedMapping && !Pager.PopulateShared(GhostOwner, r))
+                {
+                    ret = -ErrorCode.ENOMEM;
+                    break;
+                }
+
+                // A page that cannot get another owner is out of process slots
+                if (!workingSet.Share(child.workingSet, new UserPtr(r.StartAddress), new UserPtr(r.End)))
+                {
+                    ret = -ErrorCode.EAGAIN;
+                    break;
+                }
+
+                if (!r.IsSharedMapping && (r.Access & MemoryRegion.FAULT_WRITE) != 0)
+                    MmuGather.Flush(this, r.StartAddress, r.End, MemoryRegion.FAULT_WRITE);
+            }
+
+            if (lastChildFile != null)
+                lastChildFile.Close();
+
+            child.Brk = Brk;
+            child.StartBrk = StartBrk;
+            return ret;
+        }
+
         internal Pointer FindFreeRegion(int length)
         {
             var r = Head;
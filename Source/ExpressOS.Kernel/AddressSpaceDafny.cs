@@ -11,6 +11,9 @@ namespace ExpressOS.Kernel
         {
             Contract.Ensures(Brk == Contract.OldValue(Brk));
 
+            if (r == heapRegion)
+                heapRegion = null;
+
             prev.Next = r.Next;
         }
 
@@ -104,6 +107,46 @@ namespace ExpressOS.Kernel
             return;
         }
 
+        /* Whether no region overlaps [start, end) */
+        internal bool IsUnmapped(Pointer start, Pointer end)
+        {
+            var h = Head.Next;
+            while (h != null && h.End <= start)
+                h = h.Next;
+
+            return h == null || end <= h.StartAddress;
+        }
+
+        /*
+         * Insert regions in a single walk of the list. They have to be
+         * sorted by address, and must not overlap each other or any
+         * region of the address space, see IsUnmapped().
+         */
+        internal void InsertSorted(MemoryRegion[] regions)
+        {
+            Contract.Requires(regions != null);
+            Contract.Ensures(Brk == Contract.OldValue(Brk));
+
+            var prev = Head;
+            var h = Head.Next;
+            for (var i = 0; i < regions.Length; ++i)
+            {
+                var r = regions[i];
+                while (h != null && h.End <= r.StartAddress)
+                {
+                    prev = h;
+                    h = h.Next;
+                }
+
+                InsertOrMerge(prev, r, h);
+
+                // r is either part of prev now, or follows it
+                if (prev.End < r.End)
+                    prev = r;
+                h = prev.Next;
+            }
+        }
+
         //
         // Separate region into two. It returns the rightmost part of the region
         //
@@ -124,6 +167,8 @@ namespace ExpressOS.Kernel
                     (int)(r.FileSize - offset), r.StartAddress + offset, r.Size - offset, r.IsFixed);
             }
 
+            next.Advice = r.Advice;
+            next.NoHugePage = r.NoHugePage;
             r.CutRight(r.Size - offset);
             InsertNode(r, next);
             return next;
@@ -0,0 +1,547 @@
+﻿namespace ExpressOS.Kernel
+{
+    /*
+     * The processes launched at boot.
+     *
+     * The manifest is read from FileName through a Linux helper, and the
+     * built-in DefaultManifest is used when the file does not exist or
+     * cannot be used. It has one directive per line, "#" starts a comment:
+     *
+     *   env NAME=VALUE        environment of every process when it comes
+     *                         before the first "process", otherwise of the
+     *                         current process only, which overrides the
+     *                         common one of the same name
+     *   process PATH ARGS...  starts a process, PATH is also argv[0]
+     *   priority N            nice value of its main thread
+     *   sfs PREFIX            files under PREFIX go to the secure file
+     *                         system, /data/data/<package or program name>
+     *                         by default
+     *   package NAME          runs it as an Android application, which is
+     *                         described further by uid, flags, apk, sdk
+     *                         and intent
+     *   zeropool N            number of pages that the kernel keeps zeroed
+     *                         ahead of time, see ZeroedPagePool
+     *   helperops MASK        optional ops that the Linux helper implements,
+     *                         Arch.IPCStubs.OPTIONAL_*, none by default
+     *
+     * All processes are started before the kernel enters the server loop,
+     * so they boot in parallel. Each of them reports the time spent on
+     * creating it with "launch,<index>,<pid>,<path>,<us>", and the time
+     * until its first system call with "launch-ready,<pid>,<us>".
+     */
+    public static class BootManifest
+    {
+        public const string FileName = "/data/expressos/boot.manifest";
+
+        private const int MaxFileSize = 16384;
+        private const int MaxProcesses = 16;
+        private const int MaxStrings = 64;
+
+        private const string DefaultManifest =
+            "env CLASSPATH=/system/framework/am.jar\n" +
+            "env PATH=/sbin:/vendor/bin:/system/sbin:/system/bin:/system/xbin\n" +
+            "env LD_LIBRARY_PATH=/vendor/lib:/system/lib\n" +
+            "env ANDROID_BOOTLOGO=1\n" +
+            "env ANDROID_ROOT=/system\n" +
+            "env ANDROID_ASSETS=/system/app\n" +
+            "env ANDROID_DATA=/data\n" +
+            "env EXTERNAL_STORAGE=/mnt/sdcard\n" +
+            "env ASEC_MOUNTPOINT=/mnt/asec\n" +
+            "env LOOP_MOUNTPOINT=/mnt/obb\n" +
+            "env BOOTCLASSPATH=/system/framework/core.jar:/system/framework/bouncycastle.jar:/system/framework/ext.jar:/system/framework/framework.jar:/system/framework/android.policy.jar:/system/framework/services.jar:/system/framework/core-junit.jar\n" +
+            "process /system/bin/app_process /system/bin android.app.ActivityThread\n" +
+            "env HH_DEBUG=1\n" +
+            "package me.haohui.expressos.browserbench\n" +
+            "uid 1002\n" +
+            "flags 0x8be45\n" +
+            "apk /system/app/BrowserBench.apk\n" +
+            "intent me.haohui.expressos.browserbench/me.haohui.expressos.browserbench.BrowserActivity\n";
+
+        private sealed class Entry
+        {
+            public readonly ASCIIString[] Argv;
+            public int Argc;
+            public readonly ASCIIString[] Envp;
+            public int Envc;
+            public int Nice;
+            public readonly AndroidApplicationInfo AppInfo;
+
+            public Entry()
+            {
+                Argv = new ASCIIString[MaxStrings];
+                Envp = new ASCIIString[MaxStrings];
+                AppInfo = new AndroidApplicationInfo();
+                AppInfo.Enabled = true;
+                AppInfo.TargetSdkVersion = 10;
+            }
+        }
+
+        private static Entry[] entries;
+        private static int entryCount;
+        private static ASCIIString[] commonEnvp;
+        private static int commonEnvc;
+        private static int lineNumber;
+
+        /*
+         * Launches the processes of the manifest. Returns the first one that
+         * has been launched, or null.
+         */
+        public static Process Launch()
+        {
+            /* The helper that reads the manifest runs the first process */
+            var helper = Exec.Helper.Take();
+            if (helper.Pid < 0)
+            {
+                Arch.Console.WriteLine("BootManifest: cannot get helper");
+                return null;
+            }
+
+            var buf = new byte[MaxFileSize];
+            var len = ReadManifest(helper.Pid, buf);
+            if (len >= 0)
+            {
+                Arch.Console.Write("BootManifest: using ");
+                Arch.Console.WriteLine(FileName);
+            }
+            else if (len != -ErrorCode.ENOENT)
+            {
+                Arch.Console.Write("BootManifest: cannot read the manifest, errno=");
+                Arch.Console.Write(-len);
+                Arch.Console.WriteLine();
+            }
+
+            /*
+             * A helper cannot be given back once taken, so a manifest that
+             * cannot be used falls back to the default one, which runs its
+             * first process in this helper.
+             */
+            Reset();
+            if (len < 0 || !Parse(buf, len))
+            {
+                if (len >= 0)
+                    Arch.Console.WriteLine("BootManifest: using the default manifest");
+
+                Reset();
+                buf = Util.StringToByteArray(DefaultManifest, false);
+                if (!Parse(buf, buf.Length))
+                    return null;
+            }
+
+            Process first = null;
+            for (var i = 0; i < entryCount; ++i)
+            {
+                if (i > 0)
+                {
+                    helper = Exec.Helper.Take();
+                    if (helper.Pid < 0)
+                    {
+                        Arch.Console.WriteLine("BootManifest: cannot get helper");
+                        break;
+                    }
+                }
+
+                var proc = Launch(i, entries[i], helper);
+                if (first == null)
+                    first = proc;
+            }
+
+            return first;
+        }
+
+        private static Process Launch(int index, Entry e, Exec.Helper helper)
+        {
+            var argv = new ASCIIString[e.Argc];
+            for (var i = 0; i < e.Argc; ++i)
+                argv[i] = e.Argv[i];
+
+            /* The variables of the process override the common ones */
+            var merged = new ASCIIString[commonEnvc + e.Envc];
+            var envc = 0;
+            for (var i = 0; i < commonEnvc; ++i)
+            {
+                if (!IsOverridden(commonEnvp[i], e))
+                    merged[envc++] = commonEnvp[i];
+            }
+
+            for (var i = 0; i < e.Envc; ++i)
+                merged[envc++] = e.Envp[i];
+
+            var envp = new ASCIIString[envc];
+            for (var i = 0; i < envc; ++i)
+                envp[i] = merged[i];
+
+            var startTime = Arch.NativeMethods.l4api_get_system_clock();
+            var proc = Exec.CreateProcess(argv[0], argv, envp, e.AppInfo, e.Nice, helper);
+            var createTime = Arch.NativeMethods.l4api_get_system_clock() - startTime;
+
+            if (proc == null)
+            {
+                Arch.Console.Write("BootManifest: cannot launch ");
+                Arch.Console.Write(argv[0]);
+                Arch.Console.WriteLine();
+                return null;
+            }
+
+            /* The server loop is not running yet, so no system call is missed */
+            proc.LaunchTime = startTime;
+
+            Arch.Console.Write("launch,");
+            Arch.Console.Write(index);
+            Arch.Console.Write(',');
+            Arch.Console.Write(proc.helperPid);
+            Arch.Console.Write(',');
+            Arch.Console.Write(argv[0]);
+            Arch.Console.Write(',');
+            Arch.Console.Write(createTime);
+            Arch.Console.WriteLine();
+            return proc;
+        }
+
+        private static void Reset()
+        {
+            Arch.IPCStubs.OptionalOps = 0;
+            entries = new Entry[MaxProcesses];
+            entryCount = 0;
+            commonEnvp = new ASCIIString[MaxStrings];
+            commonEnvc = 0;
+        }
+
+        private static bool IsOverridden(ASCIIString variable, Entry e)
+        {
+            var name = variable.GetByteString();
+            for (var i = 0; i < e.Envc; ++i)
+            {
+                var other = e.Envp[i].GetByteString();
+                var j = 0;
+                while (j < name.Length && j < other.Length && name[j] == other[j] && name[j] != '=' && name[j] != 0)
+                    ++j;
+
+                if (j < name.Length && j < other.Length && name[j] == '=' && other[j] == '=')
+                    return true;
+            }
+            return false;
+        }
+
+        /*
+         * Called on every system call. Logs the time from the launch of a
+         * process started at boot to its first system call.
+         */
+        public static void EnterSyscall(Thread current)
+        {
+            var process = current.Parent;
+            if (process.LaunchTime == 0)
+                return;
+
+            var elapsed = Arch.NativeMethods.l4api_get_system_clock() - process.LaunchTime;
+            process.LaunchTime = 0;
+
+            Arch.Console.Write("launch-ready,");
+            Arch.Console.Write(process.helperPid);
+            Arch.Console.Write(',');
+            Arch.Console.Write(elapsed);
+            Arch.Console.WriteLine();
+        }
+
+        /*
+         * Returns the length of the manifest, -ENOENT if there is none, or
+         * -EFBIG if it does not fit into buf.
+         */
+        private static int ReadManifest(int helperPid, byte[] buf)
+        {
+            ErrorCode ec;
+            var inode = Arch.ArchFS.Open(helperPid, new ASCIIString(FileName), 0, 0, out ec);
+            if (inode == null)
+                return ec.Errno();
+
+            var b = new ByteBufferRef(buf);
+            var chunk = Globals.LinuxIPCBuffer.Length;
+            uint pos = 0;
+            var len = 0;
+            while (len < buf.Length)
+            {
+                var count = buf.Length - len > chunk ? chunk : buf.Length - len;
+                var r = inode.ReadImpl(b, len, count, ref pos);
+                if (r < 0)
+                {
+                    inode.Close();
+                    return r;
+                }
+
+                if (r == 0)
+                    break;
+
+                len += r;
+            }
+            inode.Close();
+
+            if (len == buf.Length)
+            {
+                Arch.Console.Write("BootManifest: the manifest is larger than ");
+                Arch.Console.Write(MaxFileSize - 1);
+                Arch.Console.WriteLine(" bytes");
+                return -ErrorCode.EFBIG;
+            }
+            return len;
+        }
+
+        #region Parser
+
+        private static bool Parse(byte[] buf, int len)
+        {
+            var tokenStart = new int[MaxStrings + 1];
+            var tokenLength = new int[MaxStrings + 1];
+            Entry current = null;
+
+            lineNumber = 0;
+            var pos = 0;
+            while (pos < len)
+            {
+                var end = pos;
+                while (end < len && buf[end] != '\n')
+                    ++end;
+
+                ++lineNumber;
+                var n = Tokenize(buf, pos, end, tokenStart, tokenLength);
+                pos = end + 1;
+
+                if (n < 0)
+                    return Error("too many arguments");
+
+                if (n > 0 && !ParseDirective(buf, tokenStart, tokenLength, n, ref current))
+                    return false;
+            }
+
+            for (var i = 0; i < entryCount; ++i)
+            {
+                var info = entries[i].AppInfo;
+                if (info.DataDir != null)
+                    continue;
+
+                if (info.PackageName != null)
+                {
+                    info.DataDir = "/data/data/" + info.PackageName;
+                }
+                else
+                {
+                    var path = entries[i].Argv[0].GetByteString();
+                    var name = entries[i].Argv[0].Length;
+                    while (name > 0 && path[name - 1] != '/')
+                        --name;
+
+                    info.DataDir = "/data/data/" + MakeString(path, name, entries[i].Argv[0].Length - name);
+                }
+            }
+
+            if (entryCount == 0)
+            {
+                Arch.Console.WriteLine("BootManifest: no process to launch");
+                return false;
+            }
+            return true;
+        }
+
+        /*
+         * Splits the line [start, end) into tokens separated by blanks.
+         * Returns the number of tokens, or -1 if there are too many.
+         */
+        private static int Tokenize(byte[] buf, int start, int end, int[] tokenStart, int[] tokenLength)
+        {
+            var n = 0;
+            var i = start;
+            while (i < end)
+            {
+                if (IsBlank(buf[i]))
+                {
+                    ++i;
+                    continue;
+                }
+
+                if (buf[i] == '#')
+                    break;
+
+                if (n == tokenStart.Length)
+                    return -1;
+
+                tokenStart[n] = i;
+                while (i < end && !IsBlank(buf[i]))
+                    ++i;
+
+                tokenLength[n] = i - tokenStart[n];
+                ++n;
+            }
+            return n;
+        }
+
+        private static bool ParseDirective(byte[] buf, int[] tokenStart, int[] tokenLength, int n, ref Entry current)
+        {
+            var keyStart = tokenStart[0];
+            var keyLength = tokenLength[0];
+
+            if (Match(buf, keyStart, keyLength, "process"))
+            {
+                if (n < 2)
+                    return Error("process needs a path");
+
+                if (entryCount == MaxProcesses)
+                    return Error("too many processes");
+
+                current = new Entry();
+                entries[entryCount++] = current;
+                for (var i = 1; i < n; ++i)
+                    current.Argv[current.Argc++] = MakeASCIIString(buf, tokenStart[i], tokenLength[i]);
+
+                return true;
+            }
+
+            if (n != 2)
+                return Error("expect one value");
+
+            var valueStart = tokenStart[1];
+            var valueLength = tokenLength[1];
+
+            if (Match(buf, keyStart, keyLength, "env"))
+            {
+                if (current == null)
+                {
+                    if (commonEnvc == MaxStrings)
+                        return Error("too many environment variables");
+
+                    commonEnvp[commonEnvc++] = MakeASCIIString(buf, valueStart, valueLength);
+                }
+                else
+                {
+                    if (current.Envc == MaxStrings)
+                        return Error("too many environment variables");
+
+                    current.Envp[current.Envc++] = MakeASCIIString(buf, valueStart, valueLength);
+                }
+                return true;
+            }
+
+            if (Match(buf, keyStart, keyLength, "zeropool"))
+                return ParseInt(buf, valueStart, valueLength, out Globals.ZeroedPages.Watermark);
+
+            if (Match(buf, keyStart, keyLength, "helperops"))
+                return ParseInt(buf, valueStart, valueLength, out Arch.IPCStubs.OptionalOps);
+
+            if (current == null)
+                return Error("directive outside of a process");
+
+            var info = current.AppInfo;
+            if (Match(buf, keyStart, keyLength, "priority"))
+                return ParseInt(buf, valueStart, valueLength, out current.Nice);
+            else if (Match(buf, keyStart, keyLength, "sfs"))
+                info.DataDir = MakeString(buf, valueStart, valueLength);
+            else if (Match(buf, keyStart, keyLength, "package"))
+                info.PackageName = MakeString(buf, valueStart, valueLength);
+            else if (Match(buf, keyStart, keyLength, "uid"))
+                return ParseInt(buf, valueStart, valueLength, out info.uid);
+            else if (Match(buf, keyStart, keyLength, "flags"))
+                return ParseInt(buf, valueStart, valueLength, out info.flags);
+            else if (Match(buf, keyStart, keyLength, "apk"))
+                info.SourceDir = MakeString(buf, valueStart, valueLength);
+            else if (Match(buf, keyStart, keyLength, "sdk"))
+                return ParseInt(buf, valueStart, valueLength, out info.TargetSdkVersion);
+            else if (Match(buf, keyStart, keyLength, "intent"))
+                info.Intent = MakeString(buf, valueStart, valueLength);
+            else
+                return Error("unknown directive");
+
+            return true;
+        }
+
+        /*
+         * Decimal with an optional sign, or hexadecimal with a 0x prefix.
+         * A hexadecimal number may use all 32 bits, as for flags.
+         */
+        private static bool ParseInt(byte[] buf, int start, int length, out int val)
+        {
+            val = 0;
+            var negative = length > 1 && buf[start] == '-';
+            if (negative)
+            {
+                ++start;
+                --length;
+            }
+
+            var radix = 10;
+            if (length > 2 && buf[start] == '0' && (buf[start + 1] == 'x' || buf[start + 1] == 'X'))
+            {
+                radix = 16;
+                start += 2;
+                length -= 2;
+            }
+
+            var limit = radix == 16 ? (long)uint.MaxValue : (negative ? -(long)int.MinValue : int.MaxValue);
+            long v = 0;
+            for (var i = 0; i < length; ++i)
+            {
+                var c = buf[start + i];
+                int digit;
+                if (c >= '0' && c <= '9')
+                    digit = c - '0';
+                else if (radix == 16 && c >= 'a' && c <= 'f')
+                    digit = c - 'a' + 10;
+                else if (radix == 16 && c >= 'A' && c <= 'F')
+                    digit = c - 'A' + 10;
+                else
+                    return Error("invalid number");
+
+                v = v * radix + digit;
+                if (v > limit)
+                    return Error("number out of range");
+            }
+
+            val = (int)(negative ? -v : v);
+            return true;
+        }
+
+        private static bool Error(string msg)
+        {
+            Arch.Console.Write("BootManifest: line ");
+            Arch.Console.Write(lineNumber);
+            Arch.Console.Write(": ");
+            Arch.Console.WriteLine(msg);
+            return false;
+        }
+
+        private static bool IsBlank(byte c)
+        {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        private static bool Match(byte[] buf, int start, int length, string keyword)
+        {
+            if (length != keyword.Length)
+                return false;
+
+            for (var i = 0; i < length; ++i)
+            {
+                if (buf[start + i] != keyword[i])
+                    return false;
+            }
+            return true;
+        }
+
+        private static ASCIIString MakeASCIIString(byte[] buf, int start, int length)
+        {
+            var b = new byte[length + 1];
+            for (var i = 0; i < length; ++i)
+                b[i] = buf[start + i];
+
+            b[length] = 0;
+            return new ASCIIString(b);
+        }
+
+        private static string MakeString(byte[] buf, int start, int length)
+        {
+            var chars = new char[length];
+            for (var i = 0; i < length; ++i)
+                chars[i] = (char)buf[start + i];
+
+            return new string(chars);
+        }
+
+        #endregion
+    }
+}
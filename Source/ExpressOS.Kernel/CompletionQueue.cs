@@ -23,9 +23,22 @@ namespace ExpressOS.Kernel
             Head = e;
         }
 
+        /*
+         * Linux still hands over the pages of a pending AlienPageCompletion.
+         * It has a handle of its own, so it stays queued, orphaned, until
+         * the reply arrives and the pages can be given back, without being
+         * mistaken for a completion of a thread that reuses the handle.
+         */
         public void ClearAllPendingCompletion(uint handle)
         {
             while (Take(handle) != null) ;
+
+            for (var e = Head; e != null; e = e.next)
+            {
+                var alien = e.AlienPageCompletion;
+                if (alien != null && alien.thr.impl._value.thread._value == handle)
+                    alien.Orphaned = true;
+            }
         }
 
         public GenericCompletionEntry Take(uint handle)
@@ -71,6 +84,13 @@ namespace ExpressOS.Kernel
         {
             this.thr = current;
         }
+
+        /* For requests that are not keyed by the thread handle */
+        protected ThreadCompletionEntry(Thread current, Kind kind, uint handle)
+            : base(kind, handle)
+        {
+            this.thr = current;
+        }
     }
 
     public class ThreadCompletionEntryWithBuffer : ThreadCompletionEntry
@@ -84,6 +104,14 @@ namespace ExpressOS.Kernel
             this.buf = buf;
         }
 
+        internal ThreadCompletionEntryWithBuffer(Thread current, Kind kind, uint handle, ByteBufferRef buf)
+            : base(current, kind, handle)
+        {
+            Contract.Ensures(this.buf.Length == buf.Length);
+            Contract.Ensures(this.buf.Location == buf.Location);
+            this.buf = buf;
+        }
+
         internal void Dispose()
         {
             if (buf.isValid)
@@ -107,6 +135,10 @@ namespace ExpressOS.Kernel
             GetSocketParamCompletionKind,
             OpenFileCompletionKind,
             SFSFlushCompletionKind,
+            EventPollCompletionKind,
+            SendStreamCompletionKind,
+            MessageBatchCompletionKind,
+            AlienPageCompletionKind,
         }
 
         public readonly Kind kind;
@@ -144,6 +176,14 @@ namespace ExpressOS.Kernel
         { get { return kind == Kind.SFSFlushCompletionKind ? (SFSFlushCompletion)this : null; } }
         public SocketCompletion SocketCompletion
         { get { return kind == Kind.SocketCompletionKind ? (SocketCompletion)this : null; } }
+        public EventPollCompletion EventPollCompletion
+        { get { return kind == Kind.EventPollCompletionKind ? (EventPollCompletion)this : null; } }
+        public SendStreamCompletion SendStreamCompletion
+        { get { return kind == Kind.SendStreamCompletionKind ? (SendStreamCompletion)this : null; } }
+        public MessageBatchCompletion MessageBatchCompletion
+        { get { return kind == Kind.MessageBatchCompletionKind ? (MessageBatchCompletion)this : null; } }
+        public AlienPageCompletion AlienPageCompletion
+        { get { return kind == Kind.AlienPageCompletionKind ? (AlienPageCompletion)this : null; } }
 
         public ThreadCompletionEntry ThreadCompletionEntry
         {
@@ -162,6 +202,10 @@ namespace ExpressOS.Kernel
                     case Kind.SocketCompletionKind:
                     case Kind.GetSocketParamCompletionKind:
                     case Kind.OpenFileCompletionKind:
+                    case Kind.EventPollCompletionKind:
+                    case Kind.SendStreamCompletionKind:
+                    case Kind.MessageBatchCompletionKind:
+                    case Kind.AlienPageCompletionKind:
                         return (ThreadCompletionEntry)this;
                     default:
                         return null;
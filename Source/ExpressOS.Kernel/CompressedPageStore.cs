@@ -0,0 +1,255 @@
+﻿using System;
+using System.Diagnostics.Contracts;
+using System.Runtime.InteropServices;
+
+namespace ExpressOS.Kernel
+{
+    /*
+     * In-memory store of compressed anonymous pages, which the
+     * PageReclaimer fills with the cold pages that cannot be read back
+     * from a file.
+     *
+     * The compressed pages live in a pool of pages taken from the page
+     * allocator. Each pool page is cut into equally sized slots of one
+     * size class, from 32 slots of 128 bytes to 2 slots of 2048 bytes. A
+     * page that does not compress into 2048 bytes is not worth storing.
+     *
+     * A slot starts with a header of its compressed length and the number
+     * of working sets that refer to it, as a forked child shares the
+     * compressed pages of its parent.
+     *
+     * A handle is the page number of the pool page in the allocator
+     * times MaxSlots plus the slot index.
+     */
+    public class CompressedPageStore
+    {
+        private static class NativeMethods
+        {
+            [DllImport("glue")]
+            internal static extern int zpage_compress(Pointer src, IntPtr dst, int dst_len);
+            [DllImport("glue")]
+            internal static extern int zpage_decompress(IntPtr src, int src_len, Pointer dst);
+        }
+
+        private const int MaxSlots = 32;
+        private const int HeaderSize = 4;
+        private const int MaxCompressedSize = Arch.ArchDefinition.PageSize / 2 - HeaderSize;
+
+        private FreeListPageAllocator allocator;
+        private int[] slotsPerPage;
+        private int[] slotSizes;
+        /* Pool pages of each class that have free slots */
+        private int[] partialHeads;
+
+        /* Indexed by the page number in the allocator, allocated on the first Store() */
+        private byte[] pageClass;
+        private uint[] usedSlots;
+        private int[] nextPartial;
+        private int[] prevPartial;
+
+        private ByteBufferRef scratch;
+
+        public int StoredPages;
+        public long CompressedBytes;
+        public int PoolPages;
+        public int RejectedPages;
+        public int LoadedPages;
+
+        /* Returned by Store() for a page that does not compress well */
+        internal const int Incompressible = -2;
+
+        public void Initialize(FreeListPageAllocator allocator)
+        {
+            this.allocator = allocator;
+            this.slotsPerPage = new int[] { 32, 16, 10, 8, 6, 5, 4, 3, 2 };
+            this.slotSizes = new int[slotsPerPage.Length];
+            this.partialHeads = new int[slotsPerPage.Length];
+
+            for (var i = 0; i < slotsPerPage.Length; ++i)
+            {
+                slotSizes[i] = (Arch.ArchDefinition.PageSize / slotsPerPage[i]) & ~7;
+                partialHeads[i] = -1;
+            }
+        }
+
+        /*
+         * Compress a page into the store. Returns the handle, Incompressible
+         * if the page does not compress well, or -1 if the pool cannot grow.
+         */
+        internal int Store(Pointer page)
+        {
+            if (!scratch.isValid)
+            {
+                scratch = allocator.AllocPage();
+                if (!scratch.isValid)
+                    return -1;
+
+                var pages = allocator.PageCount;
+                pageClass = new byte[pages];
+                usedSlots = new uint[pages];
+                nextPartial = new int[pages];
+                prevPartial = new int[pages];
+            }
+
+            var len = NativeMethods.zpage_compress(page, scratch.Location, MaxCompressedSize);
+            if (len < 0)
+            {
+                ++RejectedPages;
+                return Incompressible;
+            }
+
+            var cls = 0;
+            while (slotSizes[cls] < len + HeaderSize)
+                ++cls;
+
+            var handle = AllocSlot(cls);
+            if (handle < 0)
+                return -1;
+
+            var slot = Slot(handle);
+            Deserializer.WriteUInt((1U << 16) | (uint)len, slot, 0);
+            slot.CopyFrom(HeaderSize, scratch.Slice(0, len));
+
+            ++StoredPages;
+            CompressedBytes += len;
+            return handle;
+        }
+
+        /* Decompress the page of the handle into page. */
+        internal bool Load(int handle, Pointer page)
+        {
+            var slot = Slot(handle);
+            var len = (int)(Deserializer.ReadUInt(slot, 0) & 0xffff);
+            ++LoadedPages;
+            return NativeMethods.zpage_decompress(slot.Slice(HeaderSize, len).Location, len, page) == Arch.ArchDefinition.PageSize;
+        }
+
+        /* Another working set refers to the handle */
+        internal void Duplicate(int handle)
+        {
+            var slot = Slot(handle);
+            Deserializer.WriteUInt(Deserializer.ReadUInt(slot, 0) + (1U << 16), slot, 0);
+        }
+
+        internal void Release(int handle)
+        {
+            var slot = Slot(handle);
+            var header = Deserializer.ReadUInt(slot, 0) - (1U << 16);
+            if ((header >> 16) != 0)
+            {
+                Deserializer.WriteUInt(header, slot, 0);
+                return;
+            }
+
+            --StoredPages;
+            CompressedBytes -= header & 0xffff;
+            FreeSlot(handle);
+        }
+
+        private ByteBufferRef Slot(int handle)
+        {
+            var idx = handle / MaxSlots;
+            var cls = pageClass[idx] - 1;
+            var size = slotSizes[cls];
+            var page = new ByteBufferRef(allocator.PageAddress(idx).ToIntPtr(), Arch.ArchDefinition.PageSize);
+            return page.Slice((handle % MaxSlots) * size, size);
+        }
+
+        private int AllocSlot(int cls)
+        {
+            var idx = partialHeads[cls];
+            if (idx < 0)
+            {
+                var buf = allocator.AllocPage();
+                if (!buf.isValid)
+                    return -1;
+
+                idx = allocator.PageNumber(new Pointer(buf.Location));
+                pageClass[idx] = (byte)(cls + 1);
+                usedSlots[idx] = 0;
+                LinkPartial(cls, idx);
+                ++PoolPages;
+            }
+
+            var slot = 0;
+            while ((usedSlots[idx] & (1U << slot)) != 0)
+                ++slot;
+
+            usedSlots[idx] |= 1U << slot;
+            if (usedSlots[idx] == FullMask(cls))
+                UnlinkPartial(cls, idx);
+
+            return idx * MaxSlots + slot;
+        }
+
+        private void FreeSlot(int handle)
+        {
+            var idx = handle / MaxSlots;
+            var cls = pageClass[idx] - 1;
+            var wasFull = usedSlots[idx] == FullMask(cls);
+
+            usedSlots[idx] &= ~(1U << (handle % MaxSlots));
+            if (usedSlots[idx] == 0)
+            {
+                if (!wasFull)
+                    UnlinkPartial(cls, idx);
+
+                pageClass[idx] = 0;
+                --PoolPages;
+                allocator.FreePage(allocator.PageAddress(idx));
+            }
+            else if (wasFull)
+            {
+                LinkPartial(cls, idx);
+            }
+        }
+
+        private uint FullMask(int cls)
+        {
+            return slotsPerPage[cls] == MaxSlots ? uint.MaxValue : (1U << slotsPerPage[cls]) - 1;
+        }
+
+        private void LinkPartial(int cls, int idx)
+        {
+            prevPartial[idx] = -1;
+            nextPartial[idx] = partialHeads[cls];
+            if (partialHeads[cls] >= 0)
+                prevPartial[partialHeads[cls]] = idx;
+
+            partialHeads[cls] = idx;
+        }
+
+        private void UnlinkPartial(int cls, int idx)
+        {
+            if (prevPartial[idx] >= 0)
+                nextPartial[prevPartial[idx]] = nextPartial[idx];
+            else
+                partialHeads[cls] = nextPartial[idx];
+
+            if (nextPartial[idx] >= 0)
+                prevPartial[nextPartial[idx]] = prevPartial[idx];
+        }
+
+        /*
+         * Dump in CSV as
+         *
+         *   zpage,stored,compressed_bytes,pool_pages,rejected,loaded,saved_pages
+         */
+        public void Dump()
+        {
+            Arch.LinuxConsole.Write("zpage,");
+            Arch.LinuxConsole.Write(StoredPages);
+            Arch.LinuxConsole.Write(",");
+            Arch.LinuxConsole.Write(CompressedBytes);
+            Arch.LinuxConsole.Write(",");
+            Arch.LinuxConsole.Write(PoolPages);
+            Arch.LinuxConsole.Write(",");
+            Arch.LinuxConsole.Write(RejectedPages);
+            Arch.LinuxConsole.Write(",");
+            Arch.LinuxConsole.Write(LoadedPages);
+            Arch.LinuxConsole.Write(",");
+            Arch.LinuxConsole.Write(StoredPages - PoolPages);
+            Arch.LinuxConsole.WriteLine();
+        }
+    }
+}
@@ -20,6 +20,69 @@ namespace ExpressOS.Kernel
         }
     }
 
+    /*
+     * Identifies a version of a Linux file by its device, inode number,
+     * modification time and size.
+     */
+    public struct FileIdentity
+    {
+        public ulong Device;
+        public ulong INode;
+        public uint ModificationTime;
+        public uint ModificationTimeNsec;
+        public long Size;
+
+        public bool IsValid { get { return INode != 0; } }
+
+        public bool Matches(FileIdentity rhs)
+        {
+            return Device == rhs.Device && INode == rhs.INode && ModificationTime == rhs.ModificationTime
+                && ModificationTimeNsec == rhs.ModificationTimeNsec && Size == rhs.Size;
+        }
+    }
+
+    /*
+     * The argument block of socketcall(), copied from the user at once.
+     */
+    public struct socketcall_args
+    {
+        public int a0;
+        public int a1;
+        public int a2;
+        public int a3;
+        public int a4;
+        public int a5;
+
+        public const int MaxArgs = 6;
+    }
+
+    /* struct mmsghdr of sendmmsg() / recvmmsg() */
+    public struct mmsghdr
+    {
+        public UserPtr msg_name;
+        public int msg_namelen;
+        public UserPtr msg_iov;
+        public int msg_iovlen;
+
+        public const int Size = 32;
+        public const int OFFSET_OF_NAMELEN = 4;
+        public const int OFFSET_OF_FLAGS = 24;
+        public const int OFFSET_OF_LEN = 28;
+
+        public static mmsghdr Deserialize(byte[] buf, int offset)
+        {
+            Contract.Requires(offset >= 0);
+            Contract.Requires(offset + Size <= buf.Length);
+
+            mmsghdr r;
+            r.msg_name = new UserPtr(Deserializer.ReadUInt(buf, offset)); offset += sizeof(uint);
+            r.msg_namelen = Deserializer.ReadInt(buf, offset); offset += sizeof(int);
+            r.msg_iov = new UserPtr(Deserializer.ReadUInt(buf, offset)); offset += sizeof(uint);
+            r.msg_iovlen = Deserializer.ReadInt(buf, offset);
+            return r;
+        }
+    }
+
     #region Binder IPC
     struct binder_write_read
     {
@@ -0,0 +1,217 @@
+﻿using System.Diagnostics.Contracts;
+
+namespace ExpressOS.Kernel
+{
+    /*
+     * Everything needed to load an ELF executable, parsed once and cached
+     * by the identity of the file. Repeated launches of the same binary,
+     * and of the dynamic linker, skip the ELF I/O entirely.
+     */
+    internal sealed class ELFLoadPlan
+    {
+        private const int CACHE_SIZE = 16;
+        private static ELFLoadPlan[] cache;
+        private static int cacheFinger;
+
+        private readonly FileIdentity identity;
+        internal readonly uint EntryPoint;
+        internal readonly ushort NumOfProgramHeader;
+        // Raw program header table, which is copied onto the stack for the dynamic linker
+        internal readonly byte[] ProgramHeaders;
+        internal readonly bool HasInterpreter;
+        internal readonly ASCIIString Interpreter;
+        private readonly ELFSegment[] segments;
+        // The segments are sorted by address and do not overlap
+        private readonly bool disjoint;
+
+        private ELFLoadPlan(FileIdentity identity, ELF32Header eh, byte[] programHeaders, bool hasInterpreter, ASCIIString interpreter, ELFSegment[] segments)
+        {
+            this.identity = identity;
+            this.EntryPoint = eh.EntryPoint;
+            this.NumOfProgramHeader = eh.NumOfProgramHeader;
+            this.ProgramHeaders = programHeaders;
+            this.HasInterpreter = hasInterpreter;
+            this.Interpreter = interpreter;
+            this.segments = segments;
+
+            disjoint = true;
+            for (var i = 1; i < segments.Length; ++i)
+            {
+                if (segments[i - 1].VirtualAddress + segments[i - 1].MemorySize > segments[i].VirtualAddress)
+                    disjoint = false;
+            }
+        }
+
+        internal static void Initialize()
+        {
+            cache = new ELFLoadPlan[CACHE_SIZE];
+            cacheFinger = 0;
+        }
+
+        internal static int Get(File file, out ELFLoadPlan plan)
+        {
+            var inode = file.inode.ArchINode;
+            var identity = inode == null ? new FileIdentity() : inode.Identity;
+
+            if (identity.IsValid)
+            {
+                for (var i = 0; i < cache.Length; ++i)
+                {
+                    if (cache[i] != null && cache[i].identity.Matches(identity))
+                    {
+                        plan = cache[i];
+                        return 0;
+                    }
+                }
+            }
+
+            var ret = Build(file, identity, out plan);
+            if (ret != 0 || !identity.IsValid)
+                return ret;
+
+            cache[cacheFinger] = plan;
+            cacheFinger = (cacheFinger + 1) % cache.Length;
+            return 0;
+        }
+
+        private static int Build(File file, FileIdentity identity, out ELFLoadPlan plan)
+        {
+            plan = null;
+
+            var buf = new byte[ELF32Header.Size];
+            uint pos = 0;
+            if (file.Read(buf, ref pos) != buf.Length)
+                return -ErrorCode.EINVAL;
+
+            var eh = ELF32Header.Read(buf);
+            if (eh.type != ELF32Header.ELF_TYPE_EXECUTABLE || eh.ProgramHeaderOffest == 0)
+                return -ErrorCode.ENOEXEC;
+
+            /*
+             * The table comes from the file, so it has to be sane before
+             * it is allocated: entries of the size of Elf32_Phdr, at most a
+             * page of them, all inside the file.
+             */
+            var tableSize = eh.NumOfProgramHeader * eh.ProgramHeaderSize;
+            if (eh.ProgramHeaderSize != ELF32ProgramHeader.Size || tableSize > Arch.ArchDefinition.PageSize
+                || (long)eh.ProgramHeaderOffest + tableSize > file.inode.Size)
+                return -ErrorCode.ENOEXEC;
+
+            // Read the whole program header table at once
+            var programHeaders = new byte[tableSize];
+            pos = eh.ProgramHeaderOffest;
+            if (programHeaders.Length > 0 && file.Read(programHeaders, ref pos) != programHeaders.Length)
+                return -ErrorCode.EINVAL;
+
+            var hasInterpreter = false;
+            var interpreter = new ASCIIString();
+            var loadSegments = 0;
+            for (var i = 0; i < eh.NumOfProgramHeader; ++i)
+            {
+                var ph = ELF32ProgramHeader.Read(programHeaders, i * eh.ProgramHeaderSize);
+                if (ph.type == ELF32ProgramHeader.PT_LOAD)
+                {
+                    ++loadSegments;
+                }
+                else if (ph.type == ELF32ProgramHeader.PT_INTERP && !hasInterpreter)
+                {
+                    if (ph.FileSize <= 0 || ph.FileSize > Arch.ArchDefinition.PageSize)
+                        return -ErrorCode.ENOEXEC;
+
+                    var interpreterBuf = new byte[ph.FileSize];
+                    pos = ph.offset;
+                    if (file.Read(interpreterBuf, ref pos) != interpreterBuf.Length)
+                        return -ErrorCode.EINVAL;
+
+                    interpreter = new ASCIIString(interpreterBuf);
+                    hasInterpreter = true;
+                }
+            }
+
+            var segments = new ELFSegment[loadSegments];
+            var n = 0;
+            for (var i = 0; i < eh.NumOfProgramHeader; ++i)
+            {
+                var ph = ELF32ProgramHeader.Read(programHeaders, i * eh.ProgramHeaderSize);
+                if (ph.type != ELF32ProgramHeader.PT_LOAD)
+                    continue;
+
+                // Round address to page boundary
+                var diff = Arch.ArchDefinition.PageOffset(ph.vaddr);
+                var memSize = (int)Arch.ArchDefinition.PageAlign((uint)ph.MemorySize);
+                var fileSize = ph.FileSize;
+
+                if (diff < 0 || ph.offset < diff || fileSize + diff > file.inode.Size || fileSize <= 0 || memSize <= 0)
+                    return -ErrorCode.EINVAL;
+
+                fileSize += diff;
+                if (fileSize > memSize)
+                    fileSize = memSize;
+
+                segments[n].Access = ph.ExpressOSAccessFlag;
+                segments[n].FileOffset = ph.offset - (uint)diff;
+                segments[n].FileSize = fileSize;
+                segments[n].VirtualAddress = new Pointer(ph.vaddr) - diff;
+                segments[n].MemorySize = memSize;
+                ++n;
+            }
+
+            plan = new ELFLoadPlan(identity, eh, programHeaders, hasInterpreter, interpreter, segments);
+            return 0;
+        }
+
+        internal int MapInSegments(File file, Process proc)
+        {
+            Contract.Requires(file != null && file.GhostOwner == proc);
+            Contract.Requires(proc.Space.GhostOwner == proc);
+
+            if (segments.Length == 0)
+                return 0;
+
+            var space = proc.Space;
+            var last = segments[segments.Length - 1];
+            if (disjoint && space.IsUnmapped(segments[0].VirtualAddress, last.VirtualAddress + last.MemorySize))
+            {
+                // The usual case: all segments go into a hole in one walk
+                var regions = new MemoryRegion[segments.Length];
+                for (var i = 0; i < segments.Length; ++i)
+                {
+                    var s = segments[i];
+                    regions[i] = new MemoryRegion(proc, s.Access, 0, file, s.FileOffset, s.FileSize, s.VirtualAddress, s.MemorySize, false);
+                }
+                space.InsertSorted(regions);
+            }
+            else
+            {
+                // Later segments replace the overlapped parts of earlier ones, as mmap() does
+                for (var i = 0; i < segments.Length; ++i)
+                {
+                    var s = segments[i];
+                    if (space.AddMapping(s.Access, 0, file, s.FileOffset, s.FileSize, s.VirtualAddress, s.MemorySize) != 0)
+                        return -ErrorCode.ENOMEM;
+                }
+            }
+
+            for (var i = 0; i < segments.Length; ++i)
+            {
+                var s = segments[i];
+                Arch.Trace.Log(Arch.Trace.Event.Map, (uint)proc.helperPid, s.VirtualAddress.ToUInt32(), (uint)s.MemorySize, s.Access, 0);
+
+                // Update brk
+                var segmentEnd = (s.VirtualAddress + s.MemorySize).ToUInt32();
+                if (segmentEnd > space.Brk)
+                    space.InitializeBrk(segmentEnd);
+            }
+            return 0;
+        }
+
+        private struct ELFSegment
+        {
+            internal uint Access;
+            internal uint FileOffset;
+            internal int FileSize;
+            internal Pointer VirtualAddress;
+            internal int MemorySize;
+        }
+    }
+}
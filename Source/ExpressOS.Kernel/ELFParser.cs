@@ -25,45 +25,43 @@ namespace ExpressOS.Kernel
         public const uint Size = 8 * 2 + 2 * 2 + 4 * 5 + 2 * 6;
 
         public const ushort ELF_TYPE_EXECUTABLE = 2;
-        private const int LengthOfAuxVector = 8;
+        private const int LengthOfAuxVector = 10;
+        private const int LengthOfStaticAuxVector = 4;
         // Aux vector
         private const uint AT_PHNUM = 5;
         private const uint AT_ENTRY = 9;
         private const uint AT_PHDR = 3;
 
+        /*
+         * Map in the program and its interpreter, and push the auxiliary
+         * vector of the program.
+         */
         public static int Parse(int helperPid, File file, Process proc, ref UserPtr stackTop)
+        {
+            return Parse(helperPid, file, proc, ref stackTop, false);
+        }
+
+        private static int Parse(int helperPid, File file, Process proc, ref UserPtr stackTop, bool isInterpreter)
         {
             Contract.Requires(file.GhostOwner == proc);
             Contract.Requires(proc.Space.GhostOwner == proc);
 
-            var buf = new byte[Size];
-            uint pos = 0;
-            if (file.Read(buf, ref pos) != buf.Length)
-                return -ErrorCode.EINVAL;
-
-            var eh = Read(buf);
-            if (eh.type != ELF32Header.ELF_TYPE_EXECUTABLE || eh.ProgramHeaderOffest == 0)
-                return -ErrorCode.ENOEXEC;
-
-            proc.EntryPoint = eh.EntryPoint;
-
-            ELF32ProgramHeader ph = new ELF32ProgramHeader();
-            var ret = FindInterpreter(file, eh, ref ph);
-            if (ret == -ErrorCode.EINVAL)
+            ELFLoadPlan plan;
+            var ret = ELFLoadPlan.Get(file, out plan);
+            if (ret != 0)
             {
-                Arch.Console.WriteLine("Malformed ELF file");
+                if (ret == -ErrorCode.EINVAL)
+                    Arch.Console.WriteLine("Malformed ELF file");
+
                 return ret;
             }
-            else if (ret == 0)
-            {
-                var interpreterBuf = new byte[ph.FileSize];
-                pos = ph.offset;
-                if (file.Read(interpreterBuf, ref pos) != interpreterBuf.Length)
-                    return -ErrorCode.EINVAL;
 
-                var interpreterName = new ASCIIString(interpreterBuf);
+            proc.EntryPoint = plan.EntryPoint;
+
+            if (plan.HasInterpreter)
+            {
                 ErrorCode ec;
-                var interpreter_inode = Arch.ArchFS.Open(helperPid, interpreterName, 0, 0, out ec);
+                var interpreter_inode = Arch.ArchFS.Open(helperPid, plan.Interpreter, 0, 0, out ec);
                 if (interpreter_inode == null)
                     return -ErrorCode.ENOENT;
 
@@ -74,17 +72,25 @@ namespace ExpressOS.Kernel
                  *
                  * This function will also override the entry point.
                  */
-                if (Parse(helperPid, interpreter, proc, ref stackTop) != 0)
+                if (Parse(helperPid, interpreter, proc, ref stackTop, true) != 0)
                     return -ErrorCode.EINVAL;
 
                 // So now let's copy the program header to the top of the stack, and push auxlirary vectors
-                PushProgramHeaderAndAuxliraryVectors(proc, file, eh, ref stackTop);
+                ret = PushProgramHeaderAndAuxliraryVectors(proc, plan, ref stackTop);
             }
+            else if (!isInterpreter)
+            {
+                // A static program still needs to find the time page
+                ret = PushStaticAuxliraryVectors(proc, ref stackTop);
+            }
+
+            if (ret != 0)
+                return ret;
 
-            return MapInSegments(file, proc, eh);
+            return plan.MapInSegments(file, proc);
         }
 
-        private static ELF32Header Read(byte[] buf)
+        internal static ELF32Header Read(byte[] buf)
         {
             var r = new ELF32Header();
             int off = 0;
@@ -106,91 +112,10 @@ namespace ExpressOS.Kernel
             return r;
         }
 
-        private static int FindInterpreter(File file, ELF32Header eh, ref ELF32ProgramHeader ret)
+        private static int PushProgramHeaderAndAuxliraryVectors(Process proc, ELFLoadPlan plan, ref UserPtr stackTop)
         {
-            var buf = new byte[ELF32ProgramHeader.Size];
-
-            uint pos = 0;
-            ushort i = 0;
-
-            while (i < eh.NumOfProgramHeader)
-            {
-                pos = (uint)(eh.ProgramHeaderOffest + eh.ProgramHeaderSize * i);
-                if (file.Read(buf, ref pos) != ELF32ProgramHeader.Size)
-                    return -ErrorCode.EINVAL;
-
-                ret = ELF32ProgramHeader.Read(buf);
-
-                if (ret.type == ELF32ProgramHeader.PT_INTERP)
-                    break;
-
-                ++i;
-            }
-            return i == eh.NumOfProgramHeader ? -ErrorCode.ENOENT : 0;
-        }
-
-        private static int MapInSegments(File file, Process proc, ELF32Header eh)
-        {
-            Contract.Requires(file != null && file.GhostOwner == proc);
-            Contract.Requires(proc.Space.GhostOwner == proc);
-
-            var buf = new byte[ELF32ProgramHeader.Size];
-
-            var ph = new ELF32ProgramHeader();
-            // At this point we need to map in all stuff in PT_LOAD
-            for (var i = 0; i < eh.NumOfProgramHeader; ++i)
-            {
-                var pos = (uint)(eh.ProgramHeaderOffest + eh.ProgramHeaderSize * i);
-                if (file.Read(buf, ref pos) != buf.Length)
-                    return -ErrorCode.EINVAL;
-
-                ph = ELF32ProgramHeader.Read(buf);
-
-                var size = ph.FileSize > ph.MemorySize ? ph.FileSize : ph.MemorySize;
-
-                if (ph.type != ELF32ProgramHeader.PT_LOAD)
-                    continue;
-
-                // Round address to page boundary
-
-                var diff = Arch.ArchDefinition.PageOffset(ph.vaddr);
-                var vaddr = new Pointer(ph.vaddr);
-                var offset = ph.offset;
-                var memSize = (int)Arch.ArchDefinition.PageAlign((uint)ph.MemorySize);
-                var fileSize = ph.FileSize;
-
-                if (diff < 0 || ph.offset < diff || fileSize + diff > file.inode.Size || fileSize <= 0 || memSize <= 0)
-                    return -ErrorCode.EINVAL;
-
-                vaddr -= diff;
-                offset -= (uint)diff;
-                fileSize += diff;
-
-                if (fileSize > memSize)
-                    fileSize = memSize;
-
-                if (proc.Space.AddMapping(ph.ExpressOSAccessFlag, 0, file, offset, fileSize, vaddr, memSize) != 0)
-                    return -ErrorCode.ENOMEM;
-
-                // Update brk
-
-                var segmentEnd = (vaddr + memSize).ToUInt32();
-                if (segmentEnd > proc.Space.Brk)
-                {
-                    proc.Space.InitializeBrk(segmentEnd);
-                }
-            }
-            return 0;
-        }
-
-        private static int PushProgramHeaderAndAuxliraryVectors(Process proc, File file, ELF32Header eh, ref UserPtr stackTop)
-        {
-            var programHeaderLength = eh.NumOfProgramHeader * eh.ProgramHeaderSize;
-            var buf = new byte[programHeaderLength];
-            uint pos = eh.ProgramHeaderOffest;
-            
-            if (file.Read(buf, ref pos) != programHeaderLength)
-                return -ErrorCode.ENOMEM;
+            var buf = plan.ProgramHeaders;
+            var programHeaderLength = buf.Length;
 
             stackTop -= programHeaderLength;
             UserPtr ph_ptr = stackTop;
@@ -205,11 +130,13 @@ namespace ExpressOS.Kernel
             aux_vector[0] = AT_PHDR;
             aux_vector[1] = ph_ptr.Value.ToUInt32();
             aux_vector[2] = AT_ENTRY;
-            aux_vector[3] = eh.EntryPoint;
+            aux_vector[3] = plan.EntryPoint;
             aux_vector[4] = AT_PHNUM;
-            aux_vector[5] = eh.NumOfProgramHeader;
-            aux_vector[6] = 0;
-            aux_vector[7] = 0;
+            aux_vector[5] = plan.NumOfProgramHeader;
+            aux_vector[6] = TimePage.AT_EXPRESSOS_TIMEPAGE;
+            aux_vector[7] = TimePage.Location;
+            aux_vector[8] = 0;
+            aux_vector[9] = 0;
 
             var auxVectorSize = sizeof(uint) * LengthOfAuxVector;
             stackTop -= auxVectorSize;
@@ -219,6 +146,21 @@ namespace ExpressOS.Kernel
 
             return 0;
         }
+
+        private static int PushStaticAuxliraryVectors(Process proc, ref UserPtr stackTop)
+        {
+            var aux_vector = new uint[LengthOfStaticAuxVector];
+            aux_vector[0] = TimePage.AT_EXPRESSOS_TIMEPAGE;
+            aux_vector[1] = TimePage.Location;
+            aux_vector[2] = 0;
+            aux_vector[3] = 0;
+
+            stackTop -= sizeof(uint) * LengthOfStaticAuxVector;
+            if (stackTop.Write(proc, aux_vector) != 0)
+                return -ErrorCode.ENOMEM;
+
+            return 0;
+        }
     }
 
     internal struct ELF32ProgramHeader
@@ -243,18 +185,18 @@ namespace ExpressOS.Kernel
 
         public const uint Size = 4 * 8;
 
-        public static ELF32ProgramHeader Read(byte[] buf)
+        public static ELF32ProgramHeader Read(byte[] buf, int offset)
         {
-            Contract.Requires(buf.Length == Size);
+            Contract.Requires(offset >= 0 && offset + Size <= buf.Length);
             var r = new ELF32ProgramHeader();
-            r.type = Deserializer.ReadUInt(buf, 0);
-            r.offset = Deserializer.ReadUInt(buf, sizeof(uint));
-            r.vaddr = Deserializer.ReadUInt(buf, sizeof(uint) * 2);
-            r.paddr = Deserializer.ReadUInt(buf, sizeof(uint) * 3);
-            r.FileSize = Deserializer.ReadInt(buf, sizeof(uint) * 4);
-            r.MemorySize = Deserializer.ReadInt(buf, sizeof(uint) * 5);
-            r.flags = Deserializer.ReadUInt(buf, sizeof(uint) * 6);
-            r.align = Deserializer.ReadUInt(buf, sizeof(uint) * 7);
+            r.type = Deserializer.ReadUInt(buf, offset);
+            r.offset = Deserializer.ReadUInt(buf, offset + sizeof(uint));
+            r.vaddr = Deserializer.ReadUInt(buf, offset + sizeof(uint) * 2);
+            r.paddr = Deserializer.ReadUInt(buf, offset + sizeof(uint) * 3);
+            r.FileSize = Deserializer.ReadInt(buf, offset + sizeof(uint) * 4);
+            r.MemorySize = Deserializer.ReadInt(buf, offset + sizeof(uint) * 5);
+            r.flags = Deserializer.ReadUInt(buf, offset + sizeof(uint) * 6);
+            r.align = Deserializer.ReadUInt(buf, offset + sizeof(uint) * 7);
             return r;
         }
 
@@ -0,0 +1,17 @@
+﻿namespace ExpressOS.Kernel
+{
+    /*
+     * The inode behind the fd returned by epoll_create(). It only carries
+     * the interest set of the instance.
+     */
+    internal sealed class EventPollINode : GenericINode
+    {
+        internal readonly PollSet Interest;
+
+        internal EventPollINode()
+            : base(INodeKind.EventPollINodeKind)
+        {
+            Interest = new PollSet();
+        }
+    }
+}
@@ -20,6 +20,7 @@ namespace ExpressOS.Kernel
             ScreenBufferINodeKind,
             SecureFSINodeKind,
             SocketINodeKind,
+            EventPollINodeKind,
         }
 
         public readonly INodeKind kind;
@@ -58,6 +59,8 @@ namespace ExpressOS.Kernel
         { get { return kind == INodeKind.SecureFSINodeKind ? (SecureFSInode)this : null; } }
         internal SocketINode SocketINode
         { get { return kind == INodeKind.SocketINodeKind ? (SocketINode)this : null; } }
+        internal EventPollINode EventPollINode
+        { get { return kind == INodeKind.EventPollINodeKind ? (EventPollINode)this : null; } }
         internal AlienSharedMemoryINode AlienSharedMemoryINode
         {
             get
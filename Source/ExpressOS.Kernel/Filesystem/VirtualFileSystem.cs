@@ -32,6 +32,10 @@ namespace ExpressOS.Kernel
         public const int SIZEOF_OLD_STAT = 32;
         private const int OFFSET_OF_SIZE_IN_STAT64 = 44;
         private const int OFFSET_OF_MODE_IN_STAT64 = 16;
+        private const int OFFSET_OF_DEV_IN_STAT64 = 0;
+        private const int OFFSET_OF_MTIME_IN_STAT64 = 72;
+        private const int OFFSET_OF_MTIME_NSEC_IN_STAT64 = 76;
+        private const int OFFSET_OF_INO_IN_STAT64 = 88;
         public const int SIZE_OF_STAT64 = 96;
         public const int S_IFMT = 0xf000;
         public const int S_IFDIR = 0x4000;
@@ -190,7 +194,7 @@ namespace ExpressOS.Kernel
             if (SyscallProfiler.Enable)
             {
                 var endTime = Arch.NativeMethods.l4api_get_system_clock();
-                SyscallProfiler.AccountOpen((int)inode.kind, (long)(endTime - startTime));
+                SyscallProfiler.AccountOpen(proc, (int)inode.kind, (long)(endTime - startTime));
             }
 
             return fd;
@@ -540,6 +544,17 @@ namespace ExpressOS.Kernel
             return Deserializer.ReadLong(buf, OFFSET_OF_SIZE_IN_STAT64);
         }
 
+        public static FileIdentity GetIdentityFromStat64(ByteBufferRef buf)
+        {
+            var r = new FileIdentity();
+            r.Device = (ulong)Deserializer.ReadLong(buf, OFFSET_OF_DEV_IN_STAT64);
+            r.INode = (ulong)Deserializer.ReadLong(buf, OFFSET_OF_INO_IN_STAT64);
+            r.ModificationTime = (uint)Deserializer.ReadInt(buf, OFFSET_OF_MTIME_IN_STAT64);
+            r.ModificationTimeNsec = (uint)Deserializer.ReadInt(buf, OFFSET_OF_MTIME_NSEC_IN_STAT64);
+            r.Size = GetSizeFromStat64(buf);
+            return r;
+        }
+
         public static void SetSizeFromStat64(ByteBufferRef buf, ulong size)
         {
             Deserializer.WriteULong(size, buf, OFFSET_OF_SIZE_IN_STAT64);
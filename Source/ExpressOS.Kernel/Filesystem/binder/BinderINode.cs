@@ -21,6 +21,22 @@
         // 8K of marshaling / unmarhsaling buffer
         internal const int MARSHAL_BUF_PAGES = 2;
 
+        /*
+         * Whether a thread of proc has work queued, which makes the binder
+         * fd readable. Transactions through Linux are only seen once the
+         * ioctl() returns, so this is the work that vbinder has queued.
+         */
+        internal static bool HasPendingWork(Process proc)
+        {
+            var t = Globals.Threads;
+            while ((t = t.Next) != null)
+            {
+                if (t.thr.Parent == proc && !t.thr.VBinderState.NoPendingMessages())
+                    return true;
+            }
+            return false;
+        }
+
         internal int Ioctl(Thread current, ref Arch.ExceptionRegisters pt_regs, uint cmd, UserPtr userBuf)
         {
             switch (cmd)
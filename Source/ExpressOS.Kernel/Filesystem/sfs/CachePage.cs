@@ -49,9 +49,12 @@ namespace ExpressOS.Kernel
 
         private static ByteBufferRef AllocFreeBuffer()
         {
-            var ret = Globals.PageAllocator.AllocPage();
-            ret.Clear();
-            return ret;
+            var ret = Globals.ZeroedPages.Take();
+            if (ret.isValid)
+                return ret;
+
+            // Zeroed by the allocator
+            return Globals.PageAllocator.AllocPage();
         }
 
         internal bool Load(SecureFSInode inode)
@@ -64,6 +64,15 @@ namespace ExpressOS.Kernel
             this.Owner = current;
         }
 
+        /*
+         * Whether the thread has never held a capability nor a message, so
+         * that the state can be handed on to another thread.
+         */
+        internal bool IsPristine()
+        {
+            return CapAllocId == 0 && MessageQueue.IsEmpty() && Completion == null;
+        }
+
         public int NewCapAllocId()
         {
             return ++CapAllocId;
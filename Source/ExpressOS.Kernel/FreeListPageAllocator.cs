@@ -13,18 +13,51 @@ namespace ExpressOS.Kernel
             [DllImport("glue")]
             internal static extern Pointer sel4_alloc_alloc(IntPtr handle, int size);
             [DllImport("glue")]
+            internal static extern Pointer sel4_alloc_alloc_raw(IntPtr handle, int size);
+            [DllImport("glue")]
             internal static extern void sel4_alloc_free(IntPtr handle, Pointer page, int size);
+            [DllImport("glue")]
+            internal static extern void sel4_clear_pages(IntPtr address, int size);
         }
 
         private IntPtr handle;
         private Pointer Start;
         private Pointer End;
 
+        /*
+         * Number of additional owners of each page that is shared
+         * copy-on-write, allocated when the first page gets shared.
+         */
+        private ushort[] shareCounts;
+
+        private int freePages;
+
+        /*
+         * A failed superpage allocation walks the whole free list, so none
+         * is tried again until the free pages grow past this count.
+         */
+        private int superPageRetryAt;
+
+        /* Notified when a page gets shared or freed, see PageReclaimer */
+        internal PageReclaimer Reclaimer;
+
         public void Initialize(Pointer start, int num_of_pages)
         {
             this.handle = NativeMethods.sel4_alloc_new(start, start + num_of_pages * Arch.ArchDefinition.PageSize);
             this.Start = start;
             this.End = start + (num_of_pages << Arch.ArchDefinition.PageShift);
+            this.freePages = num_of_pages;
+        }
+
+        public int PageCount
+        {
+            get { return (End - Start) >> Arch.ArchDefinition.PageShift; }
+        }
+
+        /* Free pages regardless of fragmentation */
+        public int FreePageCount
+        {
+            get { return freePages; }
         }
 
         public ByteBufferRef AllocPage()
@@ -32,13 +65,45 @@ namespace ExpressOS.Kernel
             return AllocPages(1);
         }
 
+        /* The pages are zeroed */
         public ByteBufferRef AllocPages(int pages)
+        {
+            Contract.Ensures(!Contract.Result<ByteBufferRef>().isValid ||
+                Contract.Result<ByteBufferRef>().Length == pages * Arch.ArchDefinition.PageSize);
+
+            return AllocPages(pages, true);
+        }
+
+        /* A naturally aligned, zeroed superpage, or Empty if none is free */
+        public ByteBufferRef AllocSuperPage()
+        {
+            var pages = Arch.ArchDefinition.SuperPageSize >> Arch.ArchDefinition.PageShift;
+            if (freePages < pages || freePages < superPageRetryAt)
+                return ByteBufferRef.Empty;
+
+            var r = AllocPages(pages, true);
+            superPageRetryAt = r.isValid ? 0 : freePages + pages;
+            return r;
+        }
+
+        /* The contents of the page are undefined, for callers that overwrite it */
+        public ByteBufferRef AllocPageRaw()
+        {
+            return AllocPages(1, false);
+        }
+
+        public ByteBufferRef AllocPagesRaw(int pages)
+        {
+            return AllocPages(pages, false);
+        }
+
+        private ByteBufferRef AllocPages(int pages, bool zeroed)
         {
             Contract.Ensures(!Contract.Result<ByteBufferRef>().isValid ||
                 Contract.Result<ByteBufferRef>().Length == pages * Arch.ArchDefinition.PageSize);
 
             var size = pages * Arch.ArchDefinition.PageSize;
-            var p = NativeMethods.sel4_alloc_alloc(this.handle, size);
+            var p = zeroed ? NativeMethods.sel4_alloc_alloc(this.handle, size) : NativeMethods.sel4_alloc_alloc_raw(this.handle, size);
 
             if (p == Pointer.Zero)
             {
@@ -47,6 +112,7 @@ namespace ExpressOS.Kernel
                 return ByteBufferRef.Empty;
             }
 
+            freePages -= pages;
             var r = new ByteBufferRef(p.ToIntPtr(), size);
             // Post-condition of ByteBufferRef
             Contract.Assume(r.Length == size);
@@ -55,6 +121,12 @@ namespace ExpressOS.Kernel
             return r;
         }
 
+        /* Zero the buffer bypassing the cache */
+        public void ClearPage(ByteBufferRef buf)
+        {
+            NativeMethods.sel4_clear_pages(buf.Location, buf.Length);
+        }
+
         public bool Contains(Pointer page)
         {
             return Start <= page && page < End;
@@ -67,11 +139,56 @@ namespace ExpressOS.Kernel
 
         public void FreePage(Pointer page)
         {
+            if (IsShared(page))
+            {
+                --shareCounts[PageNumber(page)];
+                return;
+            }
+
+            if (Reclaimer != null)
+                Reclaimer.Forget(page);
+
+            ++freePages;
             NativeMethods.sel4_alloc_free(handle, page, Arch.ArchDefinition.PageSize);
         }
 
+        /* Fails if the page has too many owners already */
+        public bool Share(Pointer page)
+        {
+            Contract.Requires(Contains(page));
+
+            if (shareCounts == null)
+                shareCounts = new ushort[PageCount];
+
+            var idx = PageNumber(page);
+            if (shareCounts[idx] == ushort.MaxValue)
+                return false;
+
+            if (Reclaimer != null)
+                Reclaimer.Forget(page);
+
+            ++shareCounts[idx];
+            return true;
+        }
+
+        public bool IsShared(Pointer page)
+        {
+            return shareCounts != null && Contains(page) && shareCounts[PageNumber(page)] != 0;
+        }
+
+        internal int PageNumber(Pointer page)
+        {
+            return (page - Start) >> Arch.ArchDefinition.PageShift;
+        }
+
+        internal Pointer PageAddress(int pageNumber)
+        {
+            return Start + (pageNumber << Arch.ArchDefinition.PageShift);
+        }
+
         public void FreePages(Pointer start, int pages)
         {
+            freePages += pages;
             NativeMethods.sel4_alloc_free(handle, start, pages * Arch.ArchDefinition.PageSize);
         }
     }
@@ -6,6 +6,11 @@ namespace ExpressOS.Kernel
     public static class Globals
     {
         public static FreeListPageAllocator PageAllocator;
+        public static PageReclaimer PageReclaimer;
+        public static CompressedPageStore CompressedPages;
+        /* Backs the anonymous pages that have only been read, see Pager */
+        public static Pointer ZeroPage;
+        public static ZeroedPagePool ZeroedPages;
         public static ThreadList Threads;
 
         public static ByteBufferRef LinuxIPCBuffer
@@ -34,6 +39,18 @@ namespace ExpressOS.Kernel
 
             PageAllocator = new FreeListPageAllocator();
             PageAllocator.Initialize(param.MainMemoryStart, param.MainMemorySize >> Arch.ArchDefinition.PageShift);
+            PageReclaimer = new PageReclaimer();
+            PageReclaimer.Initialize(PageAllocator);
+            PageAllocator.Reclaimer = PageReclaimer;
+            CompressedPages = new CompressedPageStore();
+            CompressedPages.Initialize(PageAllocator);
+
+            var zero = PageAllocator.AllocPage();
+            zero.Clear();
+            ZeroPage = new Pointer(zero.Location);
+
+            ZeroedPages = new ZeroedPagePool();
+            ZeroedPages.Initialize(PageAllocator);
 
             CompletionQueueAllocator = new FreeListPageAllocator();
             CompletionQueueAllocator.Initialize(param.CompletionQueueBase, param.CompletionQueueSize >> Arch.ArchDefinition.PageShift);
@@ -48,6 +65,11 @@ namespace ExpressOS.Kernel
             
             SecureFS.Initialize(Util.StringToByteArray("ExpressOS-security", false));
             ReadBufferUnmarshaler.Initialize();
+            ELFLoadPlan.Initialize();
+            TraceReplayer.Initialize();
+            Sched.Initialize();
+            Exec.Initialize();
+            MmuGather.Initialize();
         }
 
         public static ByteBufferRef AllocateAlignedCompletionBuffer(int len)
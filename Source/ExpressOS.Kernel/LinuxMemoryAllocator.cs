@@ -9,6 +9,11 @@ namespace ExpressOS.Kernel
         private uint FreePageCounts;
         private Pointer[] FreedPages;
 
+        /* Pages freed at the teardown of an address space, see FreeBulk() */
+        private const int MAX_BULK_PAGES_NUM = (int)Arch.ArchGlobals.MinimumIPCBufferSize / sizeof(int);
+        private int BulkPageCounts;
+        private Pointer[] BulkPages;
+
         [ContractInvariantMethod]
         private void ObjectInvariantMethod()
         {
@@ -33,6 +38,31 @@ namespace ExpressOS.Kernel
             FreedPages[FreePageCounts++] = addr;
         }
 
+        /*
+         * Queue a page to be returned with FlushBulk(). A whole address
+         * space goes back to Linux in one call this way, instead of one
+         * call per MAX_FREE_PAGES_NUM pages.
+         */
+        public void FreeBulk(Pointer addr)
+        {
+            if (BulkPages == null)
+                BulkPages = new Pointer[MAX_BULK_PAGES_NUM];
+
+            if (BulkPageCounts == MAX_BULK_PAGES_NUM)
+                FlushBulk();
+
+            BulkPages[BulkPageCounts++] = addr;
+        }
+
+        public void FlushBulk()
+        {
+            if (BulkPageCounts == 0)
+                return;
+
+            Arch.IPCStubs.linux_sys_free_linux_pages(BulkPages, BulkPageCounts);
+            BulkPageCounts = 0;
+        }
+
         public LinuxMemoryAllocator()
         {
             FreePageCounts = 0;
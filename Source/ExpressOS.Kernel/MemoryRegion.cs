@@ -10,6 +10,29 @@ namespace ExpressOS.Kernel
         public const uint FAULT_WRITE = Arch.L4FPage.L4_FPAGE_FAULT_WRITE;
         public const uint FAULT_EXEC = Arch.L4FPage.L4_FPAGE_FAULT_EXEC;
 
+        /*
+         * The access pattern given by madvise(), one of MADV_NORMAL,
+         * MADV_RANDOM and MADV_SEQUENTIAL. The pager picks how many pages
+         * around a fault it brings in by it.
+         */
+        public int Advice;
+
+        /*
+         * Set by MADV_NOHUGEPAGE and cleared by MADV_HUGEPAGE. Anonymous
+         * regions are backed with superpages by default, see Pager.
+         */
+        public bool NoHugePage;
+
+        /*
+         * Writes to a MAP_SHARED region are seen by every process that maps
+         * it, thus a forked child shares its pages writable instead of
+         * copy-on-write.
+         */
+        internal bool IsSharedMapping
+        {
+            get { return (Flags & Memory.MAP_SHARED) != 0; }
+        }
+
         // Create an empty user-space memory region
         // reserve the first page as well as the kernel space
         public static MemoryRegion CreateUserSpaceRegion(Process owner)
@@ -78,7 +101,7 @@ namespace ExpressOS.Kernel
             if (Access == newAccess)
                 return;
 
-            Arch.NativeMethods.l4api_flush_regions(space.impl._value, StartAddress, End, (int)(~newAccess & FAULT_MASK));
+            MmuGather.Flush(space, StartAddress, End, ~newAccess & FAULT_MASK);
             Access = newAccess;
         }
     }
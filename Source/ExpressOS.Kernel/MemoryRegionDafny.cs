@@ -119,7 +119,10 @@ namespace ExpressOS.Kernel
                 && prev.BackingFile.inode == next.BackingFile.inode));
 
             return same_inode
+                    && prev.IsFixed == next.IsFixed
                     && prev.Access == next.Access
+                    && prev.Advice == next.Advice
+                    && prev.NoHugePage == next.NoHugePage
                     && prev.End == next.StartAddress
                     && (prev.BackingFile == null || prev.FileEnd == next.FileOffset);
         }
@@ -0,0 +1,63 @@
+﻿namespace ExpressOS.Kernel
+{
+    /*
+     * Batches the revocation of user mappings within one request.
+     *
+     * Flush() only records the range. The native side merges the ranges
+     * of the same task into the largest naturally aligned fpages and
+     * unmaps them with as few calls as possible when Finish() runs, which
+     * is before the kernel replies to a system call or a page fault.
+     *
+     * A page removed from a working set can still be mapped until then,
+     * so it is handed to FreePage() instead of being freed right away.
+     */
+    public static class MmuGather
+    {
+        private const int MaxDeferredPages = 256;
+
+        private static Pointer[] deferredPages;
+        private static int deferredCount;
+        private static bool pending;
+
+        public static void Initialize()
+        {
+            deferredPages = new Pointer[MaxDeferredPages];
+            deferredCount = 0;
+            pending = false;
+        }
+
+        internal static void Flush(AddressSpace space, Pointer start, Pointer end, uint rights)
+        {
+            Arch.NativeMethods.l4api_gather_flush(space.impl._value, start, end, (int)rights);
+            pending = true;
+        }
+
+        /* Free a page of the PageAllocator or of Linux once it is unmapped */
+        internal static void FreePage(Pointer page)
+        {
+            if (deferredCount == MaxDeferredPages)
+                Finish();
+
+            deferredPages[deferredCount++] = page;
+        }
+
+        public static void Finish()
+        {
+            if (pending)
+            {
+                Arch.NativeMethods.l4api_gather_finish();
+                pending = false;
+            }
+
+            for (var i = 0; i < deferredCount; ++i)
+            {
+                var page = deferredPages[i];
+                if (Globals.PageAllocator.Contains(page))
+                    Globals.PageAllocator.FreePage(page);
+                else
+                    Globals.LinuxMemoryAllocator.Free(page);
+            }
+            deferredCount = 0;
+        }
+    }
+}
@@ -0,0 +1,288 @@
+﻿using System.Diagnostics.Contracts;
+
+namespace ExpressOS.Kernel
+{
+    /*
+     * Reclaims private pages when the page allocator runs low.
+     *
+     * A page is tracked when the pager puts it into a working set. A page
+     * read from the backing file of a read-only region is clean as long as
+     * it is never mapped writable and the kernel never writes into it, so
+     * it can be dropped and read back from the file on the next fault.
+     * Other pages are dirty, they are compressed into the
+     * CompressedPageStore instead. Tracking stops when the page gets
+     * shared copy-on-write or freed. Pages of superpages are not tracked,
+     * as a part of a superpage mapping cannot be revoked on its own.
+     *
+     * The tracked pages are scanned in the order of their physical
+     * addresses with a clock hand, in the manner of second chance. The
+     * hand clears the referenced bit of a page and revokes its mapping,
+     * so that the next access takes a cheap fault that sets the bit
+     * again. A page whose bit is still clear when the hand comes back is
+     * evicted.
+     *
+     * A dirty page that does not compress is kept and skipped by the hand
+     * until it is written again, which makes it worth another try.
+     *
+     * Each page has one owner. Shared pages are never tracked, therefore
+     * the owner and the user address identify the only mapping of a page.
+     */
+    public class PageReclaimer
+    {
+        private const byte PageTracked = 1;
+        private const byte PageReferenced = 2;
+        private const byte PageDirty = 4;
+        private const byte PageIncompressible = 8;
+
+        /* What the hand does to a tracked page, see Sweep() */
+        public const int SweepAged = 0;
+        public const int SweepDrop = 1;
+        public const int SweepCompress = 2;
+        public const int SweepKeep = 3;
+
+        private FreeListPageAllocator allocator;
+        private int pageCount;
+        private int hand;
+
+        /* Indexed by the page number in the allocator, allocated on the first Track() */
+        private byte[] state;
+        private AddressSpace[] owners;
+        private uint[] userPages;
+
+        /* Reclaim starts below the low watermark and stops at the high one */
+        public int LowWatermark;
+        public int HighWatermark;
+
+        public int ReclaimedPages;
+        public int CompressedPages;
+
+        public void Initialize(FreeListPageAllocator allocator)
+        {
+            this.allocator = allocator;
+            this.pageCount = allocator.PageCount;
+            this.hand = 0;
+            this.LowWatermark = pageCount / 64 + 16;
+            this.HighWatermark = 2 * LowWatermark;
+        }
+
+        internal void Track(AddressSpace space, UserPtr userPage, Pointer page, bool dirty)
+        {
+            if (!allocator.Contains(page) || allocator.IsShared(page))
+                return;
+
+            if (state == null)
+            {
+                state = new byte[pageCount];
+                owners = new AddressSpace[pageCount];
+                userPages = new uint[pageCount];
+            }
+
+            var idx = allocator.PageNumber(page);
+            state[idx] = Tracked(dirty);
+
+            owners[idx] = space;
+            userPages[idx] = userPage.Value.ToUInt32();
+        }
+
+        internal void MarkReferenced(Pointer page)
+        {
+            if (state == null || !allocator.Contains(page))
+                return;
+
+            var idx = allocator.PageNumber(page);
+            if (state[idx] != 0)
+                state[idx] |= PageReferenced;
+        }
+
+        /* The page is writable or has been written by the kernel */
+        internal void MarkDirty(Pointer page)
+        {
+            if (state == null || !allocator.Contains(page))
+                return;
+
+            var idx = allocator.PageNumber(page);
+            state[idx] = Dirtied(state[idx]);
+        }
+
+        /* The page is tracked and has not been written since it was read or marked clean */
+        internal bool IsClean(Pointer page)
+        {
+            if (state == null || !allocator.Contains(page))
+                return false;
+
+            var s = state[allocator.PageNumber(page)];
+            return s != 0 && (s & PageDirty) == 0;
+        }
+
+        /* The page gains another owner or is freed, stop tracking it */
+        internal void Forget(Pointer page)
+        {
+            if (state == null || !allocator.Contains(page))
+                return;
+
+            var idx = allocator.PageNumber(page);
+            state[idx] = 0;
+            owners[idx] = null;
+        }
+
+        /*
+         * The contents of the page may be discarded, see MADV_FREE. Returns
+         * whether the page is tracked.
+         */
+        internal bool MarkClean(Pointer page)
+        {
+            if (state == null || !allocator.Contains(page))
+                return false;
+
+            var idx = allocator.PageNumber(page);
+            if (state[idx] == 0)
+                return false;
+
+            state[idx] = PageTracked;
+            return true;
+        }
+
+        /*
+         * Free a clean page of space right away instead of waiting for the
+         * hand, see Pager.DropBehind(). Returns whether it has been freed.
+         */
+        internal bool DropClean(AddressSpace space, UserPtr userPage, Pointer page)
+        {
+            if (state == null || !allocator.Contains(page))
+                return false;
+
+            var idx = allocator.PageNumber(page);
+            if (state[idx] == 0 || (state[idx] & PageDirty) != 0 || owners[idx] != space)
+                return false;
+
+            Forget(page);
+            if (!space.EvictPage(userPage, page))
+                return false;
+
+            MmuGather.FreePage(page);
+            return true;
+        }
+
+        public static byte Tracked(bool dirty)
+        {
+            return dirty ? (byte)(PageTracked | PageReferenced | PageDirty) : (byte)(PageTracked | PageReferenced);
+        }
+
+        public static byte Dirtied(byte s)
+        {
+            return s == 0 ? s : (byte)((s | PageReferenced | PageDirty) & ~PageIncompressible);
+        }
+
+        /* The page has been offered to the CompressedPageStore, which rejected it */
+        public static byte Rejected(byte s)
+        {
+            return (byte)(s | PageIncompressible);
+        }
+
+        /*
+         * Move the hand over a tracked page. A referenced page only loses
+         * its referenced bit and stays dirty if it was, the others are
+         * dropped or compressed depending on the dirty bit. A page that
+         * has been rejected since its last write is kept.
+         */
+        public static int Sweep(ref byte s)
+        {
+            Contract.Requires(s != 0);
+
+            if ((s & PageReferenced) != 0)
+            {
+                s &= unchecked((byte)~PageReferenced);
+                return SweepAged;
+            }
+
+            if ((s & PageDirty) == 0)
+                return SweepDrop;
+
+            return (s & PageIncompressible) == 0 ? SweepCompress : SweepKeep;
+        }
+
+        /*
+         * Called when the kernel is idle, keeps the free pages above the low
+         * watermark. The pages of the ZeroedPagePool go back first, as
+         * they are free memory that has only been cleared ahead of time.
+         */
+        public void Balance()
+        {
+            if (allocator.FreePageCount >= LowWatermark)
+                return;
+
+            Globals.ZeroedPages.Drain(HighWatermark - allocator.FreePageCount);
+            if (state == null || allocator.FreePageCount >= LowWatermark)
+                return;
+
+            Reclaim(HighWatermark - allocator.FreePageCount);
+        }
+
+        /*
+         * Evict up to target pages. Two revolutions of the hand are enough
+         * to clear the referenced bits of all pages and then evict them.
+         * Returns the number of pages that have been freed.
+         */
+        public int Reclaim(int target)
+        {
+            if (state == null || target <= 0)
+                return 0;
+
+            var freed = 0;
+            for (var scanned = 0; scanned < 2 * pageCount && freed < target; ++scanned)
+            {
+                var idx = hand;
+                hand = hand + 1 == pageCount ? 0 : hand + 1;
+
+                if (state[idx] == 0)
+                    continue;
+
+                var userPage = new UserPtr(userPages[idx]);
+                var space = owners[idx];
+                var action = Sweep(ref state[idx]);
+                if (action == SweepKeep)
+                    continue;
+
+                if (action == SweepAged)
+                {
+                    MmuGather.Flush(space, userPage.Value, userPage.Value + Arch.ArchDefinition.PageSize, MemoryRegion.FAULT_MASK);
+                    continue;
+                }
+
+                var page = allocator.PageAddress(idx);
+                if (action == SweepDrop)
+                {
+                    Forget(page);
+                    if (!space.EvictPage(userPage, page))
+                        continue;
+
+                    ++ReclaimedPages;
+                }
+                else
+                {
+                    var r = space.CompressPage(userPage, page);
+                    if (r == CompressedPageStore.Incompressible)
+                    {
+                        state[idx] = Rejected(state[idx]);
+                        continue;
+                    }
+
+                    if (r < 0)
+                        Forget(page);
+
+                    // The page is stale, or the store is full for now
+                    if (r <= 0)
+                        continue;
+
+                    Forget(page);
+                    ++CompressedPages;
+                }
+
+                MmuGather.FreePage(page);
+                ++freed;
+            }
+
+            return freed;
+        }
+    }
+}
@@ -4,8 +4,59 @@ namespace ExpressOS.Kernel
 {
     public static class Pager
     {
+        /* Size of the window that is grabbed around a fault in an alien shared region */
+        private const int AlienGrabPages = 64;
+
+        /*
+         * Pages read in one go from the file of a MADV_SEQUENTIAL region,
+         * and the distance behind the fault from which its clean pages are
+         * dropped. The read fits into the IPC buffer.
+         */
+        private const int ReadAheadPages = 16;
+        private const int DropBehindPages = 2 * ReadAheadPages;
+
         public static void HandlePageFault(Process process, uint faultType, Pointer faultAddress, Pointer faultIP, out Pointer physicalPage, out uint permission)
         {
+            int pageShift;
+            HandlePageFault(process, faultType, faultAddress, faultIP, out physicalPage, out permission, out pageShift);
+        }
+
+        /*
+         * physicalPage is the page that backs faultAddress. The fault can be
+         * resolved with a mapping of 1 << pageShift bytes around it.
+         */
+        public static void HandlePageFault(Process process, uint faultType, Pointer faultAddress, Pointer faultIP, out Pointer physicalPage, out uint permission, out int pageShift)
+        {
+            HandlePageFault(process, null, faultType, faultAddress, faultIP, out physicalPage, out permission, out pageShift);
+        }
+
+        /*
+         * A fault of a user thread. Pages of alien shared regions are grabbed
+         * from Linux asynchronously, in which case current.AsyncReturn is set
+         * and HandleAlienPageCompletion() resolves the fault later.
+         */
+        public static void HandlePageFault(Thread current, uint faultType, Pointer faultAddress, Pointer faultIP, out Pointer physicalPage, out uint permission, out int pageShift)
+        {
+            HandlePageFault(current.Parent, current, faultType, faultAddress, faultIP, out physicalPage, out permission, out pageShift);
+        }
+
+        /* Set when OutOfMemory() has freed memory by killing another process */
+        private static bool retryFault;
+
+        private static void HandlePageFault(Process process, Thread current, uint faultType, Pointer faultAddress, Pointer faultIP, out Pointer physicalPage, out uint permission, out int pageShift)
+        {
+            // Terminates, as every retry kills a process
+            do
+            {
+                retryFault = false;
+                ResolvePageFault(process, current, faultType, faultAddress, faultIP, out physicalPage, out permission, out pageShift);
+            } while (retryFault);
+        }
+
+        private static void ResolvePageFault(Process process, Thread current, uint faultType, Pointer faultAddress, Pointer faultIP, out Pointer physicalPage, out uint permission, out int pageShift)
+        {
+            pageShift = Arch.ArchDefinition.PageShift;
+
             // Object invariants of Process
             Contract.Assume(process.Space.GhostOwner == process);
             Contract.Assume(process.Space.Head.GhostOwner == process);
@@ -18,7 +69,7 @@ namespace ExpressOS.Kernel
                 return;
             }
 
-            SyscallProfiler.EnterPageFault();
+            var profileStartTime = SyscallProfiler.EnterPageFault();
             var space = process.Space;
             var region = space.Find(faultAddress);
 
@@ -34,6 +85,52 @@ namespace ExpressOS.Kernel
                 {
                     physicalPage = PageIndex(mapped_in_page);
                     permission = region.Access & MemoryRegion.FAULT_MASK;
+
+                    if (physicalPage == Globals.ZeroPage)
+                    {
+                        if ((faultType & MemoryRegion.FAULT_WRITE) == 0)
+                        {
+                            permission &= ~MemoryRegion.FAULT_WRITE;
+                            return;
+                        }
+
+                        physicalPage = space.PromoteZeroPage(new UserPtr(PageIndex(faultAddress)));
+                        if (physicalPage == Pointer.Zero)
+                            OutOfMemory(process, current, out physicalPage, out permission);
+                        return;
+                    }
+
+                    /*
+                     * The page might be shared copy-on-write after a fork. Copy
+                     * it on a write fault, otherwise map it read-only.
+                     */
+                    if (Globals.PageAllocator.IsShared(physicalPage) && !region.IsSharedMapping)
+                    {
+                        if ((faultType & MemoryRegion.FAULT_WRITE) == 0)
+                        {
+                            permission &= ~MemoryRegion.FAULT_WRITE;
+                        }
+                        else
+                        {
+                            physicalPage = space.BreakCopyOnWrite(new UserPtr(PageIndex(faultAddress)), physicalPage);
+                            if (physicalPage == Pointer.Zero)
+                            {
+                                OutOfMemory(process, current, out physicalPage, out permission);
+                                return;
+                            }
+                        }
+                    }
+
+                    /*
+                     * The fault might come from the PageReclaimer revoking the
+                     * mapping, which records the access. A writable mapping
+                     * makes the page dirty as well.
+                     */
+                    if ((permission & MemoryRegion.FAULT_WRITE) != 0)
+                        Globals.PageReclaimer.MarkDirty(physicalPage);
+                    else
+                        Globals.PageReclaimer.MarkReferenced(physicalPage);
+
                     return;
                 }
 
@@ -43,14 +140,72 @@ namespace ExpressOS.Kernel
                 var shared_memory_region = IsAlienSharedRegion(region);
                 var ghost_page_from_fresh_memory = false;
 
+                if (space.IsCompressed(new UserPtr(PageIndex(faultAddress))))
+                {
+                    var loadStartTime = SyscallProfiler.EnterPageFault();
+                    physicalPage = space.LoadCompressedPage(new UserPtr(PageIndex(faultAddress)));
+                    if (physicalPage == Pointer.Zero)
+                    {
+                        OutOfMemory(process, current, out physicalPage, out permission);
+                        return;
+                    }
+
+                    SyscallProfiler.ExitPageLoad(process, loadStartTime);
+                    SyscallProfiler.ExitPageFault(process, profileStartTime);
+                    permission = region.Access & MemoryRegion.FAULT_MASK;
+                    return;
+                }
+
+                /*
+                 * Reads of untouched anonymous memory share the zero page. The
+                 * first write gets a private page, see PromoteZeroPage().
+                 */
+                if (!shared_memory_region && region.BackingFile == null && (faultType & MemoryRegion.FAULT_WRITE) == 0)
+                {
+                    space.AddIntoWorkingSet(new UserPtr(PageIndex(faultAddress)), Globals.ZeroPage);
+                    SyscallProfiler.ExitPageFault(process, profileStartTime);
+                    physicalPage = Globals.ZeroPage;
+                    permission = region.Access & MemoryRegion.FAULT_MASK & ~MemoryRegion.FAULT_WRITE;
+                    return;
+                }
+
+                if (!shared_memory_region && region.BackingFile != null && region.Advice == Memory.MADV_SEQUENTIAL
+                    && ReadAhead(space, region, PageIndex(faultAddress), ReadAheadPages) > 0)
+                {
+                    DropBehind(space, region, PageIndex(faultAddress));
+                    SyscallProfiler.ExitPageFault(process, profileStartTime);
+                    physicalPage = PageIndex(space.UserToVirt(new UserPtr(PageIndex(faultAddress))));
+                    permission = region.Access & MemoryRegion.FAULT_MASK;
+                    return;
+                }
+
+                if (!shared_memory_region && !region.NoHugePage
+                    && TryMapSuperPage(space, region, faultAddress, out physicalPage))
+                {
+                    SyscallProfiler.ExitPageFault(process, profileStartTime);
+                    permission = region.Access & MemoryRegion.FAULT_MASK;
+                    pageShift = Arch.ArchDefinition.SuperPageShift;
+                    return;
+                }
+
                 ByteBufferRef buf;
                 if (shared_memory_region)
                 {
+                    if (current != null && GrabAlienPages(current, region, faultType, faultAddress, profileStartTime))
+                    {
+                        physicalPage = Pointer.Zero;
+                        permission = MemoryRegion.FALUT_NONE;
+                        return;
+                    }
+
                     buf = Globals.LinuxMemoryAllocator.GetUserPage(process, faultType, ToShadowProcessAddress(faultAddress, region));
                     if (!buf.isValid)
                     {
-                        Arch.Console.WriteLine("pager: cannot map in alien page.");
-                        space.DumpAll();
+                        if (Arch.Console.RateLimit())
+                        {
+                            Arch.Console.WriteLine("pager: cannot map in alien page.");
+                            space.DumpAll();
+                        }
                         physicalPage = Pointer.Zero;
                         permission = MemoryRegion.FALUT_NONE;
                         return;
@@ -59,14 +214,14 @@ namespace ExpressOS.Kernel
                 }
                 else
                 {
-                    buf = Globals.PageAllocator.AllocPage();
+                    buf = region.BackingFile != null ? AllocPage() : AllocZeroedPage();
 
                     ghost_page_from_fresh_memory = true;
 
                     if (!buf.isValid)
                     {
-                        Arch.Console.WriteLine("Cannot allocate new pages");
-                        Utils.Panic();
+                        OutOfMemory(process, current, out physicalPage, out permission);
+                        return;
                     }
 
                     if (region.BackingFile != null)
@@ -93,10 +248,6 @@ namespace ExpressOS.Kernel
                         if (r < Arch.ArchDefinition.PageSize)
                             buf.ClearAfter(r);
                     }
-                    else
-                    {
-                        buf.Clear();
-                    }
                 }
 
                 Contract.Assert(shared_memory_region ^ ghost_page_from_fresh_memory);
@@ -104,7 +255,12 @@ namespace ExpressOS.Kernel
                 var page = new Pointer(buf.Location);
                 space.AddIntoWorkingSet(new UserPtr(PageIndex(faultAddress)), page);
 
-                SyscallProfiler.ExitPageFault();
+                // A page read from a file can be read back as long as it stays clean
+                if (!shared_memory_region)
+                    Globals.PageReclaimer.Track(space, new UserPtr(PageIndex(faultAddress)), page,
+                        region.BackingFile == null || (region.Access & MemoryRegion.FAULT_WRITE) != 0);
+
+                SyscallProfiler.ExitPageFault(process, profileStartTime);
                 physicalPage = page;
                 permission = region.Access & MemoryRegion.FAULT_MASK;
                 return;
@@ -127,7 +283,442 @@ namespace ExpressOS.Kernel
             return;
         }
 
-        private static bool IsAlienSharedRegion(MemoryRegion region)
+        /*
+         * No page can be allocated even after reclaim. The process that
+         * holds the most pages is killed with SIGKILL. If it is not the
+         * faulting one, the fault is retried on the memory it frees.
+         * Otherwise the fault fails: a kernel access through UserPtr
+         * returns an error to the syscall, and a fault of a user thread
+         * takes its process down, as it cannot make progress.
+         */
+        private static void OutOfMemory(Process process, Thread current, out Pointer physicalPage, out uint permission)
+        {
+            physicalPage = Pointer.Zero;
+            permission = MemoryRegion.FALUT_NONE;
+
+            var victim = SelectVictim(process);
+            if (Arch.Console.RateLimit())
+            {
+                Arch.Console.Write("pager: out of memory in process ");
+                Arch.Console.Write(process.Pid);
+                Arch.Console.Write(", victim ");
+                Arch.Console.Write(victim.Pid);
+                Arch.Console.Write(" holds ");
+                Arch.Console.Write(victim.Space.ResidentPages);
+                Arch.Console.WriteLine(" pages");
+            }
+
+            if (victim != process)
+            {
+                victim.Kill(Process.SIGKILL);
+                retryFault = true;
+                return;
+            }
+
+            if (current == null)
+                return;
+
+            process.Kill(Process.SIGKILL);
+            current.AsyncReturn = true;
+        }
+
+        /* The process with the largest resident set, process if it holds the most */
+        private static Process SelectVictim(Process process)
+        {
+            var victim = process;
+            var victimPages = process.Space.ResidentPages;
+
+            var t = Globals.Threads;
+            while ((t = t.Next) != null)
+            {
+                var p = t.thr.Parent;
+                if (p == victim)
+                    continue;
+
+                var pages = p.Space.ResidentPages;
+                if (pages > victimPages)
+                {
+                    victim = p;
+                    victimPages = pages;
+                }
+            }
+
+            return victim;
+        }
+
+        /*
+         * Back the whole superpage around faultAddress at once if it lies
+         * in an anonymous region and none of its pages is present yet.
+         * The region has to cover the whole aligned superpage, so heaps,
+         * stacks and large anonymous mappings qualify, unless they are
+         * advised with MADV_NOHUGEPAGE. Fails over to 4K pages when the
+         * allocator has no free superpage.
+         */
+        private static bool TryMapSuperPage(AddressSpace space, MemoryRegion region, Pointer faultAddress, out Pointer physicalPage)
+        {
+            physicalPage = Pointer.Zero;
+
+            var start = faultAddress & Arch.ArchDefinition.SuperPageIndexMask;
+            if (region.BackingFile != null || start < region.StartAddress || region.End < start + Arch.ArchDefinition.SuperPageSize)
+                return false;
+
+            if (!space.IsSuperPageEmpty(new UserPtr(start)))
+                return false;
+
+            var buf = Globals.PageAllocator.AllocSuperPage();
+            if (!buf.isValid)
+                return false;
+
+            var page = new Pointer(buf.Location);
+            space.AddSuperPageIntoWorkingSet(new UserPtr(start), page);
+            physicalPage = page + (PageIndex(faultAddress) - start);
+            return true;
+        }
+
+        /*
+         * Ask Linux for the absent pages around faultAddress, up to an
+         * aligned window of AlienGrabPages pages, in one message instead of
+         * one call per page. The faulting thread waits for the completion
+         * while the kernel serves other requests. Fails if the helper does
+         * not have the op, the caller then maps in the page synchronously.
+         */
+        private static bool GrabAlienPages(Thread current, MemoryRegion region, uint faultType, Pointer faultAddress, ulong profileStartTime)
+        {
+            if (!Arch.IPCStubs.HasOptionalOp(Arch.IPCStubs.OPTIONAL_GET_USER_PAGES_ASYNC))
+                return false;
+
+            const int windowSize = AlienGrabPages << Arch.ArchDefinition.PageShift;
+            var space = current.Parent.Space;
+            var faultPage = PageIndex(faultAddress);
+            var windowStart = faultAddress & ~(windowSize - 1);
+
+            var windowEnd = windowStart + windowSize;
+
+            // Fault around only ahead of sequential accesses, and never for random ones
+            if (region.Advice == Memory.MADV_SEQUENTIAL)
+            {
+                windowStart = faultPage;
+                windowEnd = faultPage + windowSize;
+            }
+            else if (region.Advice == Memory.MADV_RANDOM)
+            {
+                windowStart = faultPage;
+                windowEnd = faultPage + Arch.ArchDefinition.PageSize;
+            }
+
+            var start = faultPage;
+            while (start > region.StartAddress && start > windowStart
+                && space.UserToVirt(new UserPtr(start - Arch.ArchDefinition.PageSize)) == Pointer.Zero)
+                start -= Arch.ArchDefinition.PageSize;
+
+            var end = faultPage + Arch.ArchDefinition.PageSize;
+            while (end < region.End && end < windowEnd && space.UserToVirt(new UserPtr(end)) == Pointer.Zero)
+                end += Arch.ArchDefinition.PageSize;
+
+            var npages = (end - start) >> Arch.ArchDefinition.PageShift;
+            var buf = Globals.AllocateAlignedCompletionBuffer(npages * sizeof(int));
+            var shadowStart = ToShadowProcessAddress(start, region);
+            var completion = new AlienPageCompletion(current, buf, start, shadowStart, npages, faultAddress, profileStartTime);
+
+            var ret = Arch.IPCStubs.linux_sys_get_user_pages_async(current.Parent.helperPid, completion.handle,
+                new Pointer(buf.Location), faultType, shadowStart, npages);
+
+            if (ret < 0)
+            {
+                completion.Dispose();
+                return false;
+            }
+
+            Globals.CompletionQueue.Enqueue(completion);
+            current.AsyncReturn = true;
+            return true;
+        }
+
+        /*
+         * All grabbed pages enter the working set, so that the neighbours of
+         * the fault are present when they are touched. A page that is no
+         * longer wanted, because the region has changed or another fault has
+         * brought it in meanwhile, goes back to Linux.
+         */
+        public static void HandleAlienPageCompletion(AlienPageCompletion c, int ret)
+        {
+            if (c.Orphaned)
+            {
+                FreeAlienPages(c, ret);
+                return;
+            }
+
+            var current = c.thr;
+            var space = current.Parent.Space;
+
+            for (var i = 0; i < c.count; ++i)
+            {
+                var offset = Deserializer.ReadInt(c.buf, i * sizeof(int));
+                if (ret < 0 || offset < 0 || offset >= Arch.ArchGlobals.LinuxMainMemorySize)
+                    continue;
+
+                var page = Arch.ArchGlobals.LinuxMainMemoryStart + offset;
+                var userPage = c.start + (i << Arch.ArchDefinition.PageShift);
+                var region = space.Find(userPage);
+
+                if (region == null || !IsAlienSharedRegion(region)
+                    || ToShadowProcessAddress(userPage, region) != c.shadowStart + (i << Arch.ArchDefinition.PageShift)
+                    || space.UserToVirt(new UserPtr(userPage)) != Pointer.Zero)
+                {
+                    Globals.LinuxMemoryAllocator.Free(page);
+                    continue;
+                }
+
+                space.AddIntoWorkingSet(new UserPtr(userPage), page);
+            }
+
+            c.Dispose();
+            SyscallProfiler.ExitPageFault(current.Parent, c.profileStartTime);
+
+            var faultRegion = space.Find(c.faultAddress);
+            var physicalPage = PageIndex(space.UserToVirt(new UserPtr(c.faultAddress)));
+            if (faultRegion == null || physicalPage == Pointer.Zero)
+            {
+                if (Arch.Console.RateLimit())
+                {
+                    Arch.Console.WriteLine("pager: cannot map in alien page.");
+                    space.DumpAll();
+                }
+                return;
+            }
+
+            current.ReturnFromPageFault(c.faultAddress, physicalPage, faultRegion.Access & MemoryRegion.FAULT_MASK);
+        }
+
+        /* The faulting thread is gone, so all grabbed pages go back to Linux */
+        private static void FreeAlienPages(AlienPageCompletion c, int ret)
+        {
+            for (var i = 0; i < c.count && ret >= 0; ++i)
+            {
+                var offset = Deserializer.ReadInt(c.buf, i * sizeof(int));
+                if (offset >= 0 && offset < Arch.ArchGlobals.LinuxMainMemorySize)
+                    Globals.LinuxMemoryAllocator.Free(Arch.ArchGlobals.LinuxMainMemoryStart + offset);
+            }
+
+            c.Dispose();
+        }
+
+        /*
+         * Read the run of absent pages of a file-backed region from userPage
+         * on, up to maxPages, into a contiguous block with a single read.
+         * Returns the number of pages that have entered the working set.
+         */
+        private static int ReadAhead(AddressSpace space, MemoryRegion region, Pointer userPage, int maxPages)
+        {
+            var n = 0;
+            while (n < maxPages && userPage + (n << Arch.ArchDefinition.PageShift) < region.End)
+            {
+                var p = new UserPtr(userPage + (n << Arch.ArchDefinition.PageShift));
+                if (space.UserToVirt(p) != Pointer.Zero || space.IsCompressed(p))
+                    break;
+
+                ++n;
+            }
+
+            if (n == 0)
+                return 0;
+
+            var buf = n == 1 ? AllocPage() : Globals.PageAllocator.AllocPagesRaw(n);
+            if (!buf.isValid)
+            {
+                n = 1;
+                buf = AllocPage();
+                if (!buf.isValid)
+                    return 0;
+            }
+
+            var rel_pos = userPage - region.StartAddress;
+            uint pos = (uint)((ulong)rel_pos + region.FileOffset);
+
+            var readSizeLong = region.FileSize - rel_pos;
+            if (readSizeLong < 0)
+                readSizeLong = 0;
+            else if (readSizeLong > buf.Length)
+                readSizeLong = buf.Length;
+
+            var r = region.BackingFile.Read(buf, 0, (int)readSizeLong, ref pos);
+            if (r < 0)
+                r = 0;
+
+            if (r < buf.Length)
+                buf.ClearAfter(r);
+
+            var dirty = (region.Access & MemoryRegion.FAULT_WRITE) != 0;
+            for (var i = 0; i < n; ++i)
+            {
+                var p = new UserPtr(userPage + (i << Arch.ArchDefinition.PageShift));
+                var page = new Pointer(buf.Location) + (i << Arch.ArchDefinition.PageShift);
+                space.AddIntoWorkingSet(p, page);
+                Globals.PageReclaimer.Track(space, p, page, dirty);
+            }
+
+            return n;
+        }
+
+        /*
+         * A MADV_SEQUENTIAL region is not read again soon, so the clean
+         * pages that the reads have passed are freed right away instead
+         * of pushing out other pages later.
+         */
+        private static void DropBehind(AddressSpace space, MemoryRegion region, Pointer faultPage)
+        {
+            var end = faultPage - (DropBehindPages << Arch.ArchDefinition.PageShift);
+            if (end <= region.StartAddress || end > faultPage)
+                return;
+
+            var start = end - (ReadAheadPages << Arch.ArchDefinition.PageShift);
+            if (start < region.StartAddress || start > end)
+                start = region.StartAddress;
+
+            for (var p = start; p < end; p += Arch.ArchDefinition.PageSize)
+            {
+                var page = space.UserToVirt(new UserPtr(p));
+                if (page != Pointer.Zero)
+                    Globals.PageReclaimer.DropClean(space, new UserPtr(p), page);
+            }
+        }
+
+        /*
+         * Bring in the pages of [start, end) ahead of the faults for
+         * MAP_POPULATE and MADV_WILLNEED, then map them into the task at
+         * once. Pages of a file are read ReadAheadPages at a time.
+         * Alien shared regions are left to the faults, which grab their
+         * pages in batches already. Returns -ENOMEM if the pages cannot be
+         * allocated, the pages brought in so far stay.
+         */
+        internal static int Populate(Process process, Pointer start, Pointer end)
+        {
+            var space = process.Space;
+            start = PageIndex(start);
+
+            for (var r = space.Head.Next; r != null && r.StartAddress < end; r = r.Next)
+            {
+                if (r.IsFixed || r.IsSpecial || r.End <= start || IsAlienSharedRegion(r))
+                    continue;
+
+                var from = r.StartAddress < start ? start : r.StartAddress;
+                var to = r.End < end ? r.End : end;
+                var ok = PopulateRegion(process, r, from, to);
+                space.MapPresent(r, from, to);
+                if (!ok)
+                    return -ErrorCode.ENOMEM;
+            }
+
+            return 0;
+        }
+
+        /*
+         * Bring in every page of a MAP_SHARED region with a page of its own
+         * before a fork shares them, so that the processes never fault in
+         * different pages for the same address later.
+         */
+        internal static bool PopulateShared(Process process, MemoryRegion region)
+        {
+            if (region.IsSpecial)
+                return true;
+
+            var space = process.Space;
+            for (var addr = region.StartAddress; addr < region.End; addr += Arch.ArchDefinition.PageSize)
+            {
+                var userPage = new UserPtr(addr);
+                if (space.UserToVirt(userPage) == Pointer.Zero)
+                {
+                    Pointer physicalPage;
+                    uint permission;
+                    int pageShift;
+                    HandlePageFault(process, null, region.Access & MemoryRegion.FAULT_MASK, addr, Pointer.Zero, out physicalPage, out permission, out pageShift);
+                    if (physicalPage == Pointer.Zero)
+                        return false;
+                }
+
+                if (PageIndex(space.UserToVirt(userPage)) == Globals.ZeroPage && space.PromoteZeroPage(userPage) == Pointer.Zero)
+                    return false;
+            }
+
+            return true;
+        }
+
+        private static bool PopulateRegion(Process process, MemoryRegion region, Pointer start, Pointer end)
+        {
+            var space = process.Space;
+            var faultType = (region.Access & MemoryRegion.FAULT_WRITE) != 0 ? MemoryRegion.FAULT_WRITE : region.Access & MemoryRegion.FAULT_MASK;
+            var addr = start;
+
+            while (addr < end)
+            {
+                var userPage = new UserPtr(addr);
+                if (space.UserToVirt(userPage) != Pointer.Zero)
+                {
+                    addr += Arch.ArchDefinition.PageSize;
+                    continue;
+                }
+
+                if (region.BackingFile != null && !space.IsCompressed(userPage))
+                {
+                    var pages = (end - addr) >> Arch.ArchDefinition.PageShift;
+                    var n = ReadAhead(space, region, addr, pages < ReadAheadPages ? pages : ReadAheadPages);
+                    if (n == 0)
+                        return false;
+
+                    addr += n << Arch.ArchDefinition.PageShift;
+                    continue;
+                }
+
+                Pointer physicalPage;
+                uint permission;
+                int pageShift;
+                HandlePageFault(process, null, faultType, addr, Pointer.Zero, out physicalPage, out permission, out pageShift);
+                if (physicalPage == Pointer.Zero)
+                    return false;
+
+                addr = (addr & ~((1 << pageShift) - 1)) + (1 << pageShift);
+            }
+
+            return true;
+        }
+
+        /*
+         * Allocate a page for user memory, whose contents are overwritten by
+         * the caller. Pages are reclaimed when the allocator runs dry.
+         */
+        internal static ByteBufferRef AllocPage()
+        {
+            var buf = Globals.PageAllocator.AllocPageRaw();
+            if (buf.isValid)
+                return buf;
+
+            buf = Globals.ZeroedPages.Take();
+            if (buf.isValid)
+                return buf;
+
+            var reclaimer = Globals.PageReclaimer;
+            if (reclaimer.Reclaim(reclaimer.HighWatermark - Globals.PageAllocator.FreePageCount) == 0)
+                return buf;
+
+            MmuGather.Finish();
+            return Globals.PageAllocator.AllocPageRaw();
+        }
+
+        /* Allocate a zeroed page for user memory, from the ZeroedPagePool first */
+        internal static ByteBufferRef AllocZeroedPage()
+        {
+            var buf = Globals.ZeroedPages.Take();
+            if (buf.isValid)
+                return buf;
+
+            buf = AllocPage();
+            if (buf.isValid)
+                buf.Clear();
+
+            return buf;
+        }
+
+        internal static bool IsAlienSharedRegion(MemoryRegion region)
         {
             if ((region.Flags & Memory.MAP_SHARED) == 0)
                 return false;
@@ -169,4 +760,27 @@ namespace ExpressOS.Kernel
             return addr & Arch.ArchDefinition.PageIndexMask;
         }
     }
+
+    public sealed class AlienPageCompletion : ThreadCompletionEntryWithBuffer
+    {
+        public readonly Pointer start;
+        public readonly Pointer shadowStart;
+        public readonly int count;
+        public readonly Pointer faultAddress;
+        public readonly ulong profileStartTime;
+
+        /* Set when the thread has been killed before Linux replied */
+        internal bool Orphaned;
+
+        /* Keyed by a handle of its own, see CompletionQueue.ClearAllPendingCompletion() */
+        internal AlienPageCompletion(Thread current, ByteBufferRef buf, Pointer start, Pointer shadowStart, int count, Pointer faultAddress, ulong profileStartTime)
+            : base(current, Kind.AlienPageCompletionKind, Globals.CompletionQueue.NextFreeHandle(), buf)
+        {
+            this.start = start;
+            this.shadowStart = shadowStart;
+            this.count = count;
+            this.faultAddress = faultAddress;
+            this.profileStartTime = profileStartTime;
+        }
+    }
 }
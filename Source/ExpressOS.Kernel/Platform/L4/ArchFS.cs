@@ -22,11 +22,17 @@ namespace ExpressOS.Kernel.Arch
             var ret = IPCStubs.linux_sys_fstat64(helperPid, fd);
 
             uint size = 0;
+            var identity = new FileIdentity();
             if (ret >= 0)
+            {
                 size = (uint)FileSystem.GetSizeFromStat64(Globals.LinuxIPCBuffer);
+                identity = FileSystem.GetIdentityFromStat64(Globals.LinuxIPCBuffer);
+            }
 
             ec.Code = ErrorCode.NoError;
-            return new ArchINode(fd, size, helperPid);
+            var inode = new ArchINode(fd, size, helperPid);
+            inode.Identity = identity;
+            return inode;
         }
 
         internal static OpenFileCompletion OpenAndGetSizeAsync(Thread current, byte[] filename, int flags, int mode)
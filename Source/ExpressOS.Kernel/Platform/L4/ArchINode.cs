@@ -15,6 +15,8 @@ namespace ExpressOS.Kernel.Arch
 
         public uint ArchInodeSize;
         public readonly int helperPid;
+        // Set when the inode is opened synchronously, see ArchFS.Open()
+        internal FileIdentity Identity;
 
         internal ArchINode(int fd, uint size, int helperPid, INodeKind kind)
             : base(kind)
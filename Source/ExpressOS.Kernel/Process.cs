@@ -5,12 +5,15 @@ namespace ExpressOS.Kernel
     public class Process
     {
         internal uint EntryPoint;
+        internal readonly ASCIIString Name;
         public readonly AddressSpace Space;
         internal readonly Credential Credential;
         internal readonly AndroidApplicationInfo AppInfo;
         internal readonly byte[] SFSFilePrefix;
 
         internal int helperPid;
+        /* Returned by getpid(), see Exec.Fork() */
+        internal int Pid;
         internal uint ShadowBinderVMStart;
         internal UserPtr binderVMStart;
         internal int binderVMSize;
@@ -19,7 +22,29 @@ namespace ExpressOS.Kernel
         public const int STDOUT_FD = 1;
         public const int STDERR_FD = 2;
 
+        public const int SIGBUS = 7;
+        public const int SIGKILL = 9;
+
         internal readonly FileDescriptorTable Files;
+        internal SyscallProfiler.ProfileRecord ProfileRecord;
+        /* When a process launched at boot was started, until its first system call */
+        internal ulong LaunchTime;
+
+        /* The first thread, which getpid() names in setpriority() */
+        internal Thread MainThread;
+
+        /*
+         * RLIMIT_NICE and RLIMIT_RTPRIO, with the values that Android init
+         * gives every process. See Sched.
+         */
+        internal int NiceLimit;
+        internal int RTPrioLimit;
+        public const int DefaultNiceLimit = 40;
+
+        /* Exited threads kept for clone(), see Thread.Exit() */
+        private Thread parkedThreads;
+        private int parkedThreadCount;
+        private const int MaxParkedThreads = 8;
 
         const uint INITIAL_STACK_LOCATION = 0xb2000000;
 
@@ -37,6 +62,7 @@ namespace ExpressOS.Kernel
             Contract.Ensures(Space.GhostOwner == this);
             Contract.Ensures(Files.GhostOwner == this);
 
+            this.Name = name;
             this.AppInfo = appInfo;
             SFSFilePrefix = Util.StringToByteArray(appInfo.DataDir, false);
 
@@ -50,6 +76,83 @@ namespace ExpressOS.Kernel
                 Arch.ArchDefinition.UTCBSizeShift + Arch.ArchDefinition.MaxThreadPerTaskLog2);
             this.Space = new AddressSpace(this, archAddressSpace);
             this.Credential = SecurityManager.GetCredential(name, this);
+            this.NiceLimit = DefaultNiceLimit;
+            this.RTPrioLimit = 0;
+        }
+
+        internal bool ParkThread(Thread thr)
+        {
+            if (parkedThreadCount == MaxParkedThreads)
+                return false;
+
+            thr.NextParked = parkedThreads;
+            parkedThreads = thr;
+            ++parkedThreadCount;
+            return true;
+        }
+
+        internal Thread TakeParkedThread()
+        {
+            var thr = parkedThreads;
+            if (thr == null)
+                return null;
+
+            parkedThreads = thr.NextParked;
+            thr.NextParked = null;
+            --parkedThreadCount;
+            return thr;
+        }
+
+        /*
+         * Called on exit_group(). All threads go away, including the
+         * calling one and the parked ones, then the address space is torn
+         * down at once instead of region by region. The descriptors are
+         * closed, which matters to a forked child whose files share the
+         * inodes, and thus the Linux descriptors, of its parent.
+         */
+        public void Exit()
+        {
+            Thread thr;
+            while ((thr = Globals.Threads.TakeThreadOf(this)) != null)
+                thr.Kill();
+
+            // Parked threads have left the thread list already
+            while ((thr = TakeParkedThread()) != null)
+                thr.impl.Destroy();
+
+            CloseAllFiles();
+            Space.Destroy();
+            SyscallProfiler.ExitProcess(this);
+        }
+
+        /*
+         * Terminate the process on a fatal signal. There are no signal
+         * handlers, so the process goes down as on exit_group().
+         */
+        internal void Kill(int signal)
+        {
+            Arch.Console.Write("Process ");
+            Arch.Console.Write(Pid);
+            Arch.Console.Write(" (");
+            Arch.Console.Write(Name);
+            Arch.Console.Write(") killed by signal ");
+            Arch.Console.Write(signal);
+            Arch.Console.WriteLine();
+            Exit();
+        }
+
+        private void CloseAllFiles()
+        {
+            var descriptors = Files.descriptors;
+            for (var fd = 0; fd < descriptors.Length; ++fd)
+            {
+                var file = descriptors[fd];
+                if (file == null)
+                    continue;
+
+                descriptors[fd] = null;
+                file.Close();
+            }
         }
 
         [Pure]
@@ -1,93 +1,332 @@
 ﻿
 namespace ExpressOS.Kernel
 {
+    /*
+     * Latency profile of system calls, page faults and opens, kept both
+     * globally and per process.
+     *
+     * A system call is stamped on its thread when it enters the kernel, and
+     * it is accounted when the thread returns to user space, which is after
+     * the completion for asynchronous calls. Latencies are recorded in log2
+     * buckets of microseconds, from which p50 / p99 are estimated.
+     */
     public static class SyscallProfiler
     {
         public const int SOCKET_CALL_ID = 512;
         public const int PF_ID = SOCKET_CALL_ID + 30;
         public const int OPEN_TYPE_ID = PF_ID + 1;
-        public const int MAX_SYSCALLS = OPEN_TYPE_ID + 10;
+        /* Faults that load a page from the CompressedPageStore */
+        public const int ZPAGE_LOAD_ID = OPEN_TYPE_ID + 10;
+        public const int MAX_SYSCALLS = ZPAGE_LOAD_ID + 1;
 
-        private static SyscallStats[] stats;
+        /* Bucket i holds latencies in [2^(i-1), 2^i) us, bucket 0 holds 0 us. */
+        public const int HistogramBuckets = 32;
+
+        private const int GlobalPid = -1;
+        private const int ExitedPid = -2;
+
+        private static ProfileRecord globalRecord;
+        /* Records of the live processes that have been profiled */
+        private static ProfileRecord processRecords;
+        /* Sum of the records of the exited processes, see ExitProcess() */
+        private static ProfileRecord exitedRecord;
         public static bool Enable;
-        struct SyscallStats
+
+        private sealed class SyscallStats
         {
             public int invokeTimes;
-            public ulong startTime;
             public long totalTime;
+            public long maxTime;
+            public readonly int[] histogram;
+
+            public SyscallStats()
+            {
+                histogram = new int[HistogramBuckets];
+            }
+
+            public void Account(long time)
+            {
+                invokeTimes++;
+                totalTime += time;
+                if (time > maxTime)
+                    maxTime = time;
+
+                histogram[Bucket(time)]++;
+            }
+
+            public void Merge(SyscallStats other)
+            {
+                invokeTimes += other.invokeTimes;
+                totalTime += other.totalTime;
+                if (other.maxTime > maxTime)
+                    maxTime = other.maxTime;
+
+                for (var i = 0; i < HistogramBuckets; ++i)
+                    histogram[i] += other.histogram[i];
+            }
+
+            /*
+             * Upper bound of the bucket that holds the given percentile,
+             * clamped by the maximum latency.
+             */
+            public long Percentile(int percent)
+            {
+                var rank = ((long)invokeTimes * percent + 99) / 100;
+                long seen = 0;
+                for (var i = 0; i < HistogramBuckets; ++i)
+                {
+                    seen += histogram[i];
+                    if (seen >= rank)
+                    {
+                        var bound = i == 0 ? 0 : (1L << i) - 1;
+                        return bound < maxTime ? bound : maxTime;
+                    }
+                }
+                return maxTime;
+            }
+        }
+
+        internal sealed class ProfileRecord
+        {
+            internal readonly int Pid;
+            internal readonly ASCIIString Name;
+            internal ProfileRecord Next;
+            private readonly SyscallStats[] stats;
+
+            internal ProfileRecord(int pid, ASCIIString name, ProfileRecord next)
+            {
+                this.Pid = pid;
+                this.Name = name;
+                this.Next = next;
+                this.stats = new SyscallStats[MAX_SYSCALLS + 1];
+            }
+
+            internal void Account(int scno, long time)
+            {
+                if (stats[scno] == null)
+                    stats[scno] = new SyscallStats();
+
+                stats[scno].Account(time);
+            }
+
+            internal void Merge(ProfileRecord other)
+            {
+                for (var i = 0; i < MAX_SYSCALLS + 1; ++i)
+                {
+                    if (other.stats[i] == null)
+                        continue;
+
+                    if (stats[i] == null)
+                        stats[i] = new SyscallStats();
+
+                    stats[i].Merge(other.stats[i]);
+                }
+            }
+
+            internal void Dump()
+            {
+                for (var i = 0; i < MAX_SYSCALLS + 1; ++i)
+                {
+                    var s = stats[i];
+                    if (s == null || s.invokeTimes == 0)
+                        continue;
+
+                    Arch.LinuxConsole.Write("syscall,");
+                    Arch.LinuxConsole.Write(Pid);
+                    Arch.LinuxConsole.Write(",");
+                    Arch.LinuxConsole.Write(i);
+                    Arch.LinuxConsole.Write(",");
+                    Arch.LinuxConsole.Write(s.invokeTimes);
+                    Arch.LinuxConsole.Write(",");
+                    Arch.LinuxConsole.Write(s.totalTime);
+                    Arch.LinuxConsole.Write(",");
+                    Arch.LinuxConsole.Write(s.Percentile(50));
+                    Arch.LinuxConsole.Write(",");
+                    Arch.LinuxConsole.Write(s.Percentile(99));
+                    Arch.LinuxConsole.Write(",");
+                    Arch.LinuxConsole.Write(s.maxTime);
+
+                    for (var j = 0; j < HistogramBuckets; ++j)
+                    {
+                        Arch.LinuxConsole.Write(",");
+                        Arch.LinuxConsole.Write(s.histogram[j]);
+                    }
+                    Arch.LinuxConsole.WriteLine();
+                }
+            }
         }
 
         public static void Initialize()
         {
-            stats = new SyscallStats[MAX_SYSCALLS + 1];
+            globalRecord = new ProfileRecord(GlobalPid, new ASCIIString("*"), null);
+            processRecords = null;
+            exitedRecord = new ProfileRecord(ExitedPid, new ASCIIString("<exited>"), null);
             Enable = false;
         }
 
-        public static void EnterPageFault()
+        private static int Bucket(long time)
         {
-            EnterSyscall(PF_ID);
+            if (time <= 0)
+                return 0;
+
+            var b = Util.msb(time > uint.MaxValue ? uint.MaxValue : (uint)time);
+            return b < HistogramBuckets ? b : HistogramBuckets - 1;
         }
-        public static void ExitPageFault()
+
+        private static ProfileRecord GetRecord(Process proc)
         {
-            ExitSyscall(PF_ID);
+            if (proc.ProfileRecord == null)
+            {
+                processRecords = new ProfileRecord(proc.helperPid, proc.Name, processRecords);
+                proc.ProfileRecord = processRecords;
+            }
+            return proc.ProfileRecord;
         }
-        public static void EnterSocketcall(int scno)
+
+        /*
+         * Fold the record of an exiting process into exitedRecord, so that
+         * the list only holds the live processes.
+         */
+        public static void ExitProcess(Process proc)
         {
-            EnterSyscall(SOCKET_CALL_ID + scno);
+            var record = proc.ProfileRecord;
+            if (record == null)
+                return;
+
+            proc.ProfileRecord = null;
+            exitedRecord.Merge(record);
+
+            if (processRecords == record)
+            {
+                processRecords = record.Next;
+                return;
+            }
+
+            var prev = processRecords;
+            while (prev != null && prev.Next != record)
+                prev = prev.Next;
+
+            if (prev != null)
+                prev.Next = record.Next;
         }
 
-        public static void ExitSocketcall(int scno)
+        private static void Account(Process proc, int scno, long time)
         {
-            ExitSyscall(SOCKET_CALL_ID + scno);
+            globalRecord.Account(scno, time);
+            GetRecord(proc).Account(scno, time);
         }
 
-        public static void AccountOpen(int type, long time)
+        /*
+         * Page faults are resolved synchronously, thus the start time is
+         * kept by the caller. They can also nest inside a system call
+         * through UserPtr.
+         */
+        public static ulong EnterPageFault()
         {
-            AccountSyscall(OPEN_TYPE_ID + type, time);
+            return Enable ? Arch.NativeMethods.l4api_get_system_clock() : 0;
         }
 
-        private static void AccountSyscall(int scno, long time)
+        public static void ExitPageFault(Process proc, ulong startTime)
         {
-            if (!Enable)
+            if (!Enable || startTime == 0)
                 return;
 
-            stats[scno].invokeTimes++;
-            stats[scno].totalTime += time;
+            var now = Arch.NativeMethods.l4api_get_system_clock();
+            Account(proc, PF_ID, (long)(now - startTime));
         }
 
-        public static void EnterSyscall(int scno)
+        /*
+         * Account the in-flight system call of the thread as the socketcall
+         * instead of socketcall() itself.
+         */
+        public static void EnterSocketcall(Thread current, int scno)
+        {
+            if (current.ProfileStartTime != 0)
+                current.ProfileCall = SOCKET_CALL_ID + scno;
+        }
+
+        public static void AccountOpen(Process proc, int type, long time)
         {
             if (!Enable)
                 return;
 
-            stats[scno].invokeTimes++;
-            stats[scno].startTime = Arch.NativeMethods.l4api_get_system_clock();
+            Account(proc, OPEN_TYPE_ID + type, time);
+        }
+
+        public static void ExitPageLoad(Process proc, ulong startTime)
+        {
+            if (!Enable || startTime == 0)
+                return;
+
+            var now = Arch.NativeMethods.l4api_get_system_clock();
+            Account(proc, ZPAGE_LOAD_ID, (long)(now - startTime));
+        }
+
+        public static void EnterSyscall(Thread current, int scno)
+        {
+            if (!Enable || scno < 0 || scno >= SOCKET_CALL_ID)
+            {
+                current.ProfileStartTime = 0;
+                return;
+            }
+
+            current.ProfileCall = scno;
+            current.ProfileStartTime = Arch.NativeMethods.l4api_get_system_clock();
         }
 
-        public static void ExitSyscall(int scno)
+        /*
+         * Called when the thread returns to user space, either right away or
+         * from the completion of an asynchronous call.
+         */
+        public static void ExitSyscall(Thread current)
         {
+            var startTime = current.ProfileStartTime;
+            if (startTime == 0)
+                return;
+
+            current.ProfileStartTime = 0;
             if (!Enable)
                 return;
-            
+
             var now = Arch.NativeMethods.l4api_get_system_clock();
-            stats[scno].totalTime += (long)(now - stats[scno].startTime);
+            Account(current.Parent, current.ProfileCall, (long)(now - startTime));
         }
 
+        /*
+         * Dump in CSV. Each line is
+         *
+         *   syscall,pid,id,count,total,p50,p99,max,bucket0,...,bucket31
+         *
+         * where times are in microseconds, and pid is -1 for the aggregate
+         * of all processes. The process lines are preceded by
+         *
+         *   process,pid,name
+         *
+         * and the processes that have exited are summed up under pid -2.
+         */
         public static void Dump()
         {
-            for (int i = 0; i < MAX_SYSCALLS + 1; ++i)
+            Arch.LinuxConsole.WriteLine("profile,1");
+            globalRecord.Dump();
+            Globals.CompressedPages.Dump();
+            Globals.ZeroedPages.Dump();
+
+            for (var r = processRecords; r != null; r = r.Next)
             {
-                if (stats[i].invokeTimes != 0)
-                {
-                    Arch.LinuxConsole.Write("Syscall ");
-                    Arch.LinuxConsole.Write(i);
-                    Arch.LinuxConsole.Write(",");
-                    Arch.LinuxConsole.Write(stats[i].invokeTimes);
-                    Arch.LinuxConsole.Write(",");
-                    Arch.LinuxConsole.Write(stats[i].totalTime);
-                    Arch.LinuxConsole.WriteLine();
-                }
+                Arch.LinuxConsole.Write("process,");
+                Arch.LinuxConsole.Write(r.Pid);
+                Arch.LinuxConsole.Write(",");
+                Arch.LinuxConsole.Write(r.Name);
+                Arch.LinuxConsole.WriteLine();
+                r.Dump();
             }
+
+            Arch.LinuxConsole.Write("process,");
+            Arch.LinuxConsole.Write(ExitedPid);
+            Arch.LinuxConsole.Write(",");
+            Arch.LinuxConsole.Write(exitedRecord.Name);
+            Arch.LinuxConsole.WriteLine();
+            exitedRecord.Dump();
         }
     }
 
@@ -0,0 +1,214 @@
+﻿using System.Diagnostics.Contracts;
+
+namespace ExpressOS.Kernel
+{
+    /*
+     * epoll on top of PollSet. Every epoll instance keeps its own interest
+     * set, the kernel-owned fds are answered locally and only the
+     * Linux-backed fds are forwarded to the helper.
+     *
+     * All events are reported level-triggered. EPOLLET is accepted but
+     * does not suppress repeated notifications, which is safe for callers
+     * that drain the fd until EAGAIN. EPOLLERR and EPOLLHUP are reported
+     * even if the interest mask is empty.
+     *
+     * Several threads may wait on the same instance, so every call keeps
+     * the readiness of the set in its own array. A call that waits for
+     * Linux polls the kernel-owned fds again once the helper replies.
+     */
+    public static class EventPoll
+    {
+        public const int EPOLL_CTL_ADD = 1;
+        public const int EPOLL_CTL_DEL = 2;
+        public const int EPOLL_CTL_MOD = 3;
+
+        public const int EPOLLONESHOT = 1 << 30;
+
+        // struct epoll_event is packed on x86
+        public const int SIZE_OF_EPOLL_EVENT = 12;
+
+        public static int Create(Thread current, int size)
+        {
+            if (size <= 0)
+                return -ErrorCode.EINVAL;
+
+            var proc = current.Parent;
+            var inode = new EventPollINode();
+            var file = new File(proc, inode, FileFlags.ReadWrite, 0);
+
+            var fd = proc.GetUnusedFd();
+            proc.InstallFd(fd, file);
+            return fd;
+        }
+
+        public static int Ctl(Thread current, int epfd, int op, int fd, UserPtr eventPtr)
+        {
+            var proc = current.Parent;
+            int ret;
+            var ep = Lookup(proc, epfd, out ret);
+            if (ep == null)
+                return ret;
+
+            var file = proc.LookupFile(fd);
+            if (file == null)
+                return -ErrorCode.EBADF;
+
+            if (file.inode == ep)
+                return -ErrorCode.EINVAL;
+
+            var nested = file.inode.EventPollINode;
+            if (op == EPOLL_CTL_ADD && nested != null && nested.Interest.HasNestedSet())
+                return -ErrorCode.ELOOP;
+
+            uint events = 0;
+            uint data_lo = 0;
+            uint data_hi = 0;
+            if (op != EPOLL_CTL_DEL)
+            {
+                if (eventPtr.Read(current, out events) != 0
+                    || (eventPtr + sizeof(uint)).Read(current, out data_lo) != 0
+                    || (eventPtr + 2 * sizeof(uint)).Read(current, out data_hi) != 0)
+                    return -ErrorCode.EFAULT;
+            }
+
+            var data = ((ulong)data_hi << 32) | data_lo;
+            var set = ep.Interest;
+            set.Revalidate(proc);
+
+            switch (op)
+            {
+                case EPOLL_CTL_ADD:
+                    return set.Insert(file, fd, (int)events, data);
+                case EPOLL_CTL_MOD:
+                    return set.Modify(fd, (int)events, data);
+                case EPOLL_CTL_DEL:
+                    return set.Remove(fd);
+                default:
+                    return -ErrorCode.EINVAL;
+            }
+        }
+
+        public static int Wait(Thread current, ref Arch.ExceptionRegisters regs, int epfd, UserPtr events, int maxevents, int timeout)
+        {
+            if (maxevents <= 0)
+                return -ErrorCode.EINVAL;
+
+            var proc = current.Parent;
+            int ret;
+            var ep = Lookup(proc, epfd, out ret);
+            if (ep == null)
+                return ret;
+
+            var set = ep.Interest;
+            set.Revalidate(proc);
+            var revents = new short[set.Count];
+            var ready = set.PollLocal(revents);
+
+            if (set.LinuxCount == 0)
+            {
+                if (ready > 0 || timeout == 0)
+                    return WriteEvents(current, set, revents, events, maxevents);
+
+                return Net.WaitForTimeout(current, ref regs, timeout);
+            }
+
+            var nfds = set.LinuxCount;
+            var buf = Globals.AllocateAlignedCompletionBuffer(nfds * pollfd.Size);
+            if (!buf.isValid)
+                return -ErrorCode.ENOMEM;
+
+            set.WriteLinuxPollFds(buf);
+
+            var entry = new EventPollCompletion(current, ep, events, maxevents, buf);
+            ret = Arch.IPCStubs.PollAsync(proc.helperPid, current.impl._value.thread._value, new Pointer(buf.Location), nfds, ready > 0 ? 0 : timeout);
+
+            if (ret < 0)
+            {
+                entry.Dispose();
+                return ret;
+            }
+
+            Globals.CompletionQueue.Enqueue(entry);
+            current.SaveState(ref regs);
+            current.AsyncReturn = true;
+            return 0;
+        }
+
+        public static void HandleEventPollAsync(EventPollCompletion entry, int retval)
+        {
+            var current = entry.thr;
+            var b = entry.buf;
+
+            if (retval < 0 || retval * pollfd.Size > b.Length)
+            {
+                entry.Dispose();
+                current.ReturnFromCompletion(retval < 0 ? retval : -ErrorCode.ENOMEM);
+                return;
+            }
+
+            // The set may have changed while the call was waiting
+            var set = entry.inode.Interest;
+            set.Revalidate(current.Parent);
+            var revents = new short[set.Count];
+            set.PollLocal(revents);
+            set.ApplyLinuxReply(b, retval, revents);
+            var ret = WriteEvents(current, set, revents, entry.events, entry.maxevents);
+
+            entry.Dispose();
+            current.ReturnFromCompletion(ret);
+        }
+
+        private static EventPollINode Lookup(Process proc, int epfd, out int ret)
+        {
+            var file = proc.LookupFile(epfd);
+            if (file == null)
+            {
+                ret = -ErrorCode.EBADF;
+                return null;
+            }
+
+            var ep = file.inode.EventPollINode;
+            ret = ep == null ? -ErrorCode.EINVAL : 0;
+            return ep;
+        }
+
+        private static int WriteEvents(Thread current, PollSet set, short[] revents, UserPtr events, int maxevents)
+        {
+            var n = 0;
+            for (var i = 0; i < set.Count && n < maxevents; ++i)
+            {
+                if (revents[i] == 0)
+                    continue;
+
+                var flags = set.Flags(i);
+                var data = set.Data(i);
+                var p = events + n * SIZE_OF_EPOLL_EVENT;
+                if (p.Write(current, (int)(ushort)revents[i]) != 0
+                    || (p + sizeof(uint)).Write(current, (int)(uint)data) != 0
+                    || (p + 2 * sizeof(uint)).Write(current, (int)(uint)(data >> 32)) != 0)
+                    return -ErrorCode.EFAULT;
+
+                if ((flags & EPOLLONESHOT) != 0)
+                    set.Disarm(i);
+
+                ++n;
+            }
+            return n;
+        }
+    }
+
+    public sealed class EventPollCompletion : ThreadCompletionEntryWithBuffer
+    {
+        internal readonly EventPollINode inode;
+        public readonly UserPtr events;
+        public readonly int maxevents;
+
+        internal EventPollCompletion(Thread current, EventPollINode inode, UserPtr events, int maxevents, ByteBufferRef buf)
+            : base(current, Kind.EventPollCompletionKind, buf)
+        {
+            this.inode = inode;
+            this.events = events;
+            this.maxevents = maxevents;
+        }
+    }
+}
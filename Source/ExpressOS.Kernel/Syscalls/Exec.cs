@@ -7,6 +7,18 @@ namespace ExpressOS.Kernel
 {
     public static class Exec
     {
+        /*
+         * Pids of forked children start above PID_MAX_LIMIT of Linux, so
+         * they never collide with the pid of a helper.
+         */
+        private const int FirstForkedPid = 1 << 22;
+        private static int nextForkedPid;
+
+        public static void Initialize()
+        {
+            nextForkedPid = FirstForkedPid;
+        }
+
         const uint INITIAL_STACK_LOCATION = 0xb2000000;
         public const uint CLONE_VM = 0x00000100;     /* set if VM shared between processes */
         public const uint CLONE_FS = 0x00000200;     /* set if fs info shared between processes */
@@ -30,27 +42,60 @@ namespace ExpressOS.Kernel
         public const uint CLONE_NEWPID = 0x20000000;     /* New pid namespace */
         public const uint CLONE_NEWNET = 0x40000000;     /* New network namespace */
         public const uint CLONE_IO = 0x80000000;     /* Clone io context */
+        public const uint CSIGNAL = 0x000000ff;     /* signal mask to be sent at exit */
 
-        //
-        // We do sync read for this one, since it's simpler..
-        //
-        public static Process CreateProcess(ASCIIString path, ASCIIString[] argv, ASCIIString[] envp, AndroidApplicationInfo appInfo)
+        /*
+         * A shadow process on the Linux side, which serves the files and the
+         * binder of a process.
+         */
+        internal struct Helper
         {
-            var proc = new Process(path, appInfo);
-            Utils.Assert(!proc.Space.impl._value.isInvalid);
+            public int Pid;
+            public uint ShadowBinderVMStart;
+            public int WorkspaceFd;
+            public uint WorkspaceSize;
 
-            uint addr;
-            int workspace_fd;
-            uint workspace_size;
-            proc.helperPid = Arch.IPCStubs.linux_sys_take_helper(out addr, out workspace_fd, out workspace_size);
+            public static Helper Take()
+            {
+                Helper r;
+                r.Pid = Arch.IPCStubs.linux_sys_take_helper(out r.ShadowBinderVMStart, out r.WorkspaceFd, out r.WorkspaceSize);
+                return r;
+            }
+        }
 
-            if (proc.helperPid < 0)
+        public static Process CreateProcess(ASCIIString path, ASCIIString[] argv, ASCIIString[] envp, AndroidApplicationInfo appInfo)
+        {
+            return CreateProcess(path, argv, envp, appInfo, 0);
+        }
+
+        /*
+         * nice is the nice value of the main thread.
+         */
+        public static Process CreateProcess(ASCIIString path, ASCIIString[] argv, ASCIIString[] envp, AndroidApplicationInfo appInfo, int nice)
+        {
+            var helper = Helper.Take();
+            if (helper.Pid < 0)
             {
                 Arch.Console.WriteLine("CreateProcess: cannot get helper");
                 return null;
             }
 
-            proc.ShadowBinderVMStart = addr;
+            return CreateProcess(path, argv, envp, appInfo, nice, helper);
+        }
+
+        //
+        // We do sync read for this one, since it's simpler..
+        //
+        internal static Process CreateProcess(ASCIIString path, ASCIIString[] argv, ASCIIString[] envp, AndroidApplicationInfo appInfo, int nice, Helper helper)
+        {
+            var proc = new Process(path, appInfo);
+            Utils.Assert(!proc.Space.impl._value.isInvalid);
+
+            var workspace_fd = helper.WorkspaceFd;
+            var workspace_size = helper.WorkspaceSize;
+            proc.helperPid = helper.Pid;
+            proc.Pid = helper.Pid;
+            proc.ShadowBinderVMStart = helper.ShadowBinderVMStart;
 
             ErrorCode ec;
             var inode = Arch.ArchFS.Open(proc.helperPid, path, 0, 0, out ec);
@@ -65,6 +110,8 @@ namespace ExpressOS.Kernel
             // 4M Initial stack
             var stack_size = 4096 * Arch.ArchDefinition.PageSize;
             proc.Space.AddStackMapping(stack_top, stack_size);
+            Arch.Trace.Log(Arch.Trace.Event.Map, (uint)proc.helperPid, stack_top.Value.ToUInt32(), (uint)stack_size,
+                MemoryRegion.FAULT_READ | MemoryRegion.FAULT_WRITE, 0);
             stack_top += stack_size;
 
             var augmented_envp = CreateEnvpArrayWithWorkspace(envp, proc, workspace_fd, workspace_size);
@@ -125,8 +172,12 @@ namespace ExpressOS.Kernel
             proc.InstallFd(Process.STDERR_FD, file_stderr);
 
             var mainThread = Thread.Create(proc);
+            proc.MainThread = mainThread;
+            mainThread.Nice = nice;
+            Sched.Apply(mainThread);
 
-            if (appInfo != null)
+            /* Plain native programs carry an application info without a package */
+            if (appInfo != null && appInfo.PackageName != null)
             {
                 var p = appInfo.ToParcel();
                 Globals.LinuxIPCBuffer.CopyFrom(0, p);
@@ -197,20 +248,33 @@ namespace ExpressOS.Kernel
 
         public static int Clone(Thread current, uint flags, UserPtr newsp, UserPtr parent_tidptr, UserPtr child_tidptr, ref Arch.ExceptionRegisters pt_regs)
         {
+            // A clone without CLONE_VM is a fork, the low byte is the exit signal
+            if ((flags & ~CSIGNAL) == 0 && newsp == UserPtr.Zero)
+                return Fork(current, ref pt_regs);
+
             // Only support pthread_create right now
             if (flags != (CLONE_FILES | CLONE_FS | CLONE_VM | CLONE_SIGHAND
                 | CLONE_THREAD | CLONE_SYSVSEM | CLONE_DETACHED))
                 return -ErrorCode.EINVAL;
 
             var proc = current.Parent;
-            var thr = Thread.Create(proc);
+            var thr = proc.TakeParkedThread();
+            if (thr != null)
+            {
+                Sched.Inherit(thr, current);
+                thr.StartFromPool(ref pt_regs, newsp);
+                return thr.Tid;
+            }
 
+            thr = Thread.Create(proc);
             if (thr == null)
             {
                 Arch.Console.WriteLine("Failed to create thread");
                 return -ErrorCode.EINVAL;
             }
 
+            Sched.Inherit(thr, current);
+
             // Start the main thread
             // Skipping the int $0x80
             thr.Start(new Pointer(pt_regs.ip + 2), newsp.Value);
@@ -219,5 +283,81 @@ namespace ExpressOS.Kernel
 
             return thr.Tid;
         }
+
+        /*
+         * Create a child that starts with a copy-on-write copy of the
+         * address space of its parent, so that app processes can be
+         * spawned from a warmed-up template instead of loading every
+         * library from scratch.
+         *
+         * The child shares the Linux helper of its parent, as Linux has no
+         * way to fork a helper, thus the descriptors backed by Linux are
+         * shared as well. The files of the child take references of the
+         * inodes of the parent, so the Linux descriptor is closed only
+         * after both have closed it.
+         *
+         * The child gets a pid of its own, which getpid() returns and
+         * which the parent gets back. It is known to the kernel only:
+         * Linux still sees the helper of the parent, so signals and
+         * waitpid() cannot name the child, and the file offsets of Linux
+         * descriptors are tracked by each process on its own instead of
+         * being shared as POSIX requires.
+         */
+        public static int Fork(Thread current, ref Arch.ExceptionRegisters pt_regs)
+        {
+            var parent = current.Parent;
+            var proc = new Process(parent.Name, parent.AppInfo);
+            if (proc.Space.impl._value.isInvalid)
+                return -ErrorCode.ENOMEM;
+
+            proc.helperPid = parent.helperPid;
+            proc.Pid = nextForkedPid++;
+            proc.ShadowBinderVMStart = parent.ShadowBinderVMStart;
+            proc.binderVMStart = parent.binderVMStart;
+            proc.binderVMSize = parent.binderVMSize;
+            proc.ScreenEnabled = parent.ScreenEnabled;
+            proc.EntryPoint = parent.EntryPoint;
+
+            var descriptors = parent.Files.descriptors;
+            for (var fd = 0; fd < descriptors.Length; ++fd)
+            {
+                var f = descriptors[fd];
+                if (f == null || !proc.Files.IsAvailableFd(fd))
+                    continue;
+
+                var file = new File(proc, f.inode, f.flags, f.mode);
+                file.position = f.position;
+                proc.InstallFd(fd, file);
+            }
+
+            var ret = parent.Space.ForkInto(proc.Space);
+            if (ret < 0)
+            {
+                proc.Exit();
+                return ret;
+            }
+
+            var thr = Thread.Create(proc);
+            if (thr == null)
+            {
+                Arch.Console.WriteLine("Fork: failed to create thread");
+                proc.Exit();
+                return -ErrorCode.ENOMEM;
+            }
+
+            proc.MainThread = thr;
+            proc.NiceLimit = parent.NiceLimit;
+            proc.RTPrioLimit = parent.RTPrioLimit;
+            Sched.Inherit(thr, current);
+
+            // Exit() kills the thread along with the rest of the child
+            if (!thr.StartForkedChild(current, ref pt_regs))
+            {
+                proc.Exit();
+                return -ErrorCode.ENOMEM;
+            }
+
+            return proc.Pid;
+        }
     }
 }
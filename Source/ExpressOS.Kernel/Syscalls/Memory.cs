@@ -45,6 +45,7 @@ namespace ExpressOS.Kernel
         public const int MADV_SEQUENTIAL = 2;        /* expect sequential page references */
         public const int MADV_WILLNEED = 3;          /* will need these pages */
         public const int MADV_DONTNEED = 4;          /* don't need these pages */
+        public const int MADV_FREE = 8;              /* free pages only if memory pressure */
 
         /* common parameters: try to keep these consistent across architectures */
         public const int MADV_REMOVE = 9;            /* remove these pages & resources */
@@ -71,13 +72,11 @@ namespace ExpressOS.Kernel
 
             brk = Arch.ArchDefinition.PageAlign(brk);
 
-            if (brk < space.StartBrk || brk > AddressSpace.KERNEL_OFFSET
-                || brk <= oldBrk // Not handling shrink right now
-                )
+            if (brk < space.StartBrk || brk > AddressSpace.KERNEL_OFFSET || brk == oldBrk)
             {
                 return oldBrk;
             }
-            else if (space.AddHeapMapping(brk))
+            else if (brk < oldBrk ? space.RemoveHeapMapping(brk) : space.AddHeapMapping(brk))
             {
                 return brk;
             }
@@ -184,6 +183,10 @@ namespace ExpressOS.Kernel
             if (r < 0)
                 return r;
 
+            // Best effort as in Linux, the faults bring in what is left
+            if ((flags & MAP_POPULATE) != 0)
+                Pager.Populate(proc, targetAddr, targetAddr + memorySize);
+
             //
             // HACK for binder IPC
             //
@@ -278,7 +281,18 @@ namespace ExpressOS.Kernel
                 case MADV_NORMAL:
                 case MADV_RANDOM:
                 case MADV_SEQUENTIAL:
+                    return madviseAdvice(current, start, len, behavior);
+
+                case MADV_HUGEPAGE:
+                case MADV_NOHUGEPAGE:
+                    return madviseHugePage(current, start, len, behavior == MADV_NOHUGEPAGE);
+
                 case MADV_WILLNEED:
+                    return madviseWillNeed(current, start, len);
+
+                case MADV_FREE:
+                    return madviseFree(current, start, len);
+
                 case MADV_REMOVE:
                 case MADV_DONTFORK:
                 case MADV_DOFORK:
@@ -286,8 +300,6 @@ namespace ExpressOS.Kernel
                 case MADV_SOFT_OFFLINE:
                 case MADV_MERGEABLE:
                 case MADV_UNMERGEABLE:
-                case MADV_HUGEPAGE:
-                case MADV_NOHUGEPAGE:
                     return 0;
 
                 case MADV_DONTNEED:
@@ -314,9 +326,62 @@ namespace ExpressOS.Kernel
                 return -ErrorCode.EINVAL;
 
             var alignedLength = Arch.ArchDefinition.PageAlign((uint)len);
+            if (TimePage.Overlapped(start, alignedLength))
+                return -ErrorCode.EINVAL;
+
             var endPage = new UserPtr(start + alignedLength);
             current.Parent.Space.workingSet.Remove(current.Parent.Space, new UserPtr(start), endPage);
             return 0;
         }
+
+        /* The hint applies to the regions, see MemoryRegion.Advice */
+        private static int madviseAdvice(Thread current, uint start, int len, int advice)
+        {
+            if (Arch.ArchDefinition.PageOffset(start) != 0 || len < 0)
+                return -ErrorCode.EINVAL;
+
+            var alignedLength = Arch.ArchDefinition.PageAlign((uint)len);
+            if (alignedLength == 0)
+                return 0;
+
+            current.Parent.Space.UpdateAdviceRange(new Pointer(start), (int)alignedLength, advice);
+            return 0;
+        }
+
+        /* See MemoryRegion.NoHugePage */
+        private static int madviseHugePage(Thread current, uint start, int len, bool noHugePage)
+        {
+            if (Arch.ArchDefinition.PageOffset(start) != 0 || len < 0)
+                return -ErrorCode.EINVAL;
+
+            var alignedLength = Arch.ArchDefinition.PageAlign((uint)len);
+            if (alignedLength == 0)
+                return 0;
+
+            current.Parent.Space.UpdateHugePageRange(new Pointer(start), (int)alignedLength, noHugePage);
+            return 0;
+        }
+
+        private static int madviseWillNeed(Thread current, uint start, int len)
+        {
+            if (Arch.ArchDefinition.PageOffset(start) != 0 || len < 0)
+                return -ErrorCode.EINVAL;
+
+            var alignedLength = Arch.ArchDefinition.PageAlign((uint)len);
+            return Pager.Populate(current.Parent, new Pointer(start), new Pointer(start + alignedLength));
+        }
+
+        private static int madviseFree(Thread current, uint start, int len)
+        {
+            if (Arch.ArchDefinition.PageOffset(start) != 0 || len < 0)
+                return -ErrorCode.EINVAL;
+
+            var alignedLength = Arch.ArchDefinition.PageAlign((uint)len);
+            if (TimePage.Overlapped(start, alignedLength))
+                return -ErrorCode.EINVAL;
+
+            current.Parent.Space.MarkLazyFree(new UserPtr(start), new UserPtr(start + alignedLength));
+            return 0;
+        }
     }
 }
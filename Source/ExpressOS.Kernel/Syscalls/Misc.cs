@@ -153,14 +153,19 @@ namespace ExpressOS.Kernel
             var now = Arch.NativeMethods.l4api_get_system_clock();
             var diff = now - Epoch;
 
-            start.tv_sec += (uint)diff / 1000000;
+            start.tv_sec += (uint)(diff / 1000000);
             start.tv_nsec += (uint)((diff % 1000000) * 1000);
+            if (start.tv_nsec >= 1000000000)
+            {
+                start.tv_sec++;
+                start.tv_nsec -= 1000000000;
+            }
             return start;
         }
 
         public static int Getpid(Thread current)
         {
-            return current.Parent.helperPid;
+            return current.Parent.Pid;
         }
 
         public static int Getuid32(Thread current)
@@ -168,11 +173,6 @@ namespace ExpressOS.Kernel
             return current.Parent.Credential.Uid;
         }
 
-        public static int Getpriority(Thread current, int arg0, int arg1)
-        {
-            return 20;
-        }
-        
         public static int Nanosleep(Thread current, ref Arch.ExceptionRegisters regs, UserPtr rqtp, UserPtr rmtp)
         {
             timespec ts;
@@ -192,11 +192,5 @@ namespace ExpressOS.Kernel
             current.AsyncReturn = true;
             return 0;
         }
-
-        public static int Yield(Thread current, ref Arch.ExceptionRegisters regs)
-        {
-            // Arch.API.l4api_thread_yield();
-            return 0;
-        }
     }
 }
@@ -10,6 +10,9 @@ namespace ExpressOS.Kernel
         public const int POLLOUT = 0x4;
         public const int POLLERR = 0x8;
         public const int POLLHUP = 0x10;
+        public const int POLLNVAL = 0x20;
+
+        public const int MSG_TRUNC = 0x20;
 
         public const int SYS_SOCKET = 1;      /* sys_socket(2)                */
         public const int SYS_BIND = 2;        /* sys_bind(2)                  */
@@ -37,28 +40,50 @@ namespace ExpressOS.Kernel
             if (nfds < 0)
                 return -ErrorCode.EINVAL;
 
+            if (nfds == 0)
+                return WaitForTimeout(current, ref regs, timeout);
+
             var pollfd_size = pollfd.Size * nfds;
 
             var buf = Globals.AllocateAlignedCompletionBuffer(pollfd_size);
             if (!buf.isValid)
                 return -ErrorCode.ENOMEM;
 
-            var poll_entry = new PollCompletion(current, fds, nfds, buf);
-        
             if (fds.Read(current, buf, pollfd_size) != 0)
             {
-                poll_entry.Dispose();
+                Globals.CompletionQueueAllocator.FreePages(new Pointer(buf.Location), buf.Length >> Arch.ArchDefinition.PageShift);
                 return -ErrorCode.EFAULT;
             }
 
-            Contract.Assert(buf.Length >= pollfd_size);
-            if (!TranslateToLinuxFd(current, poll_entry, buf))
+            var set = current.PollSet;
+            set.Clear();
+            for (var i = 0; i < nfds; ++i)
             {
-                poll_entry.Dispose();
-                return -ErrorCode.EBADF;
+                Contract.Assert(i < nfds && nfds * pollfd.Size <= buf.Length);
+                var poll_struct = pollfd.Deserialize(buf, i * pollfd.Size);
+                set.Append(current.Parent, poll_struct.fd, poll_struct.events);
+            }
+
+            var ready = set.PollLocal();
+            int ret;
+
+            if (set.LinuxCount == 0)
+            {
+                // Answered locally, no need to go through Linux
+                ret = WriteUserPollFds(current, fds, set, buf);
+                Globals.CompletionQueueAllocator.FreePages(new Pointer(buf.Location), buf.Length >> Arch.ArchDefinition.PageShift);
+
+                if (ret < 0 || ready > 0)
+                    return ret < 0 ? ret : ready;
+
+                return WaitForTimeout(current, ref regs, timeout);
             }
 
-            var ret = Arch.IPCStubs.PollAsync(current.Parent.helperPid, current.impl._value.thread._value, new Pointer(buf.Location), nfds, timeout);
+            set.WriteLinuxPollFds(buf);
+            var poll_entry = new PollCompletion(current, fds, nfds, set, buf);
+
+            // Some kernel-owned fds are ready, only collect the state of the Linux fds without blocking
+            ret = Arch.IPCStubs.PollAsync(current.Parent.helperPid, current.impl._value.thread._value, new Pointer(buf.Location), set.LinuxCount, ready > 0 ? 0 : timeout);
 
             if (ret < 0)
             {
@@ -72,53 +97,43 @@ namespace ExpressOS.Kernel
             return 0;
         }
 
-        private static bool TranslateToLinuxFd(Thread current, PollCompletion poll_entry, ByteBufferRef b)
+        private static int WriteUserPollFds(Thread current, UserPtr fds, PollSet set, ByteBufferRef buf)
         {
-            Contract.Requires(b.Length >= poll_entry.fdMaps.Length * pollfd.Size);
-            var proc = current.Parent;
-            var nfds = poll_entry.fdMaps.Length;
+            Contract.Requires(set.Count * pollfd.Size <= buf.Length);
 
-            for (var i = 0; i < nfds; ++i)
-            {
-                Contract.Assert(i < nfds && nfds * pollfd.Size <= b.Length);
-                Contract.Assert(i + 1 <= nfds && (i + 1) * pollfd.Size <= nfds * pollfd.Size);
-                Contract.Assert((i + 1) * pollfd.Size <= nfds * pollfd.Size && nfds * pollfd.Size <= b.Length);
-                var poll_struct = pollfd.Deserialize(b, i * pollfd.Size);
-                var file = proc.LookupFile(poll_struct.fd);
-                if (file == null)
-                    return false;
+            set.WriteUserPollFds(buf);
+            if (fds.Write(current, new Pointer(buf.Location), set.Count * pollfd.Size) != 0)
+                return -ErrorCode.EFAULT;
 
-                // DEBUG
-                if (file.inode.LinuxFd < 0)
-                {
-                    Arch.Console.Write("Poll: transalte fd linux fd < 0 for fd=");
-                    Arch.Console.Write(poll_struct.fd);
-                    Arch.Console.Write(" kind=");
-                    Arch.Console.Write((int)file.inode.kind);
-                    Arch.Console.WriteLine();
-                }
+            return 0;
+        }
 
-                poll_entry.fdMaps[i] = poll_struct.fd;
-                poll_struct.fd = file.inode.LinuxFd;
-                poll_struct.Write(b, i * pollfd.Size);
-            }
-            return true;
+        /*
+         * Put the current thread to sleep when there is nothing that Linux
+         * can wake it up for. A negative timeout (in ms) sleeps forever.
+         */
+        internal static int WaitForTimeout(Thread current, ref Arch.ExceptionRegisters regs, int timeout)
+        {
+            if (timeout == 0)
+                return 0;
+
+            if (timeout > 0)
+                Globals.TimeoutQueue.Enqueue((ulong)timeout * 1000, current);
+
+            var c = new SleepCompletion(current);
+
+            Globals.CompletionQueue.Enqueue(c);
+            current.SaveState(ref regs);
+            current.AsyncReturn = true;
+            return 0;
         }
 
         public static int Select(Thread current, ref Arch.ExceptionRegisters regs, int maxfds, UserPtr inp, UserPtr outp, UserPtr exp, UserPtr tvp)
         {
-            var helper = new SelectHelper();
+            var helper = new SelectHelper(current.PollSet);
             int ret = 0;
 
-            ret = helper.AddUserFdList(current, inp, maxfds, POLLIN);
-            if (ret < 0)
-                return ret;
-
-            ret = helper.AddUserFdList(current, outp, maxfds, POLLOUT);
-            if (ret < 0)
-                return ret;
-
-            ret = helper.AddUserFdList(current, exp, maxfds, POLLERR);
+            ret = helper.Load(current, maxfds, inp, outp, exp);
             if (ret < 0)
                 return ret;
 
@@ -137,16 +152,28 @@ namespace ExpressOS.Kernel
                 timeout = (int)(tv.tv_sec * 1000 + tv.tv_usec / 1000);
             }
 
-            var nfds = helper.TotalFds;
+            var set = helper.Set;
+            var ready = set.PollLocal();
+
+            if (set.LinuxCount == 0)
+            {
+                ret = helper.WriteUserFdLists(current);
+                if (ret != 0)
+                    return ret;
+
+                return WaitForTimeout(current, ref regs, timeout);
+            }
+
+            var nfds = set.LinuxCount;
             var pollfd_size = pollfd.Size * nfds;
             var buf = Globals.AllocateAlignedCompletionBuffer(pollfd_size);
             if (!buf.isValid)
                 return -ErrorCode.ENOMEM;
 
-            helper.WritePollFds(buf);
+            set.WriteLinuxPollFds(buf);
 
-            var select_entry = new SelectCompletion(current, maxfds, inp, outp, exp, helper, buf);
-            ret = Arch.IPCStubs.PollAsync(current.Parent.helperPid, current.impl._value.thread._value, new Pointer(buf.Location), nfds, timeout);
+            var select_entry = new SelectCompletion(current, helper, buf);
+            ret = Arch.IPCStubs.PollAsync(current.Parent.helperPid, current.impl._value.thread._value, new Pointer(buf.Location), nfds, ready > 0 ? 0 : timeout);
 
             if (ret < 0)
             {
@@ -163,8 +190,7 @@ namespace ExpressOS.Kernel
         public static void HandlePollAsync(PollCompletion entry, int ret)
         {
             var current = entry.thr;
-            var proc = current.Parent;
-            if (ret <= 0)
+            if (ret < 0)
             {
                 entry.Dispose();
                 current.ReturnFromCompletion(ret);
@@ -182,48 +208,11 @@ namespace ExpressOS.Kernel
                 return;
             }
 
-            // Translate fds back into fd in ExpressOS
-            for (var i = 0; i < ret; ++i)
-            {
-                Contract.Assert(i < ret && ret * pollfd.Size <= b.Length);
-                Contract.Assert(i + 1 <= ret && (i + 1) * pollfd.Size <= ret * pollfd.Size);
-                Contract.Assert((i + 1) * pollfd.Size <= ret * pollfd.Size && ret * pollfd.Size <= b.Length);
-                var poll_struct = pollfd.Deserialize(b, i * pollfd.Size);
-                var expressos_fd = -1;
-                for (var j = 0; j < entry.fdMaps.Length; ++j)
-                {
-                    var file = proc.LookupFile(entry.fdMaps[j]);
-                    if (file == null)
-                        continue;
-
-                    if (file.inode.LinuxFd == poll_struct.fd)
-                    {
-                        expressos_fd = entry.fdMaps[j];
-                        break;
-                    }
-                }
-
-                if (expressos_fd == -1)
-                {
-                    // DEBUG
-                    Arch.Console.Write("poll_async: cannot find ExpressOS fd for fd ");
-                    Arch.Console.Write(poll_struct.fd);
-                    Arch.Console.Write(" i=");
-                    Arch.Console.Write(i);
-                    Arch.Console.Write(" poll_ret=");
-                    Arch.Console.Write(ret);
-                    Arch.Console.Write(" nfds=");
-                    Arch.Console.Write(entry.fdMaps.Length);
-                    Arch.Console.WriteLine();
-                    ret = -ErrorCode.EBADF;
-                    break;
-                }
-
-                // Write result back
-                var p_user_entry = entry.userFdBuf + i * pollfd.Size;
-                p_user_entry.Write(current, expressos_fd);
-                (p_user_entry + pollfd.OFFSET_OF_REVENTS).Write(current, poll_struct.revents);
-            }
+            // Merge the state of the Linux fds with the local ones, and write them back in the order of the user
+            var ready = entry.set.ApplyLinuxReply(b, ret);
+            ret = WriteUserPollFds(current, entry.userFdBuf, entry.set, b);
+            if (ret == 0)
+                ret = ready;
 
             entry.Dispose();
             current.ReturnFromCompletion(ret);
@@ -232,84 +221,64 @@ namespace ExpressOS.Kernel
         public static int socketcall(Thread current, ref Arch.ExceptionRegisters regs, int call, UserPtr argPtr)
         {
             int err = 0;
-            int a0, a1, a2, a3, a4, a5;
+            socketcall_args args;
+
+            if (argPtr.Read(current, out args, SocketcallArgCount(call)) != 0)
+                return -ErrorCode.EFAULT;
 
-            SyscallProfiler.EnterSocketcall(call);
+            SyscallProfiler.EnterSocketcall(current, call);
             switch (call)
             {
                 case SYS_SOCKET:
-                    if (argPtr.Read(current, out a0) != 0 || (argPtr + sizeof(int)).Read(current, out a1) != 0
-                        || (argPtr + sizeof(int) * 2).Read(current, out a2) != 0)
-                        return -ErrorCode.EFAULT;
-
-                    err = Socket(current, ref regs, a0, a1, a2);
+                    err = Socket(current, ref regs, args.a0, args.a1, args.a2);
                     break;
 
                 case SYS_BIND:
-                    if (argPtr.Read(current, out a0) != 0 || (argPtr + sizeof(int)).Read(current, out a1) != 0
-                        || (argPtr + sizeof(int) * 2).Read(current, out a2) != 0)
-                        return -ErrorCode.EFAULT;
-
-                    err = Bind(current, ref regs, a0, new UserPtr(a1), a2);
+                    err = Bind(current, ref regs, args.a0, new UserPtr(args.a1), args.a2);
                     break;
 
                 case SYS_CONNECT:
-                    if (argPtr.Read(current, out a0) != 0 || (argPtr + sizeof(int)).Read(current, out a1) != 0
-                        || (argPtr + sizeof(int) * 2).Read(current, out a2) != 0)
-                        return -ErrorCode.EFAULT;
-
-                    err = Connect(current, ref regs, a0, new UserPtr(a1), a2);
+                    err = Connect(current, ref regs, args.a0, new UserPtr(args.a1), args.a2);
                     break;
 
                 case SYS_GETSOCKNAME:
-                    if (argPtr.Read(current, out a0) != 0 || (argPtr + sizeof(int)).Read(current, out a1) != 0
-                        || (argPtr + sizeof(int) * 2).Read(current, out a2) != 0)
-                        return -ErrorCode.EFAULT;
+                    err = Getsockname(current, ref regs, args.a0, new UserPtr(args.a1), new UserPtr(args.a2));
+                    break;
 
-                    err = Getsockname(current, ref regs, a0, new UserPtr(a1), new UserPtr(a2));
+                case SYS_SEND:
+                    err = Sendto(current, ref regs, args.a0, new UserPtr(args.a1), args.a2, args.a3, UserPtr.Zero, 0);
                     break;
 
-                case SYS_SENDTO:
-                    if (argPtr.Read(current, out a0) != 0 || (argPtr + sizeof(int)).Read(current, out a1) != 0
-                        || (argPtr + sizeof(int) * 2).Read(current, out a2) != 0 || (argPtr + sizeof(int) * 3).Read(current, out a3) != 0
-                        || (argPtr + sizeof(int) * 4).Read(current, out a4) != 0 || (argPtr + sizeof(int) * 5).Read(current, out a5) != 0)
-                        return -ErrorCode.EFAULT;
+                case SYS_RECV:
+                    err = RecvFrom(current, args.a0, new UserPtr(args.a1), args.a2, args.a3, UserPtr.Zero, UserPtr.Zero);
+                    break;
 
-                    err = Sendto(current, a0, new UserPtr(a1), a2, a3, new UserPtr(a4), a5);
+                case SYS_SENDTO:
+                    err = Sendto(current, ref regs, args.a0, new UserPtr(args.a1), args.a2, args.a3, new UserPtr(args.a4), args.a5);
                     break;
 
                 case SYS_RECVFROM:
-                    if (argPtr.Read(current, out a0) != 0 || (argPtr + sizeof(int)).Read(current, out a1) != 0
-                        || (argPtr + sizeof(int) * 2).Read(current, out a2) != 0 || (argPtr + sizeof(int) * 3).Read(current, out a3) != 0
-                        || (argPtr + sizeof(int) * 4).Read(current, out a4) != 0 || (argPtr + sizeof(int) * 5).Read(current, out a5) != 0)
-                        return -ErrorCode.EFAULT;
-
-                    err = RecvFrom(current, a0, new UserPtr(a1), a2, a3, new UserPtr(a4), new UserPtr(a5));
+                    err = RecvFrom(current, args.a0, new UserPtr(args.a1), args.a2, args.a3, new UserPtr(args.a4), new UserPtr(args.a5));
                     break;
 
                 case SYS_SHUTDOWN:
-                    if (argPtr.Read(current, out a0) != 0 || (argPtr + sizeof(int)).Read(current, out a1) != 0)
-                        return -ErrorCode.EFAULT;
-
-                    err = Shutdown(current, a0, a1);
+                    err = Shutdown(current, args.a0, args.a1);
                     break;
 
                 case SYS_SETSOCKOPT:
-                    if (argPtr.Read(current, out a0) != 0 || (argPtr + sizeof(int)).Read(current, out a1) != 0
-                        || (argPtr + sizeof(int) * 2).Read(current, out a2) != 0 || (argPtr + sizeof(int) * 3).Read(current, out a3) != 0
-                        || (argPtr + sizeof(int) * 4).Read(current, out a4) != 0)
-                        return -ErrorCode.EFAULT;
-
-                    err = Setsockopt(current, ref regs, a0, a1, a2, new UserPtr(a3), a4);
+                    err = Setsockopt(current, ref regs, args.a0, args.a1, args.a2, new UserPtr(args.a3), args.a4);
                     break;
 
                 case SYS_GETSOCKOPT:
-                    if (argPtr.Read(current, out a0) != 0 || (argPtr + sizeof(int)).Read(current, out a1) != 0
-                      || (argPtr + sizeof(int) * 2).Read(current, out a2) != 0 || (argPtr + sizeof(int) * 3).Read(current, out a3) != 0
-                      || (argPtr + sizeof(int) * 4).Read(current, out a4) != 0)
-                        return -ErrorCode.EFAULT;
+                    err = Getsockopt(current, ref regs, args.a0, args.a1, args.a2, new UserPtr(args.a3), new UserPtr(args.a4));
+                    break;
+
+                case SYS_SENDMMSG:
+                    err = Sendmmsg(current, ref regs, args.a0, new UserPtr(args.a1), args.a2, args.a3);
+                    break;
 
-                    err = Getsockopt(current, ref regs, a0, a1, a2, new UserPtr(a3), new UserPtr(a4));
+                case SYS_RECVMMSG:
+                    err = Recvmmsg(current, ref regs, args.a0, new UserPtr(args.a1), args.a2, args.a3, new UserPtr(args.a4));
                     break;
 
                 default:
@@ -319,11 +288,47 @@ namespace ExpressOS.Kernel
                     err = -1;
                     break;
             }
-            SyscallProfiler.ExitSocketcall(call);
 
             return err;
         }
 
+        /*
+         * Number of arguments of each socketcall, as nargs[] in net/socket.c
+         */
+        private static int SocketcallArgCount(int call)
+        {
+            switch (call)
+            {
+                case SYS_LISTEN:
+                case SYS_SHUTDOWN:
+                    return 2;
+                case SYS_SOCKET:
+                case SYS_BIND:
+                case SYS_CONNECT:
+                case SYS_ACCEPT:
+                case SYS_GETSOCKNAME:
+                case SYS_GETPEERNAME:
+                case SYS_SENDMSG:
+                case SYS_RECVMSG:
+                    return 3;
+                case SYS_SOCKETPAIR:
+                case SYS_SEND:
+                case SYS_RECV:
+                case SYS_ACCEPT4:
+                case SYS_SENDMMSG:
+                    return 4;
+                case SYS_SETSOCKOPT:
+                case SYS_GETSOCKOPT:
+                case SYS_RECVMMSG:
+                    return 5;
+                case SYS_SENDTO:
+                case SYS_RECVFROM:
+                    return 6;
+                default:
+                    return 0;
+            }
+        }
+
         private static int Shutdown(Thread current, int sockfd, int how)
         {
             var proc = current.Parent;
@@ -377,10 +382,13 @@ namespace ExpressOS.Kernel
             if (file == null)
                 return -ErrorCode.EBADF;
 
-            int addrlen;
-            if (p_addrlen.Read(current, out addrlen) != 0)
+            int addrlen = 0;
+            if (p_addrlen != UserPtr.Zero && p_addrlen.Read(current, out addrlen) != 0)
                 return -ErrorCode.EFAULT;
 
+            if (sockaddr == UserPtr.Zero)
+                addrlen = 0;
+
             var buf = Globals.LinuxIPCBuffer;
             if (len + addrlen > buf.Length)
             {
@@ -393,13 +401,13 @@ namespace ExpressOS.Kernel
 
             var left = userBuf.Write(current, new Pointer(buf.Location), ret);
 
-            if (sockaddr.Write(current, new Pointer(buf.Location + ret - left), addrlen) != 0)
+            if (sockaddr != UserPtr.Zero && sockaddr.Write(current, new Pointer(buf.Location + ret - left), addrlen) != 0)
                 return -ErrorCode.EFAULT;
 
             return ret - left;
         }
 
-        private static int Sendto(Thread current, int sockfd, UserPtr userBuf, int len, int flags, UserPtr sockaddr, int addrlen)
+        private static int Sendto(Thread current, ref Arch.ExceptionRegisters regs, int sockfd, UserPtr userBuf, int len, int flags, UserPtr sockaddr, int addrlen)
         {
             var proc = current.Parent;
             var file = proc.LookupFile(sockfd);
@@ -411,6 +419,12 @@ namespace ExpressOS.Kernel
             if (len < 0 || addrlen < 0)
                 return -ErrorCode.EINVAL;
 
+            // Large sends on a connected socket are streamed instead of being capped by the IPC buffer
+            if (len + addrlen > buf.Length && sockaddr == UserPtr.Zero
+                && file.inode.kind == GenericINode.INodeKind.SocketINodeKind
+                && Arch.IPCStubs.HasOptionalOp(Arch.IPCStubs.OPTIONAL_SENDTO_ASYNC))
+                return SendStream(current, ref regs, file, userBuf, len, flags);
+
             if (len + addrlen > buf.Length)
                 return -ErrorCode.ENOMEM;
 
@@ -437,6 +451,373 @@ namespace ExpressOS.Kernel
             return Arch.IPCStubs.Sendto(proc.helperPid, file.inode.LinuxFd, len, flags, addrlen);
         }
 
+        private const int STREAM_CHUNK_SIZE = 16 * Arch.ArchDefinition.PageSize;
+        private const int MMSG_BATCH_SIZE = 16 * Arch.ArchDefinition.PageSize;
+        private const int MMSG_RECORD_HEADER_SIZE = 5 * sizeof(int);
+        private const int UIO_MAXIOV = 1024;
+        private const int SOCKADDR_STORAGE_SIZE = 128;
+
+        /*
+         * Send a buffer larger than the IPC buffer through a completion
+         * buffer of STREAM_CHUNK_SIZE, one chunk after another, without
+         * blocking the kernel in between.
+         */
+        private static int SendStream(Thread current, ref Arch.ExceptionRegisters regs, File file, UserPtr userBuf, int len, int flags)
+        {
+            var buf = Globals.AllocateAlignedCompletionBuffer(STREAM_CHUNK_SIZE);
+            if (!buf.isValid)
+                return -ErrorCode.ENOMEM;
+
+            var completion = new SendStreamCompletion(current, file.inode.LinuxFd, userBuf, len, flags, buf);
+            var ret = SendNextChunk(completion);
+            if (ret < 0)
+            {
+                completion.Dispose();
+                return ret;
+            }
+
+            Globals.CompletionQueue.Enqueue(completion);
+            current.SaveState(ref regs);
+            current.AsyncReturn = true;
+            return 0;
+        }
+
+        private static int SendNextChunk(SendStreamCompletion c)
+        {
+            var current = c.thr;
+            var left = c.length - c.sent;
+            var chunk = left > c.buf.Length ? c.buf.Length : left;
+
+            if ((c.userBuf + c.sent).Read(current, c.buf, chunk) != 0)
+                return -ErrorCode.EFAULT;
+
+            c.inFlight = chunk;
+            return Arch.IPCStubs.SendtoAsync(current.Parent.helperPid, current.impl._value.thread._value, new Pointer(c.buf.Location), c.sockfd, chunk, c.flags, 0);
+        }
+
+        public static void HandleSendStreamCompletion(SendStreamCompletion c, int ret)
+        {
+            var current = c.thr;
+            if (ret > 0)
+                c.sent += ret;
+
+            // Keep going as long as the helper takes whole chunks
+            if (ret == c.inFlight && c.sent < c.length)
+            {
+                ret = SendNextChunk(c);
+                if (ret == 0)
+                {
+                    Globals.CompletionQueue.Enqueue(c);
+                    return;
+                }
+            }
+
+            c.Dispose();
+            current.ReturnFromCompletion(c.sent > 0 ? c.sent : ret);
+        }
+
+        public static int Sendmmsg(Thread current, ref Arch.ExceptionRegisters regs, int sockfd, UserPtr msgvec, int vlen, int flags)
+        {
+            return MessageBatch(current, ref regs, sockfd, msgvec, vlen, flags, false, UserPtr.Zero);
+        }
+
+        public static int Recvmmsg(Thread current, ref Arch.ExceptionRegisters regs, int sockfd, UserPtr msgvec, int vlen, int flags, UserPtr timeout)
+        {
+            return MessageBatch(current, ref regs, sockfd, msgvec, vlen, flags, true, timeout);
+        }
+
+        /*
+         * Pack as many messages of msgvec as fit into one completion buffer
+         * and hand them to the helper in a single round trip. The record
+         * layout is described at Arch.IPCStubs.SendmmsgAsync().
+         *
+         * The timeout of recvmmsg() is passed on to the helper, and the time
+         * left is written back once it replies, as Linux does.
+         */
+        private static int MessageBatch(Thread current, ref Arch.ExceptionRegisters regs, int sockfd, UserPtr msgvec, int vlen, int flags, bool receive, UserPtr timeoutPtr)
+        {
+            if (!Arch.IPCStubs.HasOptionalOp(Arch.IPCStubs.OPTIONAL_MMSG_ASYNC))
+                return -ErrorCode.ENOSYS;
+
+            long timeout = -1;
+            if (timeoutPtr != UserPtr.Zero)
+            {
+                timespec ts;
+                if (timeoutPtr.Read(current, out ts) != 0)
+                    return -ErrorCode.EFAULT;
+
+                if ((int)ts.tv_sec < 0 || ts.tv_nsec >= 1000000000)
+                    return -ErrorCode.EINVAL;
+
+                timeout = (long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+            }
+
+            var proc = current.Parent;
+            var file = proc.LookupFile(sockfd);
+            if (file == null)
+                return -ErrorCode.EBADF;
+
+            if (file.inode.kind != GenericINode.INodeKind.SocketINodeKind)
+                return -ErrorCode.ENOTSOCK;
+
+            if (vlen < 0)
+                return -ErrorCode.EINVAL;
+
+            if (vlen > UIO_MAXIOV)
+                vlen = UIO_MAXIOV;
+
+            if (vlen == 0)
+                return 0;
+
+            var hdrs = new byte[vlen * mmsghdr.Size];
+            if (msgvec.Read(current, hdrs) != 0)
+                return -ErrorCode.EFAULT;
+
+            var buf = Globals.AllocateAlignedCompletionBuffer(MMSG_BATCH_SIZE);
+            if (!buf.isValid)
+                return -ErrorCode.ENOMEM;
+
+            var cursor = 0;
+            var n = 0;
+            var ret = 0;
+            while (n < vlen)
+            {
+                var hdr = mmsghdr.Deserialize(hdrs, n * mmsghdr.Size);
+                ret = AppendMessageRecord(current, buf, ref cursor, hdr, receive);
+                if (ret <= 0)
+                    break;
+
+                ++n;
+            }
+
+            if (n == 0)
+            {
+                Globals.CompletionQueueAllocator.FreePages(new Pointer(buf.Location), buf.Length >> Arch.ArchDefinition.PageShift);
+                return ret < 0 ? ret : -ErrorCode.ENOMEM;
+            }
+
+            var completion = new MessageBatchCompletion(current, msgvec, hdrs, n, receive, flags, timeoutPtr, timeout, buf);
+            var handle = current.impl._value.thread._value;
+            if (receive)
+                ret = Arch.IPCStubs.RecvmmsgAsync(proc.helperPid, handle, new Pointer(buf.Location), file.inode.LinuxFd, n, flags, ToMilliseconds(timeout));
+            else
+                ret = Arch.IPCStubs.SendmmsgAsync(proc.helperPid, handle, new Pointer(buf.Location), file.inode.LinuxFd, n, flags);
+
+            if (ret < 0)
+            {
+                completion.Dispose();
+                return ret;
+            }
+
+            Globals.CompletionQueue.Enqueue(completion);
+            current.SaveState(ref regs);
+            current.AsyncReturn = true;
+            return 0;
+        }
+
+        /*
+         * Returns the size of the record, 0 if it does not fit into the
+         * rest of buf. The first record always fits: a receive is clamped
+         * to the size of buf, a send larger than buf fails with EMSGSIZE.
+         */
+        private static int AppendMessageRecord(Thread current, ByteBufferRef buf, ref int cursor, mmsghdr hdr, bool receive)
+        {
+            if (hdr.msg_iovlen < 0 || hdr.msg_iovlen > UIO_MAXIOV || hdr.msg_namelen < 0)
+                return -ErrorCode.EINVAL;
+
+            if (!receive && hdr.msg_namelen > SOCKADDR_STORAGE_SIZE)
+                return -ErrorCode.EINVAL;
+
+            var iovec_buf = ReadIOVectors(current, hdr);
+            if (iovec_buf == null && hdr.msg_iovlen != 0)
+                return -ErrorCode.EFAULT;
+
+            var name_size = hdr.msg_name == UserPtr.Zero ? 0 : hdr.msg_namelen;
+            if (name_size > SOCKADDR_STORAGE_SIZE)
+                name_size = SOCKADDR_STORAGE_SIZE;
+
+            long total = 0;
+            for (var i = 0; i < hdr.msg_iovlen; ++i)
+            {
+                var iovec = IOVector.Deserialize(iovec_buf, i * IOVector.Size);
+                if (iovec.iov_len < 0)
+                    return -ErrorCode.EINVAL;
+
+                total += iovec.iov_len;
+            }
+
+            if (total > int.MaxValue)
+                return -ErrorCode.EINVAL;
+
+            var name_start = cursor + MMSG_RECORD_HEADER_SIZE;
+            var payload_start = name_start + Align4(name_size);
+            var space = buf.Length - payload_start;
+            var payload_size = (int)total;
+            if (payload_size > space)
+            {
+                // Later messages go into the next call, which has the whole buffer
+                if (cursor != 0)
+                    return 0;
+
+                if (!receive)
+                    return -ErrorCode.EMSGSIZE;
+
+                payload_size = space;
+            }
+
+            var record_size = payload_start + Align4(payload_size) - cursor;
+
+            Deserializer.WriteInt(name_size, buf, cursor);
+            Deserializer.WriteInt(payload_size, buf, cursor + sizeof(int));
+            Deserializer.WriteInt(receive ? 0 : name_size, buf, cursor + 2 * sizeof(int));
+            Deserializer.WriteInt(receive ? 0 : payload_size, buf, cursor + 3 * sizeof(int));
+            Deserializer.WriteInt(0, buf, cursor + 4 * sizeof(int));
+
+            if (!receive)
+            {
+                if (name_size > 0 && hdr.msg_name.Read(current, buf.Slice(name_start, name_size), name_size) != 0)
+                    return -ErrorCode.EFAULT;
+
+                var off = payload_start;
+                for (var i = 0; i < hdr.msg_iovlen; ++i)
+                {
+                    var iovec = IOVector.Deserialize(iovec_buf, i * IOVector.Size);
+                    if (iovec.iov_len == 0)
+                        continue;
+
+                    if (iovec.iov_base.Read(current, buf.Slice(off, iovec.iov_len), iovec.iov_len) != 0)
+                        return -ErrorCode.EFAULT;
+
+                    off += iovec.iov_len;
+                }
+            }
+
+            cursor += record_size;
+            return record_size;
+        }
+
+        /* Rounds up, -1 stays for no timeout */
+        private static int ToMilliseconds(long us)
+        {
+            if (us < 0)
+                return -1;
+
+            var ms = (us + 999) / 1000;
+            return ms > int.MaxValue ? int.MaxValue : (int)ms;
+        }
+
+        public static void HandleMessageBatchCompletion(MessageBatchCompletion c, int ret)
+        {
+            var current = c.thr;
+            var buf = c.buf;
+
+            if (ret > c.count)
+                ret = c.count;
+
+            if (c.timeout >= 0 && ret >= 0)
+            {
+                var left = c.timeout - (long)(Arch.NativeMethods.l4api_get_system_clock() - c.startTime);
+                if (left < 0)
+                    left = 0;
+
+                timespec ts;
+                ts.tv_sec = (uint)(left / 1000000);
+                ts.tv_nsec = (uint)(left % 1000000 * 1000);
+                c.timeoutPtr.Write(current, ref ts);
+            }
+
+            var cursor = 0;
+            for (var i = 0; i < ret; ++i)
+            {
+                var name_size = Deserializer.ReadInt(buf, cursor);
+                var payload_size = Deserializer.ReadInt(buf, cursor + sizeof(int));
+                var name_len = Deserializer.ReadInt(buf, cursor + 2 * sizeof(int));
+                var payload_len = Deserializer.ReadInt(buf, cursor + 3 * sizeof(int));
+                var msg_flags = Deserializer.ReadInt(buf, cursor + 4 * sizeof(int));
+                var name_start = cursor + MMSG_RECORD_HEADER_SIZE;
+                var payload_start = name_start + Align4(name_size);
+
+                /*
+                 * A datagram larger than its buffer is cut and flagged with
+                 * MSG_TRUNC. msg_len is its full length only if the caller
+                 * asked for MSG_TRUNC.
+                 */
+                var copy_len = payload_len;
+                if (c.receive && payload_len > payload_size)
+                {
+                    copy_len = payload_size;
+                    msg_flags |= MSG_TRUNC;
+                    if ((c.flags & MSG_TRUNC) == 0)
+                        payload_len = payload_size;
+                }
+
+                var p = c.msgvec + i * mmsghdr.Size;
+                var failed = (p + mmsghdr.OFFSET_OF_LEN).Write(current, payload_len) != 0;
+
+                if (!failed && c.receive)
+                {
+                    var hdr = mmsghdr.Deserialize(c.hdrs, i * mmsghdr.Size);
+                    if (name_len > name_size)
+                        name_len = name_size;
+
+                    failed = (name_len > 0 && hdr.msg_name.Write(current, new Pointer(buf.Location + name_start), name_len) != 0)
+                        || (p + mmsghdr.OFFSET_OF_NAMELEN).Write(current, name_len) != 0
+                        || (p + mmsghdr.OFFSET_OF_FLAGS).Write(current, msg_flags) != 0
+                        || ScatterToIOVectors(current, hdr, buf, payload_start, copy_len) != 0;
+                }
+
+                if (failed)
+                {
+                    ret = i > 0 ? i : -ErrorCode.EFAULT;
+                    break;
+                }
+
+                cursor = payload_start + Align4(payload_size);
+            }
+
+            c.Dispose();
+            current.ReturnFromCompletion(ret);
+        }
+
+        private static int ScatterToIOVectors(Thread current, mmsghdr hdr, ByteBufferRef buf, int offset, int len)
+        {
+            var iovec_buf = ReadIOVectors(current, hdr);
+            if (iovec_buf == null)
+                return len == 0 ? 0 : -ErrorCode.EFAULT;
+
+            for (var i = 0; i < hdr.msg_iovlen && len > 0; ++i)
+            {
+                var iovec = IOVector.Deserialize(iovec_buf, i * IOVector.Size);
+                var chunk = iovec.iov_len > len ? len : iovec.iov_len;
+                if (chunk <= 0)
+                    continue;
+
+                if (iovec.iov_base.Write(current, new Pointer(buf.Location + offset), chunk) != 0)
+                    return -ErrorCode.EFAULT;
+
+                offset += chunk;
+                len -= chunk;
+            }
+            return 0;
+        }
+
+        private static byte[] ReadIOVectors(Thread current, mmsghdr hdr)
+        {
+            if (hdr.msg_iovlen <= 0)
+                return null;
+
+            var iovec_buf = new byte[IOVector.Size * hdr.msg_iovlen];
+            if (hdr.msg_iov.Read(current, iovec_buf) != 0)
+                return null;
+
+            return iovec_buf;
+        }
+
+        private static int Align4(int v)
+        {
+            return (v + 3) & ~3;
+        }
+
         private static int Bind(Thread current, ref Arch.ExceptionRegisters regs, int sockfd, UserPtr sockaddr, int addrlen)
         {
             return BindOrConnect(SYS_BIND, current, ref regs, sockfd, sockaddr, addrlen);
@@ -606,40 +987,15 @@ namespace ExpressOS.Kernel
             var current = entry.thr;
             var b = entry.buf;
 
-            if (retval <= 0 || retval * pollfd.Size >= b.Length)
+            if (retval < 0 || retval * pollfd.Size > b.Length)
             {
                 entry.Dispose();
-                current.ReturnFromCompletion(retval);
+                current.ReturnFromCompletion(retval < 0 ? retval : -ErrorCode.ENOMEM);
                 return;
             }
 
-            int ret = retval;
-
-            var len = (entry.fds + 7) / 8;
-
-            var bit_set = 0;
-            var r = entry.helper.TranslateToUserFdlist(current, b, retval, entry.fds, entry.inp, POLLIN);
-            if (r < 0)
-                ret = r;
-
-            if (ret >= 0)
-            {
-                bit_set += r;
-                r = entry.helper.TranslateToUserFdlist(current, b, retval, entry.fds, entry.outp, POLLOUT);
-                if (r < 0)
-                    ret = r;
-            }
-
-            if (ret >= 0)
-            {
-                bit_set += r;
-                r = entry.helper.TranslateToUserFdlist(current, b, retval, entry.fds, entry.exp, POLLERR | POLLHUP);
-                if (r < 0)
-                    ret = r;
-            }
-
-            if (ret >= 0)
-                ret = bit_set;
+            entry.helper.Set.ApplyLinuxReply(b, retval);
+            var ret = entry.helper.WriteUserFdLists(current);
 
             entry.Dispose();
             current.ReturnFromCompletion(ret);
@@ -649,42 +1005,35 @@ namespace ExpressOS.Kernel
     public sealed class PollCompletion : ThreadCompletionEntryWithBuffer
     {
         public readonly UserPtr userFdBuf;
-        public readonly int[] fdMaps;
+        public readonly int nfds;
+        internal readonly PollSet set;
 
         [ContractInvariantMethod]
         private void ObjectInvariant()
         {
-            Contract.Invariant(buf.Length >= fdMaps.Length * pollfd.Size);
+            Contract.Invariant(buf.Length >= nfds * pollfd.Size);
         }
 
-        public PollCompletion(Thread current, UserPtr fds, int nfds, ByteBufferRef buf)
+        internal PollCompletion(Thread current, UserPtr fds, int nfds, PollSet set, ByteBufferRef buf)
             : base(current, Kind.PollCompletionKind, buf)
         {
             Contract.Requires(nfds >= 0);
             Contract.Requires(buf.Length >= nfds * pollfd.Size);
-            Contract.Ensures(fdMaps.Length == nfds);
-            Contract.Ensures(this.buf.Length >= fdMaps.Length * pollfd.Size);
+            Contract.Ensures(this.buf.Length >= this.nfds * pollfd.Size);
 
             this.userFdBuf = fds;
-            this.fdMaps = new int[nfds];
+            this.nfds = nfds;
+            this.set = set;
         }
     }
 
     public sealed class SelectCompletion : ThreadCompletionEntryWithBuffer
     {
-        public readonly UserPtr inp;
-        public readonly UserPtr outp;
-        public readonly UserPtr exp;
         public readonly SelectHelper helper;
-        public readonly int fds;
     
-        public SelectCompletion(Thread current, int maxfds, UserPtr inp, UserPtr outp, UserPtr exp, SelectHelper helper, ByteBufferRef buf)
+        public SelectCompletion(Thread current, SelectHelper helper, ByteBufferRef buf)
             : base(current, Kind.SelectCompletionKind, buf)
         {
-            this.fds = maxfds;
-            this.inp = inp;
-            this.outp = outp;
-            this.exp = exp;
             this.helper = helper;
         }
     }
@@ -701,4 +1050,50 @@ namespace ExpressOS.Kernel
             this.p_addrlen = p_addrlen;
         }
     }
+
+    public sealed class SendStreamCompletion : ThreadCompletionEntryWithBuffer
+    {
+        public readonly int sockfd;
+        public readonly UserPtr userBuf;
+        public readonly int length;
+        public readonly int flags;
+        public int sent;
+        public int inFlight;
+
+        internal SendStreamCompletion(Thread current, int sockfd, UserPtr userBuf, int length, int flags, ByteBufferRef buf)
+            : base(current, Kind.SendStreamCompletionKind, buf)
+        {
+            this.sockfd = sockfd;
+            this.userBuf = userBuf;
+            this.length = length;
+            this.flags = flags;
+        }
+    }
+
+    public sealed class MessageBatchCompletion : ThreadCompletionEntryWithBuffer
+    {
+        public readonly UserPtr msgvec;
+        public readonly byte[] hdrs;
+        public readonly int count;
+        public readonly bool receive;
+        public readonly int flags;
+
+        /* The timeout of recvmmsg() in microseconds, -1 for none */
+        public readonly UserPtr timeoutPtr;
+        public readonly long timeout;
+        public readonly ulong startTime;
+
+        internal MessageBatchCompletion(Thread current, UserPtr msgvec, byte[] hdrs, int count, bool receive, int flags, UserPtr timeoutPtr, long timeout, ByteBufferRef buf)
+            : base(current, Kind.MessageBatchCompletionKind, buf)
+        {
+            this.msgvec = msgvec;
+            this.hdrs = hdrs;
+            this.count = count;
+            this.receive = receive;
+            this.flags = flags;
+            this.timeoutPtr = timeoutPtr;
+            this.timeout = timeout;
+            this.startTime = Arch.NativeMethods.l4api_get_system_clock();
+        }
+    }
 }
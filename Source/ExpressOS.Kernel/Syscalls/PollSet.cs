@@ -0,0 +1,553 @@
+﻿using System.Diagnostics.Contracts;
+
+namespace ExpressOS.Kernel
+{
+    /*
+     * A persistent interest set of file descriptors, shared by poll(),
+     * select() and epoll.
+     *
+     * Every slot caches the file that the fd was resolved to and the
+     * corresponding Linux fd, so that a set which is polled over and over
+     * again does not have to be translated on every call. Readiness of the
+     * fds that are owned by the kernel is answered locally, only the
+     * Linux-backed fds are shipped to the helper. An epoll fd in the set
+     * is readable when its own set has ready entries: its kernel-owned
+     * fds are polled in place, and its Linux-backed fds are shipped along
+     * with those of the set.
+     *
+     * poll() and select() fill the set in the order of the user's request
+     * through Append(). epoll keeps the set sorted by fd through Insert(),
+     * Modify() and Remove().
+     *
+     * The set of a thread keeps the results of its poll() and select()
+     * calls in revents. An epoll set is shared by every waiter, which
+     * passes its own array of results instead.
+     */
+    public sealed class PollSet
+    {
+        private const int DEFAULT_SIZE = 16;
+        private const int REPORT_ALWAYS = Net.POLLERR | Net.POLLHUP | Net.POLLNVAL;
+
+        int[] fds;
+        File[] files;
+        int[] linuxFds;
+        int[] events;
+        short[] revents;
+        ulong[] data;
+
+        // Cleared once an EPOLLONESHOT event has been reported
+        bool[] armed;
+
+        // Slots chained by Linux fd, used to translate the reply of the helper
+        int[] linuxHead;
+        int[] linuxNext;
+
+        public int Count { get; private set; }
+        /* Linux-backed fds to ship, including those of nested epoll sets */
+        public int LinuxCount { get; private set; }
+
+        [ContractInvariantMethod]
+        private void ObjectInvariantMethod()
+        {
+            Contract.Invariant(Count >= 0 && Count <= fds.Length);
+            Contract.Invariant(LinuxCount >= 0);
+        }
+
+        internal PollSet()
+        {
+            Allocate(DEFAULT_SIZE);
+        }
+
+        internal int Fd(int slot)
+        {
+            Contract.Requires(slot >= 0 && slot < Count);
+            return fds[slot];
+        }
+
+        internal short Events(int slot)
+        {
+            Contract.Requires(slot >= 0 && slot < Count);
+            return (short)events[slot];
+        }
+
+        internal int Flags(int slot)
+        {
+            Contract.Requires(slot >= 0 && slot < Count);
+            return events[slot];
+        }
+
+        internal short REvents(int slot)
+        {
+            Contract.Requires(slot >= 0 && slot < Count);
+            return revents[slot];
+        }
+
+        internal ulong Data(int slot)
+        {
+            Contract.Requires(slot >= 0 && slot < Count);
+            return data[slot];
+        }
+
+        internal void Clear()
+        {
+            Count = 0;
+            LinuxCount = 0;
+        }
+
+        /*
+         * Append fd at the end of the set. The translation is reused if the
+         * same slot referred to the same file in the previous round.
+         *
+         * Negative fds are ignored, as poll() does. Returns -EBADF if the
+         * fd is not open, the slot is still added so that poll() can report
+         * POLLNVAL for it.
+         */
+        internal int Append(Process proc, int fd, int ev)
+        {
+            var slot = Count;
+            EnsureCapacity(slot + 1);
+            ++Count;
+
+            var file = fd < 0 ? null : proc.LookupFile(fd);
+            if (fds[slot] != fd || files[slot] != file || file == null)
+                Resolve(slot, fd, file);
+
+            events[slot] = ev;
+            revents[slot] = 0;
+            data[slot] = 0;
+            armed[slot] = true;
+
+            return fd >= 0 && file == null ? -ErrorCode.EBADF : 0;
+        }
+
+        internal int Insert(File file, int fd, int ev, ulong val)
+        {
+            Contract.Requires(file != null);
+
+            var pos = Find(fd);
+            if (pos >= 0)
+                return -ErrorCode.EEXIST;
+
+            pos = ~pos;
+            EnsureCapacity(Count + 1);
+            for (var i = Count; i > pos; --i)
+                Move(i - 1, i);
+            ++Count;
+
+            Resolve(pos, fd, file);
+            events[pos] = ev;
+            revents[pos] = 0;
+            data[pos] = val;
+            armed[pos] = true;
+            return 0;
+        }
+
+        internal int Modify(int fd, int ev, ulong val)
+        {
+            var pos = Find(fd);
+            if (pos < 0)
+                return -ErrorCode.ENOENT;
+
+            events[pos] = ev;
+            data[pos] = val;
+            armed[pos] = true;
+            return 0;
+        }
+
+        internal int Remove(int fd)
+        {
+            var pos = Find(fd);
+            if (pos < 0)
+                return -ErrorCode.ENOENT;
+
+            RemoveAt(pos);
+            return 0;
+        }
+
+        /*
+         * Stop reporting events on slot, including POLLERR and POLLHUP,
+         * until it is re-armed by Modify()
+         */
+        internal void Disarm(int slot)
+        {
+            Contract.Requires(slot >= 0 && slot < Count);
+            armed[slot] = false;
+        }
+
+        /*
+         * Drop the slots whose fd has been closed, or now refers to
+         * a different file.
+         */
+        internal void Revalidate(Process proc)
+        {
+            var j = 0;
+            for (var i = 0; i < Count; ++i)
+            {
+                if (proc.LookupFile(fds[i]) != files[i])
+                    continue;
+
+                if (i != j)
+                    Move(i, j);
+                ++j;
+            }
+            Count = j;
+        }
+
+        /*
+         * Compute the readiness of all kernel-owned fds, and reset the
+         * results of the Linux-backed ones. It also recounts LinuxCount.
+         *
+         * Returns the number of ready slots.
+         */
+        internal int PollLocal()
+        {
+            return PollLocal(revents);
+        }
+
+        /* Same as PollLocal(), but stores the results in result */
+        internal int PollLocal(short[] result)
+        {
+            Contract.Requires(result != null && result.Length >= Count);
+
+            var ready = 0;
+            var nlinux = 0;
+            for (var i = 0; i < Count; ++i)
+            {
+                result[i] = 0;
+                if (!armed[i])
+                    continue;
+
+                var ev = 0;
+                if (files[i] == null)
+                {
+                    ev = fds[i] < 0 ? 0 : Net.POLLNVAL;
+                }
+                else if (linuxFds[i] >= 0)
+                {
+                    // An empty mask still asks for POLLERR and POLLHUP
+                    ++nlinux;
+                }
+                else
+                {
+                    var nested = NestedSet(i);
+                    if (nested != null)
+                    {
+                        if (nested.PollLocal(new short[nested.Count]) > 0)
+                            ev = Net.POLLIN;
+                        nlinux += nested.LinuxCount;
+                    }
+                    else
+                    {
+                        ev = LocalEvents(files[i]);
+                    }
+                    ev &= events[i] | REPORT_ALWAYS;
+                }
+
+                result[i] = (short)ev;
+                if (ev != 0)
+                    ++ready;
+            }
+            LinuxCount = nlinux;
+            return ready;
+        }
+
+        /*
+         * Serialize the Linux-backed slots as an array of pollfd for the
+         * helper. PollLocal() has to be called before.
+         */
+        internal void WriteLinuxPollFds(ByteBufferRef buf)
+        {
+            Contract.Requires(LinuxCount * pollfd.Size <= buf.Length);
+
+            var j = 0;
+            for (var i = 0; i < Count && j < LinuxCount; ++i)
+            {
+                if (!armed[i])
+                    continue;
+
+                var nested = NestedSet(i);
+                if (nested != null)
+                {
+                    nested.WriteLinuxPollFds(buf.Slice(j * pollfd.Size, nested.LinuxCount * pollfd.Size));
+                    j += nested.LinuxCount;
+                    continue;
+                }
+
+                if (linuxFds[i] < 0)
+                    continue;
+
+                pollfd poll_struct;
+                poll_struct.fd = linuxFds[i];
+                poll_struct.events = (short)events[i];
+                poll_struct.revents = 0;
+                poll_struct.Write(buf, j * pollfd.Size);
+                ++j;
+            }
+        }
+
+        /*
+         * Merge the reply of the helper into the set. The helper returns
+         * the ready entries at the front of the buffer.
+         *
+         * Returns the total number of ready slots.
+         */
+        internal int ApplyLinuxReply(ByteBufferRef buf, int nready)
+        {
+            return ApplyLinuxReply(buf, nready, revents);
+        }
+
+        /* Same as ApplyLinuxReply(), but merges into the results of PollLocal(result) */
+        internal int ApplyLinuxReply(ByteBufferRef buf, int nready, short[] result)
+        {
+            Contract.Requires(nready >= 0 && nready * pollfd.Size <= buf.Length);
+            Contract.Requires(result != null && result.Length >= Count);
+
+            BuildLinuxIndex();
+            for (var k = 0; k < nready; ++k)
+            {
+                var poll_struct = pollfd.Deserialize(buf, k * pollfd.Size);
+                var linux_fd = poll_struct.fd;
+                if (linux_fd < 0)
+                    continue;
+
+                if (linux_fd < linuxHead.Length)
+                {
+                    for (var s = linuxHead[linux_fd]; s >= 0; s = linuxNext[s])
+                    {
+                        if (armed[s])
+                            result[s] |= (short)(poll_struct.revents & (events[s] | REPORT_ALWAYS));
+                    }
+                }
+
+                for (var s = 0; s < Count; ++s)
+                {
+                    var nested = NestedSet(s);
+                    if (nested != null && armed[s] && nested.MatchesLinuxEvent(linux_fd, poll_struct.revents))
+                        result[s] |= (short)(Net.POLLIN & events[s]);
+                }
+            }
+
+            var ready = 0;
+            for (var i = 0; i < Count; ++i)
+            {
+                if (result[i] != 0)
+                    ++ready;
+            }
+            return ready;
+        }
+
+        /*
+         * Serialize the whole set as the pollfd array of the user.
+         */
+        internal void WriteUserPollFds(ByteBufferRef buf)
+        {
+            Contract.Requires(Count * pollfd.Size <= buf.Length);
+
+            for (var i = 0; i < Count; ++i)
+            {
+                pollfd poll_struct;
+                poll_struct.fd = fds[i];
+                poll_struct.events = (short)events[i];
+                poll_struct.revents = revents[i];
+                poll_struct.Write(buf, i * pollfd.Size);
+            }
+        }
+
+        /*
+         * Whether the helper reported an event of interest on linuxFd for
+         * an armed slot of the set or of a nested one
+         */
+        private bool MatchesLinuxEvent(int linuxFd, int ev)
+        {
+            for (var i = 0; i < Count; ++i)
+            {
+                if (!armed[i])
+                    continue;
+
+                if (linuxFds[i] == linuxFd && (ev & (events[i] | REPORT_ALWAYS)) != 0)
+                    return true;
+
+                var nested = NestedSet(i);
+                if (nested != null && nested.MatchesLinuxEvent(linuxFd, ev))
+                    return true;
+            }
+            return false;
+        }
+
+        /* The set of the epoll fd in slot, or null */
+        private PollSet NestedSet(int slot)
+        {
+            if (files[slot] == null)
+                return null;
+
+            var ep = files[slot].inode.EventPollINode;
+            return ep == null ? null : ep.Interest;
+        }
+
+        /*
+         * Whether the set watches an epoll fd. Such a set cannot be added
+         * to another epoll set, which rules out cycles.
+         */
+        internal bool HasNestedSet()
+        {
+            for (var i = 0; i < Count; ++i)
+            {
+                if (NestedSet(i) != null)
+                    return true;
+            }
+            return false;
+        }
+
+        private static bool IsLocal(File file)
+        {
+            switch (file.inode.kind)
+            {
+                case GenericINode.INodeKind.ConsoleINodeKind:
+                case GenericINode.INodeKind.BinderINodeKind:
+                case GenericINode.INodeKind.SecureFSINodeKind:
+                case GenericINode.INodeKind.EventPollINodeKind:
+                    return true;
+                default:
+                    return file.inode.LinuxFd < 0;
+            }
+        }
+
+        private static int LocalEvents(File file)
+        {
+            switch (file.inode.kind)
+            {
+                case GenericINode.INodeKind.ConsoleINodeKind:
+                    return Net.POLLOUT;
+
+                // Reads and writes of a regular file never block
+                case GenericINode.INodeKind.SecureFSINodeKind:
+                    return Net.POLLIN | Net.POLLOUT;
+
+                // Transactions can always be sent
+                case GenericINode.INodeKind.BinderINodeKind:
+                    return BinderINode.HasPendingWork(file.GhostOwner) ? Net.POLLIN | Net.POLLOUT : Net.POLLOUT;
+
+                default:
+                    return 0;
+            }
+        }
+
+        private void Resolve(int slot, int fd, File file)
+        {
+            fds[slot] = fd;
+            files[slot] = file;
+            linuxFds[slot] = file == null || IsLocal(file) ? -1 : file.inode.LinuxFd;
+        }
+
+        private int Find(int fd)
+        {
+            var lo = 0;
+            var hi = Count - 1;
+            while (lo <= hi)
+            {
+                var mid = lo + (hi - lo) / 2;
+                if (fds[mid] == fd)
+                    return mid;
+                else if (fds[mid] < fd)
+                    lo = mid + 1;
+                else
+                    hi = mid - 1;
+            }
+            return ~lo;
+        }
+
+        private void RemoveAt(int pos)
+        {
+            for (var i = pos; i + 1 < Count; ++i)
+                Move(i + 1, i);
+
+            --Count;
+            files[Count] = null;
+        }
+
+        private void Move(int from, int to)
+        {
+            fds[to] = fds[from];
+            files[to] = files[from];
+            linuxFds[to] = linuxFds[from];
+            events[to] = events[from];
+            revents[to] = revents[from];
+            data[to] = data[from];
+            armed[to] = armed[from];
+        }
+
+        private void BuildLinuxIndex()
+        {
+            var max = -1;
+            for (var i = 0; i < Count; ++i)
+            {
+                if (linuxFds[i] > max)
+                    max = linuxFds[i];
+            }
+
+            if (linuxHead == null || linuxHead.Length <= max)
+                linuxHead = new int[max + 1];
+
+            for (var i = 0; i < linuxHead.Length; ++i)
+                linuxHead[i] = -1;
+
+            for (var i = Count - 1; i >= 0; --i)
+            {
+                var linux_fd = linuxFds[i];
+                if (linux_fd < 0)
+                    continue;
+
+                linuxNext[i] = linuxHead[linux_fd];
+                linuxHead[linux_fd] = i;
+            }
+        }
+
+        private void EnsureCapacity(int size)
+        {
+            if (size <= fds.Length)
+                return;
+
+            var old_fds = fds;
+            var old_files = files;
+            var old_linux_fds = linuxFds;
+            var old_events = events;
+            var old_revents = revents;
+            var old_data = data;
+            var old_armed = armed;
+
+            var n = fds.Length;
+            while (n < size)
+                n *= 2;
+
+            Allocate(n);
+            for (var i = 0; i < Count; ++i)
+            {
+                fds[i] = old_fds[i];
+                files[i] = old_files[i];
+                linuxFds[i] = old_linux_fds[i];
+                events[i] = old_events[i];
+                revents[i] = old_revents[i];
+                data[i] = old_data[i];
+                armed[i] = old_armed[i];
+            }
+        }
+
+        private void Allocate(int size)
+        {
+            fds = new int[size];
+            files = new File[size];
+            linuxFds = new int[size];
+            events = new int[size];
+            revents = new short[size];
+            data = new ulong[size];
+            armed = new bool[size];
+            linuxNext = new int[size];
+
+            for (var i = 0; i < size; ++i)
+            {
+                fds[i] = -1;
+                linuxFds[i] = -1;
+            }
+        }
+    }
+}
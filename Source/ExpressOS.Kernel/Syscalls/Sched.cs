@@ -0,0 +1,251 @@
+﻿using Arch = ExpressOS.Kernel.Arch;
+
+namespace ExpressOS.Kernel
+{
+    /*
+     * Scheduling parameters of user threads.
+     *
+     * The nice value and the policy of a thread are mapped onto the L4
+     * priority of its L4 thread. All user threads stay below the kernel,
+     * which runs at KernelPriority (see main.c), so that a spinning thread
+     * can never starve the server loop.
+     *
+     * sched_yield() hands the CPU over to the lower priorities, as L4 has
+     * no way to yield on behalf of another thread: the caller drops to
+     * IdlePriority and continues at once. It gets its priority back at
+     * its next system call, or at the next idle tick of the server loop,
+     * whichever comes first.
+     */
+    public static class Sched
+    {
+        public const int SCHED_OTHER = 0;
+        public const int SCHED_FIFO = 1;
+        public const int SCHED_RR = 2;
+        public const int SCHED_BATCH = 3;
+        public const int SCHED_IDLE = 5;
+
+        public const int PRIO_PROCESS = 0;
+
+        public const int MIN_NICE = -20;
+        public const int MAX_NICE = 19;
+        public const int MAX_RT_PRIO = 99;
+
+        private const int KernelPriority = 10;
+        /* Threads of a real-time policy */
+        private const int RealtimePriority = KernelPriority - 1;
+        /* Nice 0 */
+        private const int DefaultPriority = 5;
+        /* SCHED_IDLE, and nice 16 and above */
+        private const int IdlePriority = 1;
+
+        /* Threads that run at IdlePriority after a yield, see EndYields() */
+        private static Thread yielded;
+
+        public static void Initialize()
+        {
+            yielded = null;
+        }
+
+        /*
+         * Every 4 nice levels make one L4 priority level, so that the
+         * THREAD_PRIORITY_* classes of Android end up on distinct levels.
+         */
+        private static int ToL4Priority(Thread thr)
+        {
+            if (thr.Policy == SCHED_FIFO || thr.Policy == SCHED_RR)
+                return RealtimePriority;
+
+            if (thr.Policy == SCHED_IDLE)
+                return IdlePriority;
+
+            var level = thr.Nice >= 0 ? thr.Nice / 4 : -((3 - thr.Nice) / 4);
+            var prio = DefaultPriority - level;
+            if (prio < IdlePriority)
+                prio = IdlePriority;
+            else if (prio >= RealtimePriority)
+                prio = RealtimePriority - 1;
+
+            return prio;
+        }
+
+        internal static void Apply(Thread thr)
+        {
+            thr.impl.SetPriority(ToL4Priority(thr));
+        }
+
+        /*
+         * As in Linux without CAP_SYS_NICE, the nice value can go down to
+         * 20 - RLIMIT_NICE, and a real-time priority up to RLIMIT_RTPRIO.
+         * Root is not limited.
+         */
+        private static bool MayLowerNice(Thread current, int nice)
+        {
+            return current.Parent.Credential.Uid == 0 || nice >= 20 - current.Parent.NiceLimit;
+        }
+
+        private static bool MaySetRealtime(Thread current, int rtPriority)
+        {
+            return current.Parent.Credential.Uid == 0 || rtPriority <= current.Parent.RTPrioLimit;
+        }
+
+        /* Threads and forked children inherit the parameters of their creator */
+        internal static void Inherit(Thread child, Thread parent)
+        {
+            child.Nice = parent.Nice;
+            child.Policy = parent.Policy;
+            child.RTPriority = parent.RTPriority;
+            Apply(child);
+        }
+
+        /*
+         * The caller can name itself with 0 or with its tid, or another
+         * thread of its process with its tid. The pid of the process names
+         * the main thread as in Linux.
+         */
+        private static Thread Lookup(Thread current, int who)
+        {
+            if (who == 0 || who == current.Tid)
+                return current;
+
+            if (who < 0)
+                return null;
+
+            var proc = current.Parent;
+            if (who == proc.Pid)
+            {
+                var main = proc.MainThread;
+                if (main == null || Globals.Threads.Lookup(main.impl._value.thread) != main)
+                    return null;
+
+                return main;
+            }
+
+            var thr = Globals.Threads.Lookup(new Arch.L4Handle((uint)who << Arch.L4Handle.L4_CAP_SHIFT));
+            if (thr == null || thr.Parent != current.Parent)
+                return null;
+
+            return thr;
+        }
+
+        /* The system call returns 20 - nice, which libc turns back into nice */
+        public static int Getpriority(Thread current, int which, int who)
+        {
+            if (which != PRIO_PROCESS)
+                return -ErrorCode.EINVAL;
+
+            var thr = Lookup(current, who);
+            if (thr == null)
+                return -ErrorCode.ESRCH;
+
+            return 20 - thr.Nice;
+        }
+
+        public static int Setpriority(Thread current, int which, int who, int nice)
+        {
+            if (which != PRIO_PROCESS)
+                return -ErrorCode.EINVAL;
+
+            var thr = Lookup(current, who);
+            if (thr == null)
+                return -ErrorCode.ESRCH;
+
+            if (nice < MIN_NICE)
+                nice = MIN_NICE;
+            else if (nice > MAX_NICE)
+                nice = MAX_NICE;
+
+            if (nice < thr.Nice && !MayLowerNice(current, nice))
+                return -ErrorCode.EACCES;
+
+            thr.Nice = nice;
+            Apply(thr);
+            return 0;
+        }
+
+        public static int SchedSetscheduler(Thread current, int pid, int policy, UserPtr param)
+        {
+            int rtPriority;
+            if (param.Read(current, out rtPriority) != 0)
+                return -ErrorCode.EFAULT;
+
+            var thr = Lookup(current, pid);
+            if (thr == null)
+                return -ErrorCode.ESRCH;
+
+            switch (policy)
+            {
+                case SCHED_FIFO:
+                case SCHED_RR:
+                    if (rtPriority < 1 || rtPriority > MAX_RT_PRIO)
+                        return -ErrorCode.EINVAL;
+
+                    if (!MaySetRealtime(current, rtPriority))
+                        return -ErrorCode.EPERM;
+                    break;
+
+                case SCHED_OTHER:
+                case SCHED_BATCH:
+                case SCHED_IDLE:
+                    if (rtPriority != 0)
+                        return -ErrorCode.EINVAL;
+                    break;
+
+                default:
+                    return -ErrorCode.EINVAL;
+            }
+
+            thr.Policy = policy;
+            thr.RTPriority = rtPriority;
+            Apply(thr);
+            return 0;
+        }
+
+        /*
+         * Dalvik yields while it spins on a lock, so the lock holder must
+         * get to run even if its priority is lower.
+         */
+        public static int Yield(Thread current)
+        {
+            if (!current.Yielded)
+            {
+                current.Yielded = true;
+                current.NextYielded = yielded;
+                yielded = current;
+            }
+
+            current.impl.SetPriority(IdlePriority);
+            return 0;
+        }
+
+        /* Give the priority back to a thread that has yielded */
+        public static void EndYield(Thread thr)
+        {
+            if (!thr.Yielded)
+                return;
+
+            if (yielded == thr)
+            {
+                yielded = thr.NextYielded;
+            }
+            else
+            {
+                var prev = yielded;
+                while (prev.NextYielded != thr)
+                    prev = prev.NextYielded;
+
+                prev.NextYielded = thr.NextYielded;
+            }
+
+            thr.Yielded = false;
+            thr.NextYielded = null;
+            Apply(thr);
+        }
+
+        /* Called by the server loop when it has been idle for a tick */
+        public static void EndYields()
+        {
+            while (yielded != null)
+                EndYield(yielded);
+        }
+    }
+}
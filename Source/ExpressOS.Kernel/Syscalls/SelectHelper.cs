@@ -8,151 +8,148 @@ using Arch = ExpressOS.Kernel.Arch;
 
 namespace ExpressOS.Kernel
 {
+    /*
+     * Translate the fd_sets of select() to and from a PollSet.
+     *
+     * The fds are added in ascending order, one slot per fd with the
+     * union of the requested events, so that building the set is linear
+     * in maxfds.
+     */
     public class SelectHelper
     {
-        class FdMapNode
-        {
-            internal readonly int linux_fd;
-            internal readonly int expressos_fd;
-            internal short event_type;
-            internal FdMapNode next;
+        internal readonly PollSet Set;
 
-            internal FdMapNode(int linux_fd, int expressos_fd, short event_type)
-            {
-                this.linux_fd = linux_fd;
-                this.expressos_fd = expressos_fd;
-                this.event_type = event_type;
-            }
-        }
+        int maxfds;
+        UserPtr inp;
+        UserPtr outp;
+        UserPtr exp;
+        FixedSizeBitVector inVec;
+        FixedSizeBitVector outVec;
+        FixedSizeBitVector exVec;
 
-        FdMapNode fdlist;
-        public int TotalFds { get; private set; }
-
-        internal SelectHelper()
+        internal SelectHelper(PollSet set)
         {
-            fdlist = new FdMapNode(0, 0, 0);
+            this.Set = set;
         }
 
-        private int AddFdList(Thread current, FixedSizeBitVector fdlist, short event_type)
+        internal int Load(Thread current, int maxfds, UserPtr inp, UserPtr outp, UserPtr exp)
         {
-            var proc = current.Parent;
-            for (int fd = fdlist.FindNextOne(-1); fd > 0; fd = fdlist.FindNextOne(fd)) {
-                //Arch.Console.Write("AddFdList:");
-                //Arch.Console.Write(fd);
-                //Arch.Console.Write(" ev-");
-                //Arch.Console.Write(event_type);
-                //Arch.Console.WriteLine();
-
-                var file = proc.LookupFile(fd);
-                if (file == null)
-                    return -ErrorCode.EBADF;
+            if (maxfds < 0)
+                return -ErrorCode.EINVAL;
 
-                if (file.inode.LinuxFd < 0)
-                    return -ErrorCode.EINVAL;
+            this.maxfds = maxfds;
+            this.inp = inp;
+            this.outp = outp;
+            this.exp = exp;
 
-                Add(file.inode.LinuxFd, fd, event_type);
+            if (ReadUserFdList(current, inp, out inVec) != 0
+                || ReadUserFdList(current, outp, out outVec) != 0
+                || ReadUserFdList(current, exp, out exVec) != 0)
+                return -ErrorCode.EFAULT;
+
+            var proc = current.Parent;
+            Set.Clear();
+            for (var fd = NextFd(-1); fd >= 0; fd = NextFd(fd))
+            {
+                var event_type = 0;
+                if (IsSet(inVec, fd))
+                    event_type |= Net.POLLIN;
+                if (IsSet(outVec, fd))
+                    event_type |= Net.POLLOUT;
+                if (IsSet(exVec, fd))
+                    event_type |= Net.POLLERR;
+
+                if (Set.Append(proc, fd, event_type) != 0)
+                    return -ErrorCode.EBADF;
             }
             return 0;
         }
 
-        private void Add(int linux_fd, int expressos_fd, short event_type)
+        /*
+         * Write the results of the set back into the fd_sets of the user.
+         * Returns the number of bits set.
+         */
+        internal int WriteUserFdLists(Thread current)
         {
-            if (linux_fd < 0)
-                return;
+            Clear(inVec);
+            Clear(outVec);
+            Clear(exVec);
 
-            var r = fdlist;
-            var prev = r;
-            while (r != null && r.linux_fd < linux_fd)
+            var res = 0;
+            for (var i = 0; i < Set.Count; ++i)
             {
-                prev = r;
-                r = r.next;
-            }
+                var fd = Set.Fd(i);
+                var event_type = Set.Events(i);
+                var revents = Set.REvents(i);
 
-            if (r != null && r.linux_fd == linux_fd)
-            {
-                r.event_type |= event_type;
-            }
-            else
-            {
-                var n = new FdMapNode(linux_fd, expressos_fd, event_type);
-                ++TotalFds;
-                n.next = prev.next;
-                prev.next = n;
-            }
-        }
+                if ((event_type & Net.POLLIN) != 0 && (revents & Net.POLLIN) != 0)
+                {
+                    inVec.Set(fd);
+                    ++res;
+                }
 
-        internal void WritePollFds(ByteBufferRef buf)
-        {
-            Contract.Requires(TotalFds * pollfd.Size <= buf.Length);
+                if ((event_type & Net.POLLOUT) != 0 && (revents & Net.POLLOUT) != 0)
+                {
+                    outVec.Set(fd);
+                    ++res;
+                }
 
-            var i = 0;
-            var r = fdlist.next;
-            while (r != null && i < TotalFds)
-            {
-                pollfd poll_struct;
-                poll_struct.fd = r.linux_fd;
-                poll_struct.events = r.event_type;
-                poll_struct.revents = 0;
-                Contract.Assert(i * pollfd.Size + pollfd.Size <= buf.Length);
-                poll_struct.Write(buf, i * pollfd.Size);
-                ++i;
+                if ((event_type & Net.POLLERR) != 0 && (revents & (Net.POLLERR | Net.POLLHUP)) != 0)
+                {
+                    exVec.Set(fd);
+                    ++res;
+                }
             }
-        }
 
-        internal int AddUserFdList(Thread current, UserPtr fdlist, int maxfds, short event_type)
-        {
-            if (fdlist == UserPtr.Zero)
-                return 0;
-
-            var buf = new byte[(maxfds + 7) / 8];
-            if (fdlist.Read(current, buf) != 0)
+            if ((inVec.Buffer != null && inp.Write(current, inVec.Buffer) != 0)
+                || (outVec.Buffer != null && outp.Write(current, outVec.Buffer) != 0)
+                || (exVec.Buffer != null && exp.Write(current, exVec.Buffer) != 0))
                 return -ErrorCode.EFAULT;
 
-            var vec = new FixedSizeBitVector(maxfds, buf);
-
-            var ret = AddFdList(current, vec, event_type);
-            return ret;
+            return res;
         }
 
-        internal int TranslateToUserFdlist(Thread current, ByteBufferRef buf, int poll_ret, int maxfds, UserPtr userPtr, short event_type)
+        private int ReadUserFdList(Thread current, UserPtr fdlist, out FixedSizeBitVector vec)
         {
-            Contract.Requires(poll_ret * pollfd.Size < buf.Length);
-
-            if (userPtr == UserPtr.Zero)
+            if (fdlist == UserPtr.Zero || maxfds == 0)
+            {
+                vec = new FixedSizeBitVector();
                 return 0;
+            }
 
-            var res = 0;
-            var len = (maxfds + 7) / 8;
-            var vec = new FixedSizeBitVector(maxfds);
+            var buf = new byte[(maxfds + 7) / 8];
+            vec = new FixedSizeBitVector(maxfds, buf);
+            return fdlist.Read(current, buf);
+        }
 
-            for (int i = 0; i < poll_ret; i++)
-            {
-                var poll_struct = pollfd.Deserialize(buf, i * pollfd.Size);
-                var linux_fd = poll_struct.fd;
-                var node = Lookup(linux_fd);
-                if (node == null)
-                    return -ErrorCode.EBADF;
+        private int NextFd(int fd)
+        {
+            var r = NextFd(inVec, fd, -1);
+            r = NextFd(outVec, fd, r);
+            return NextFd(exVec, fd, r);
+        }
 
-                if ((poll_struct.revents & event_type & node.event_type) != 0)
-                {
-                    vec.Set(node.expressos_fd);
-                    ++res;
-                }
-            }
+        private static int NextFd(FixedSizeBitVector vec, int fd, int candidate)
+        {
+            if (vec.Buffer == null)
+                return candidate;
 
-            if (userPtr.Write(current, vec.Buffer) != 0)
-                return -ErrorCode.EFAULT;
+            var r = vec.FindNextOne(fd);
+            if (r < 0)
+                return candidate;
 
-            return res;
+            return candidate < 0 || r < candidate ? r : candidate;
         }
 
-        private FdMapNode Lookup(int linux_fd)
+        private static bool IsSet(FixedSizeBitVector vec, int fd)
         {
-            var r = fdlist.next;
-            while (r != null && r.linux_fd < linux_fd)
-                r = r.next;
+            return vec.Buffer != null && vec.IsSet(fd);
+        }
 
-            return r != null && r.linux_fd == linux_fd ? r : null;
+        private static void Clear(FixedSizeBitVector vec)
+        {
+            if (vec.Buffer != null)
+                vec.Clear();
         }
     }
 }
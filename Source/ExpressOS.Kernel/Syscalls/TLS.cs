@@ -20,6 +20,13 @@ namespace ExpressOS.Kernel
             if (userDescriptor.Read(current, out info) != 0)
                 return -ErrorCode.EFAULT;
 
+            if (current.TLSArray == IntPtr.Zero)
+            {
+                current.TLSArray = AllocArray();
+                if (current.TLSArray == IntPtr.Zero)
+                    return -ErrorCode.ENOMEM;
+            }
+
             var ret = NativeMethods.l4api_set_thread_area(current.impl._value.thread, current.TLSArray, -1, ref info, 1);
 
             if (userDescriptor.Write(current, info) != 0)
@@ -27,5 +34,38 @@ namespace ExpressOS.Kernel
 
             return ret;
         }
+
+        /*
+         * The descriptor arrays come from a slab in the native glue, which
+         * is grown by a page of the page allocator whenever it runs out.
+         * Freed arrays go back to the slab and are handed out again.
+         */
+        internal static IntPtr AllocArray()
+        {
+            var r = NativeMethods.l4api_tls_array_alloc();
+            if (r == IntPtr.Zero && GrowSlab())
+                r = NativeMethods.l4api_tls_array_alloc();
+
+            return r;
+        }
+
+        internal static IntPtr CloneArray(Thread child, Thread parent)
+        {
+            var r = NativeMethods.l4api_tls_array_clone(child.impl._value.thread, parent.TLSArray);
+            if (r == IntPtr.Zero && GrowSlab())
+                r = NativeMethods.l4api_tls_array_clone(child.impl._value.thread, parent.TLSArray);
+
+            return r;
+        }
+
+        private static bool GrowSlab()
+        {
+            var page = Globals.PageAllocator.AllocPage();
+            if (!page.isValid)
+                return false;
+
+            NativeMethods.l4api_tls_slab_grow(new Pointer(page.Location));
+            return true;
+        }
     }
 }
@@ -2,18 +2,30 @@
 {
     /*
      * Tabular working set to solve UserToVirt() query in O(1) time.
-     * It mimics two-level paging on x86 hardware.
+     * It mimics two-level paging on x86 hardware. A page table is freed
+     * as soon as its last entry is cleared, and the walks skip absent
+     * tables, so that sparse reservations cost little.
+     *
+     * An entry with the lowest bit set is not a page, but the handle of a
+     * page in the CompressedPageStore shifted left by one. An entry of
+     * Globals.ZeroPage is a read-only view of zeroes that is not owned by
+     * the working set.
      */
     public class TableWorkingSet
     {
         public const int PDT_SHIFT = 10;
         public const int PGT_SHIFT = 10;
         public const int PGT_IDX_MASK = ((1 << PGT_SHIFT) - 1) << Arch.ArchDefinition.PageShift;
+        public const int PagePerSuperPage = Arch.ArchDefinition.SuperPageSize >> Arch.ArchDefinition.PageShift;
+        private const uint CompressedTag = 1;
 
         private class PageTable
         {
             int DirectoryIndex;
             Pointer[] Table;
+            /* Number of non-empty entries */
+            public int Count;
+
             public Pointer this[int key]
             {
                 get
@@ -22,6 +34,15 @@
                 }
                 set
                 {
+                    if (Table[key] == Pointer.Zero)
+                    {
+                        if (value != Pointer.Zero)
+                            ++Count;
+                    }
+                    else if (value == Pointer.Zero)
+                    {
+                        --Count;
+                    }
                     Table[key] = value;
                 }
             }
@@ -49,7 +70,7 @@
             var table_index = TableIndex(addr);
             var virtualAddr = Directory[directory_index][table_index];
 
-            if (virtualAddr == Pointer.Zero)
+            if (virtualAddr == Pointer.Zero || IsCompressedEntry(virtualAddr))
                 return Pointer.Zero;
     
             virtualAddr += Arch.ArchDefinition.PageOffset(addr.Value.ToInt32());
@@ -69,29 +90,266 @@
             table[table_index] = virtualAddr;
         }
 
+        /*
+         * Whether no page of the superpage that contains addr is present,
+         * apart from the zero page. A page table covers exactly one
+         * superpage.
+         */
+        public bool IsSuperPageEmpty(UserPtr addr)
+        {
+            var table = Directory[DirectoryIndex(addr)];
+            if (table == null)
+                return true;
+
+            for (var i = 0; i < 1 << PGT_SHIFT; ++i)
+            {
+                if (table[i] != Pointer.Zero && table[i] != Globals.ZeroPage)
+                    return false;
+            }
+            return true;
+        }
+
+        /*
+         * Add the pages of a superpage, which are contiguous in the
+         * kernel, to the working set at once. Returns whether it replaces
+         * mappings of the zero page.
+         */
+        public bool AddSuperPage(UserPtr superPage, Pointer virtualAddr)
+        {
+            Utils.Assert(PagePerSuperPage == 1 << PGT_SHIFT);
+            Utils.Assert(IsSuperPageEmpty(superPage));
+
+            var replaced = false;
+            var table = GetOrCreateTable(DirectoryIndex(superPage));
+            for (var i = 0; i < PagePerSuperPage; ++i)
+            {
+                replaced |= table[i] != Pointer.Zero;
+                table[i] = virtualAddr + (i << Arch.ArchDefinition.PageShift);
+            }
+            return replaced;
+        }
+
+        public void Replace(UserPtr userAddress, Pointer virtualAddr)
+        {
+            var table = Directory[DirectoryIndex(userAddress)];
+            Utils.Assert(table != null && table[TableIndex(userAddress)] != Pointer.Zero);
+            table[TableIndex(userAddress)] = virtualAddr;
+        }
+
+        /* Returns the handle of the compressed page of userAddress, or -1 */
+        public int CompressedHandle(UserPtr userAddress)
+        {
+            var table = Directory[DirectoryIndex(userAddress)];
+            if (table == null || !IsCompressedEntry(table[TableIndex(userAddress)]))
+                return -1;
+
+            return (int)(table[TableIndex(userAddress)].ToUInt32() >> 1);
+        }
+
+        /* Replace the page of userAddress with a compressed page, without freeing it */
+        public void SetCompressed(UserPtr userAddress, int handle)
+        {
+            var table = Directory[DirectoryIndex(userAddress)];
+            Utils.Assert(table != null);
+            table[TableIndex(userAddress)] = new Pointer(((uint)handle << 1) | CompressedTag);
+        }
+
+        private static bool IsCompressedEntry(Pointer entry)
+        {
+            return (entry.ToUInt32() & CompressedTag) != 0;
+        }
+
+        /* Number of pages that are present or compressed */
+        public int Size
+        {
+            get
+            {
+                var size = 0;
+                for (var i = 0; i < Directory.Length; ++i)
+                {
+                    if (Directory[i] != null)
+                        size += Directory[i].Count;
+                }
+                return size;
+            }
+        }
+
+        /* Drop the page of userAddress without freeing it */
+        public void Evict(UserPtr userAddress)
+        {
+            Utils.Assert(Directory[DirectoryIndex(userAddress)] != null);
+            Clear(userAddress);
+        }
+
+        private void Clear(UserPtr userAddress)
+        {
+            var directory_index = DirectoryIndex(userAddress);
+            var table = Directory[directory_index];
+            table[TableIndex(userAddress)] = Pointer.Zero;
+
+            if (table.Count == 0)
+                Directory[directory_index] = null;
+        }
+
+        /*
+         * Find the first non-empty entry in [page, end). On success page is
+         * set to its address. Absent page tables are skipped at once.
+         *
+         *   var page = start;
+         *   Pointer entry;
+         *   while (ws.NextEntry(ref page, end, out entry))
+         *   {
+         *       ...
+         *       page += Arch.ArchDefinition.PageSize;
+         *   }
+         */
+        public bool NextEntry(ref UserPtr page, UserPtr end, out Pointer entry)
+        {
+            while (page < end)
+            {
+                var table = Directory[DirectoryIndex(page)];
+                if (table == null)
+                {
+                    var next = (uint)(DirectoryIndex(page) + 1) << (Arch.ArchDefinition.PageShift + PGT_SHIFT);
+                    if (next == 0)
+                        break;
+
+                    page = new UserPtr(next);
+                    continue;
+                }
+
+                for (var i = TableIndex(page); i < 1 << PGT_SHIFT && page < end; ++i)
+                {
+                    if (table[i] != Pointer.Zero)
+                    {
+                        entry = table[i];
+                        return true;
+                    }
+                    page += Arch.ArchDefinition.PageSize;
+                }
+            }
+
+            entry = Pointer.Zero;
+            return false;
+        }
+
+        /*
+         * Give child the entries of [startPage, endPage). Fails if a page
+         * cannot get another owner, the entries shared so far stay.
+         */
+        public bool Share(TableWorkingSet child, UserPtr startPage, UserPtr endPage)
+        {
+            var page = startPage;
+            Pointer p;
+            while (NextEntry(ref page, endPage, out p))
+            {
+                if (IsCompressedEntry(p))
+                {
+                    Globals.CompressedPages.Duplicate((int)(p.ToUInt32() >> 1));
+                    child.Add(page, p);
+                }
+                else if (p == Globals.ZeroPage)
+                {
+                    child.Add(page, p);
+                }
+                else if (Globals.PageAllocator.Contains(p))
+                {
+                    if (!Globals.PageAllocator.Share(p))
+                        return false;
+
+                    child.Add(page, p);
+                }
+
+                page += Arch.ArchDefinition.PageSize;
+            }
+
+            return true;
+        }
+
         public void Remove(AddressSpace parent, UserPtr startPage, UserPtr endPage)
         {
             Utils.Assert(Arch.ArchDefinition.PageOffset(startPage.Value.ToUInt32()) == 0);
             Utils.Assert(Arch.ArchDefinition.PageOffset(endPage.Value.ToUInt32()) == 0);
 
-            for (var page = startPage; page < endPage; page += Arch.ArchDefinition.PageSize)
+            var page = startPage;
+            Pointer entry;
+            while (NextEntry(ref page, endPage, out entry))
+            {
+                if (IsCompressedEntry(entry))
+                    Globals.CompressedPages.Release((int)(entry.ToUInt32() >> 1));
+                else if (entry != Globals.ZeroPage)
+                    MmuGather.FreePage(entry);
+
+                Clear(page);
+                page += Arch.ArchDefinition.PageSize;
+            }
+
+            MmuGather.Flush(parent, startPage.Value, endPage.Value, MemoryRegion.FAULT_MASK);
+        }
+
+        /*
+         * Empty the working set at the teardown of the address space and
+         * release its pages below end. The task is already deleted, so
+         * nothing needs to be unmapped. Runs of private pages of the PageAllocator go back
+         * with one call each, the pages of Linux are queued for one bulk
+         * message, see LinuxMemoryAllocator.FlushBulk().
+         */
+        public void Destroy(UserPtr end)
+        {
+            var allocator = Globals.PageAllocator;
+            var runStart = Pointer.Zero;
+            var runPages = 0;
+
+            for (var directory_index = 0; directory_index <= DirectoryIndex(end - 1); ++directory_index)
             {
-                var directory_index = DirectoryIndex(page);
-                var table_index = TableIndex(page);
                 var table = Directory[directory_index];
                 if (table == null)
                     continue;
 
-                if (table[table_index] == Pointer.Zero)
-                    continue;
+                var base_address = new UserPtr((uint)directory_index << (Arch.ArchDefinition.PageShift + PGT_SHIFT));
+                for (var i = 0; i < 1 << PGT_SHIFT && base_address + (i << Arch.ArchDefinition.PageShift) < end; ++i)
+                {
+                    var entry = table[i];
+                    if (entry == Pointer.Zero || entry == Globals.ZeroPage)
+                        continue;
+
+                    if (IsCompressedEntry(entry))
+                    {
+                        Globals.CompressedPages.Release((int)(entry.ToUInt32() >> 1));
+                    }
+                    else if (!allocator.Contains(entry))
+                    {
+                        Globals.LinuxMemoryAllocator.FreeBulk(entry);
+                    }
+                    else if (allocator.IsShared(entry))
+                    {
+                        allocator.FreePage(entry);
+                    }
+                    else
+                    {
+                        Globals.PageReclaimer.Forget(entry);
+                        if (runPages != 0 && entry == runStart + (runPages << Arch.ArchDefinition.PageShift))
+                        {
+                            ++runPages;
+                            continue;
+                        }
+
+                        if (runPages != 0)
+                            allocator.FreePages(runStart, runPages);
+
+                        runStart = entry;
+                        runPages = 1;
+                    }
+                }
 
-                FreePhysicalPage(table[table_index]);
-                table[table_index] = Pointer.Zero;
+                Directory[directory_index] = null;
             }
 
-            Arch.NativeMethods.l4api_flush_regions(parent.impl._value, startPage.Value, endPage.Value, (int)MemoryRegion.FAULT_MASK);
-        }
+            if (runPages != 0)
+                allocator.FreePages(runStart, runPages);
 
+            Globals.LinuxMemoryAllocator.FlushBulk();
+        }
 
         public void Dump()
         {
@@ -135,13 +393,5 @@
 
             return Directory[directory_index];
         }
-
-        private static void FreePhysicalPage(Pointer page)
-        {
-            if (Globals.PageAllocator.Contains(page))
-                Globals.PageAllocator.FreePage(page);
-            else
-                Globals.LinuxMemoryAllocator.Free(page);
-        }
     }
 }
@@ -8,11 +8,32 @@ namespace ExpressOS.Kernel
     {
         public readonly Arch.ArchThread impl;
         public readonly Process Parent;
+        /* Allocated on the first set_thread_area(), see TLS */
         internal IntPtr TLSArray;
 
         public bool AsyncReturn;
         public readonly VBinderThreadState VBinderState;
         private Arch.ExceptionRegisters regs;
+        private PollSet pollSet;
+        private bool forkReturnPending;
+
+        /* The system call in flight, see SyscallProfiler */
+        internal int ProfileCall;
+        internal ulong ProfileStartTime;
+
+        /* Scheduling parameters, see Sched */
+        internal int Nice;
+        internal int Policy;
+        internal int RTPriority;
+
+        internal Thread NextParked;
+
+        /* Set while the thread runs at the lowest priority after sched_yield() */
+        internal bool Yielded;
+        internal Thread NextYielded;
+
+        /* The pending timeout of the thread in Globals.TimeoutQueue */
+        internal TimerQueueNode TimeoutNode;
        
         [ContractInvariantMethod]
         private void ObjectInvariantMethod()
@@ -28,7 +49,6 @@ namespace ExpressOS.Kernel
             
             this.impl = impl;
             this.Parent = parent;
-            this.TLSArray = Arch.NativeMethods.l4api_tls_array_alloc();
             this.VBinderState = new VBinderThreadState(this);
         }
 
@@ -43,6 +63,7 @@ namespace ExpressOS.Kernel
 
             var res = new Thread(impl, parent);
             Globals.Threads.Add(res);
+            Arch.Trace.Log(Arch.Trace.Event.ThreadCreate, (uint)res.Tid, (uint)parent.helperPid, 0);
 
             return res;
         }
@@ -52,6 +73,38 @@ namespace ExpressOS.Kernel
             impl.Start(ip, sp);
         }
 
+        /*
+         * Start the thread of a forked child. The thread runs into the
+         * system call instruction of its parent, and resumes with the
+         * registers of its parent once it traps. Fails if the TLS
+         * descriptors of the parent cannot be copied.
+         */
+        internal bool StartForkedChild(Thread parent, ref Arch.ExceptionRegisters pt_regs)
+        {
+            if (parent.TLSArray != IntPtr.Zero)
+            {
+                TLSArray = TLS.CloneArray(this, parent);
+                if (TLSArray == IntPtr.Zero)
+                    return false;
+            }
+
+            SaveState(ref pt_regs);
+            forkReturnPending = true;
+            impl.Start(new Pointer(pt_regs.ip), new Pointer((uint)pt_regs.sp));
+            return true;
+        }
+
+        public bool ResumeForkedChild()
+        {
+            if (!forkReturnPending)
+                return false;
+
+            forkReturnPending = false;
+            AsyncReturn = true;
+            ReturnFromSyscall(0);
+            return true;
+        }
+
         public int Tid
         {
             get
@@ -60,12 +113,104 @@ namespace ExpressOS.Kernel
             }
         }
 
-        public void Exit()
+        /*
+         * The interest set of poll() and select(). It is kept across calls so
+         * that the translation of the fds can be reused. It is per thread
+         * because it stays in use while the thread blocks.
+         */
+        internal PollSet PollSet
+        {
+            get
+            {
+                if (pollSet == null)
+                    pollSet = new PollSet();
+
+                return pollSet;
+            }
+        }
+
+        /*
+         * Called on exit(). The L4 thread is parked in its process instead
+         * of being destroyed, as long as there is room and it has never used
+         * vbinder. It keeps waiting for the reply of its exit(), which
+         * StartFromPool() sends when clone() hands it out again. This saves
+         * creating the L4 thread, its IPC gate and its UTCB slot.
+         */
+        public void Exit(ref Arch.ExceptionRegisters pt_regs)
         {
             Globals.CompletionQueue.ClearAllPendingCompletion(impl._value.thread._value);
             Globals.Threads.Remove(this);
+            Sched.EndYield(this);
+            FreeTLSArray();
+
+            if (VBinderState.IsPristine() && Parent.ParkThread(this))
+            {
+                SaveState(ref pt_regs);
+                ProfileStartTime = 0;
+                return;
+            }
+
             impl.Destroy();
+        }
+
+        /* Destroy a thread that has not been started */
+        internal void Destroy()
+        {
+            Globals.Threads.Remove(this);
+            CancelTimeout();
+            Sched.EndYield(this);
+            FreeTLSArray();
+            impl.Destroy();
+        }
+
+        /* Destroy a thread of an exiting process, which Process.Exit() has unlinked */
+        internal void Kill()
+        {
+            Globals.CompletionQueue.ClearAllPendingCompletion(impl._value.thread._value);
+            CancelTimeout();
+            Sched.EndYield(this);
+            FreeTLSArray();
+            impl.Destroy();
+        }
+
+        /* The Looper must not resume a thread that is gone */
+        private void CancelTimeout()
+        {
+            if (TimeoutNode == null)
+                return;
+
+            TimeoutNode.Cancel();
+            TimeoutNode = null;
+        }
+
+        private void FreeTLSArray()
+        {
+            if (TLSArray == IntPtr.Zero)
+                return;
+
             Arch.NativeMethods.l4api_tls_array_free(TLSArray);
+            TLSArray = IntPtr.Zero;
+        }
+
+        /*
+         * Start a parked thread as the child of a clone(). It returns from
+         * the system call of the creator with 0 on the new stack. The other
+         * registers are those of its exit(), which is as good as the zeroed
+         * registers of a fresh thread, except for the segments that select
+         * its old TLS descriptors. Those are cleared like the descriptors
+         * themselves, so that the thread starts without TLS.
+         */
+        internal void StartFromPool(ref Arch.ExceptionRegisters pt_regs, UserPtr sp)
+        {
+            Globals.Threads.Add(this);
+            Arch.Trace.Log(Arch.Trace.Event.ThreadCreate, (uint)Tid, (uint)Parent.helperPid, 0);
+            AsyncReturn = false;
+            FreeTLSArray();
+            regs.gs = 0;
+            regs.fs = 0;
+            regs.ip = pt_regs.ip;
+            regs.sp = (int)sp.Value.ToUInt32();
+            Arch.ArchAPI.ReturnFromSyscall(impl._value.thread, ref regs, 0);
         }
 
         internal void SaveState(ref Arch.ExceptionRegisters pt_regs)
@@ -75,7 +220,10 @@ namespace ExpressOS.Kernel
 
         private void ReturnFromSyscall(int ret)
         {
+            MmuGather.Finish();
+            Arch.Trace.Log(Arch.Trace.Event.SyscallExit, (uint)Tid, (uint)regs.eax, (uint)ret);
             Arch.ArchAPI.ReturnFromSyscall(impl._value.thread, ref regs, ret);
+            SyscallProfiler.ExitSyscall(this);
         }
 
         internal void ReturnFromCompletion(int ret)
@@ -83,6 +231,13 @@ namespace ExpressOS.Kernel
             ReturnFromSyscall(ret);
         }
 
+        /* Resolve a page fault that waited for a completion */
+        internal void ReturnFromPageFault(Pointer faultAddress, Pointer physicalPage, uint permission)
+        {
+            MmuGather.Finish();
+            Arch.ArchAPI.ReturnFromPageFault(impl._value.thread, faultAddress.ToUInt32(), physicalPage, permission, Arch.ArchDefinition.PageShift);
+        }
+
         public void ResumeFromTimeout()
         {
             var completionState = Globals.CompletionQueue.Take(impl._value.thread._value);
@@ -157,6 +312,22 @@ namespace ExpressOS.Kernel
                     FileSystem.HandleOpenFileCompletion(c.OpenFileCompletion, arg1, arg2);
                     break;
 
+                case GenericCompletionEntry.Kind.EventPollCompletionKind:
+                    EventPoll.HandleEventPollAsync(c.EventPollCompletion, arg1);
+                    break;
+
+                case GenericCompletionEntry.Kind.SendStreamCompletionKind:
+                    Net.HandleSendStreamCompletion(c.SendStreamCompletion, arg1);
+                    break;
+
+                case GenericCompletionEntry.Kind.MessageBatchCompletionKind:
+                    Net.HandleMessageBatchCompletion(c.MessageBatchCompletion, arg1);
+                    break;
+
+                case GenericCompletionEntry.Kind.AlienPageCompletionKind:
+                    Pager.HandleAlienPageCompletion(c.AlienPageCompletion, arg1);
+                    break;
+
                 default:
                     Arch.Console.Write("ResumeFromCompletion: Unknown entry ");
                     Arch.Console.Write((uint)c.kind);
@@ -25,6 +25,14 @@ namespace ExpressOS.Kernel
             this.next = tl;
         }
 
+        internal ThreadList Next
+        {
+            get
+            {
+                return next;
+            }
+        }
+
         public Thread Lookup(Arch.L4Handle handle)
         {
             var h = handle._value;
@@ -36,6 +44,24 @@ namespace ExpressOS.Kernel
             return t == null ? null : t.thr;
         }
 
+        /* Unlink and return a thread of process, or null if there is none */
+        internal Thread TakeThreadOf(Process process)
+        {
+            var prev = this;
+            ThreadList tl = this.next;
+            while (tl != null && tl.thr.Parent != process)
+            {
+                prev = tl;
+                tl = tl.next;
+            }
+
+            if (tl == null)
+                return null;
+
+            prev.next = tl.next;
+            return tl.thr;
+        }
+
         internal void Remove(Thread thread)
         {
             var prev = this;
@@ -0,0 +1,125 @@
+﻿using System.Diagnostics.Contracts;
+
+namespace ExpressOS.Kernel
+{
+    /*
+     * A read-only page mapped at the same location of every address space,
+     * so that gettimeofday() and clock_gettime() can be answered in user
+     * space without entering the kernel. The KIP of L4 itself is not
+     * exposed, instead the kernel copies its clock, which counts
+     * microseconds since boot, into the page whenever it receives a
+     * request, and at least every UpdateInterval while it is idle.
+     *
+     * Layout of the page:
+     *
+     *   0  magic
+     *   4  version
+     *   8  KIP clock at boot (64-bit)
+     *  16  CLOCK_REALTIME at boot (struct timespec)
+     *  24  CLOCK_MONOTONIC at boot (struct timespec)
+     *  32  KIP clock at the last update (64-bit)
+     *  40  sequence of the updates (32-bit)
+     *
+     * A clock reads as its base plus the microseconds that the KIP clock
+     * had advanced at the last update, which is the same as Misc.GetTime()
+     * at that moment. The result is coarse, like CLOCK_REALTIME_COARSE,
+     * precise readings still take clock_gettime().
+     *
+     * The location is passed to the program in the auxiliary vector.
+     */
+    public static class TimePage
+    {
+        public const uint Location = AddressSpace.KERNEL_OFFSET - Size;
+        public const int Size = Arch.ArchDefinition.PageSize;
+
+        /*
+         * Type of the auxiliary vector entry, private to ExpressOS.
+         *
+         * The clock at offset 32 is updated like a seqlock. A reader loads
+         * the sequence, and starts over while it is odd, as an update is in
+         * progress. It then reads the clock, loads the sequence again and
+         * starts over if it has changed. The words are stored in order,
+         * which x86 keeps visible to the reader.
+         */
+        public const uint AT_EXPRESSOS_TIMEPAGE = 0x4554;
+
+        /* Longest time in microseconds between two updates */
+        public const uint UpdateInterval = 4000;
+
+        private const uint Magic = 0x454d4954; /* "TIME" */
+        private const uint Version = 3;
+
+        private const int OFFSET_OF_EPOCH = 8;
+        private const int OFFSET_OF_REALTIME = 16;
+        private const int OFFSET_OF_MONOTONIC = 24;
+        private const int OFFSET_OF_CLOCK = 32;
+        private const int OFFSET_OF_SEQUENCE = 40;
+
+        private static ByteBufferRef DataPage;
+        private static uint sequence;
+
+        public static void Initialize()
+        {
+            var buf = Globals.PageAllocator.AllocPage();
+            if (!buf.isValid)
+            {
+                Arch.Console.WriteLine("Cannot allocate the time page");
+                Utils.Panic();
+            }
+
+            buf.Clear();
+            Deserializer.WriteUInt(Magic, buf, 0);
+            Deserializer.WriteUInt(Version, buf, sizeof(uint));
+            Deserializer.WriteULong(Misc.Epoch, buf, OFFSET_OF_EPOCH);
+            WriteTimeSpec(Misc.UptimeTimeSpec, buf, OFFSET_OF_REALTIME);
+            WriteTimeSpec(Misc.MonotonicTimeSpec, buf, OFFSET_OF_MONOTONIC);
+
+            DataPage = buf;
+            sequence = 0;
+            Update();
+        }
+
+        /*
+         * Called by the server loop whenever it has received a request or
+         * has been idle for UpdateInterval.
+         */
+        public static void Update()
+        {
+            var clock = Arch.NativeMethods.l4api_get_system_clock();
+
+            WriteWord(OFFSET_OF_SEQUENCE, ++sequence);
+            WriteWord(OFFSET_OF_CLOCK, (uint)clock);
+            WriteWord(OFFSET_OF_CLOCK + sizeof(uint), (uint)(clock >> 32));
+            WriteWord(OFFSET_OF_SEQUENCE, ++sequence);
+        }
+
+        /* A single aligned store, which a reader never sees half done */
+        private static unsafe void WriteWord(int offset, uint val)
+        {
+            Contract.Requires(offset >= 0 && offset + sizeof(uint) <= Size && (offset & 3) == 0);
+            *(uint*)((byte*)DataPage.Location.ToPointer() + offset) = val;
+        }
+
+        private static void WriteTimeSpec(timespec t, ByteBufferRef buf, int offset)
+        {
+            Contract.Requires(offset >= 0 && offset + timespec.Size <= buf.Length);
+            Deserializer.WriteUInt(t.tv_sec, buf, offset);
+            Deserializer.WriteUInt(t.tv_nsec, buf, offset + sizeof(uint));
+        }
+
+        /*
+         * The page is never freed. The region that covers it is fixed,
+         * thus it is neither unmapped nor shared copy-on-write.
+         */
+        internal static void AddIntoWorkingSet(TableWorkingSet workingSet)
+        {
+            workingSet.Add(new UserPtr(Location), new Pointer(DataPage.Location));
+        }
+
+        [Pure]
+        internal static bool Overlapped(uint start, uint length)
+        {
+            return !(start + length <= Location || start >= Location + Size);
+        }
+    }
+}
@@ -60,17 +60,40 @@ namespace ExpressOS.Kernel
             }
         }
 
+        /* Same as NextRecvTimeout(), but waits limit microseconds at most */
+        public Arch.Timeout NextRecvTimeout(uint limit)
+        {
+            var currentTime = Arch.NativeMethods.l4api_get_system_clock();
+            var r = list.next;
+            if (r != null && r.clock <= currentTime)
+                return Arch.Timeout.RecvZero;
+
+            if (r == null || r.clock - currentTime > limit)
+                return new Arch.Timeout(0, limit);
+
+            return new Arch.Timeout(0, (uint)(r.clock - currentTime));
+        }
+
         public Thread Take()
         {
             var r = list.next;
             r.Unlink();
+            if (r.thr != null && r.thr.TimeoutNode == r)
+                r.thr.TimeoutNode = null;
+
             return r.thr;
         }
 
         public TimerQueueNode Enqueue(ulong timeout, Thread thr)
         {
             var currentTime = Arch.NativeMethods.l4api_get_system_clock();
-            var node = new TimerQueueNode(currentTime + timeout, thr);
+            return EnqueueAt(currentTime + timeout, thr);
+        }
+
+        /* Same as Enqueue(), at the absolute time clock of the KIP clock */
+        public TimerQueueNode EnqueueAt(ulong clock, Thread thr)
+        {
+            var node = new TimerQueueNode(clock, thr);
 
             var r = list.next;
             var prev = list;
@@ -87,6 +110,9 @@ namespace ExpressOS.Kernel
                 prev.next.prev = node;
             prev.next = node;
 
+            if (thr != null)
+                thr.TimeoutNode = node;
+
             return node;
         }
     }
@@ -0,0 +1,319 @@
+﻿using System.Diagnostics.Contracts;
+
+namespace ExpressOS.Kernel
+{
+    /*
+     * Replays the memory workload of a recorded trace (see Arch.Trace).
+     *
+     * Linux places a batch in the format of EXPRESSOS_CMD_DRAIN_TRACE into
+     * the synchronous IPC buffer. The memory system calls and page faults
+     * of each recorded process are replayed against a scratch process, so
+     * that changes of the page allocator and the pager can be compared on
+     * identical workloads.
+     *
+     * The Linux helper is stubbed out: every mapping, including the
+     * segments and the stack mapped by exec(), is replayed as an anonymous
+     * private mapping at the recorded address, and faults are served with
+     * fresh pages. Other system calls and the completions are skipped. The
+     * scratch processes exit at the end of each replay.
+     */
+    public static class TraceReplayer
+    {
+        private const uint TraceMagic = 0x45435254;
+        private const int HeaderSize = 16;
+        private const int RecordSize = 32;
+
+        private const int OFFSET_OF_EVENT = 8;
+        private const int OFFSET_OF_THREAD = 12;
+        private const int OFFSET_OF_ARGS = 16;
+
+        private const int MaxErrno = 4095;
+
+        private const int MaxProcesses = 8;
+        /* Initial size of the thread tables, which double when they are full */
+        private const int InitialThreads = 64;
+
+        /* Keep in sync with SyscallDispatcher */
+        private const int __NR_brk = 45;
+        private const int __NR_munmap = 91;
+        private const int __NR_mprotect = 125;
+        private const int __NR_mmap2 = 192;
+        private const int __NR_madvise = 219;
+
+        private static int[] processPids;
+        private static Thread[] processThreads;
+
+        /* Recorded threads, their processes and their system call in flight */
+        private static int threadCount;
+        private static uint[] threadIds;
+        private static int[] threadPids;
+        private static int[] pendingCall;
+        private static uint[] pendingArg0;
+        private static uint[] pendingArg1;
+        private static uint[] pendingArg2;
+        private static uint[] pendingArg3;
+
+        private static int replayedCalls;
+        private static int replayedFaults;
+
+        public static void Initialize()
+        {
+            processPids = new int[MaxProcesses];
+            processThreads = new Thread[MaxProcesses];
+            threadIds = new uint[InitialThreads];
+            threadPids = new int[InitialThreads];
+            pendingCall = new int[InitialThreads];
+            pendingArg0 = new uint[InitialThreads];
+            pendingArg1 = new uint[InitialThreads];
+            pendingArg2 = new uint[InitialThreads];
+            pendingArg3 = new uint[InitialThreads];
+        }
+
+        /*
+         * Replay the batch in buf. Returns the number of records that have
+         * been replayed, or a negative error code.
+         */
+        public static int Replay(ByteBufferRef buf)
+        {
+            if (buf.Length < HeaderSize || Deserializer.ReadUInt(buf, 0) != TraceMagic
+                || Deserializer.ReadUInt(buf, sizeof(uint)) != RecordSize)
+                return -ErrorCode.EINVAL;
+
+            var count = (int)Deserializer.ReadUInt(buf, 2 * sizeof(uint));
+            if (count < 0 || count > (buf.Length - HeaderSize) / RecordSize)
+                return -ErrorCode.EINVAL;
+
+            threadCount = 0;
+            replayedCalls = 0;
+            replayedFaults = 0;
+
+            var startTime = Arch.NativeMethods.l4api_get_system_clock();
+            for (var i = 0; i < count; ++i)
+                ReplayRecord(buf, HeaderSize + i * RecordSize);
+
+            var elapsed = Arch.NativeMethods.l4api_get_system_clock() - startTime;
+
+            for (var i = 0; i < MaxProcesses; ++i)
+            {
+                if (processThreads[i] == null)
+                    continue;
+
+                processThreads[i].Parent.Exit();
+                processThreads[i] = null;
+            }
+
+            Arch.Console.Write("replay: records=");
+            Arch.Console.Write(count);
+            Arch.Console.Write(" calls=");
+            Arch.Console.Write(replayedCalls);
+            Arch.Console.Write(" faults=");
+            Arch.Console.Write(replayedFaults);
+            Arch.Console.Write(" us=");
+            Arch.Console.Write(elapsed);
+            Arch.Console.WriteLine();
+            return count;
+        }
+
+        private static void ReplayRecord(ByteBufferRef buf, int offset)
+        {
+            Contract.Requires(offset >= 0 && offset + RecordSize <= buf.Length);
+
+            var e = (Arch.Trace.Event)Deserializer.ReadShort(buf, offset + OFFSET_OF_EVENT);
+            var tid = Deserializer.ReadUInt(buf, offset + OFFSET_OF_THREAD);
+            var a0 = Deserializer.ReadUInt(buf, offset + OFFSET_OF_ARGS);
+            var a1 = Deserializer.ReadUInt(buf, offset + OFFSET_OF_ARGS + sizeof(uint));
+            var a2 = Deserializer.ReadUInt(buf, offset + OFFSET_OF_ARGS + 2 * sizeof(uint));
+            var a3 = Deserializer.ReadUInt(buf, offset + OFFSET_OF_ARGS + 3 * sizeof(uint));
+
+            switch (e)
+            {
+                case Arch.Trace.Event.ThreadCreate:
+                    threadPids[LookupThread(tid)] = (int)a0;
+                    break;
+
+                case Arch.Trace.Event.SyscallEnter:
+                    {
+                        var t = LookupThread(tid);
+                        pendingCall[t] = (int)a0;
+                        pendingArg0[t] = a1;
+                        pendingArg1[t] = a2;
+                        pendingArg2[t] = a3;
+                        pendingArg3[t] = 0;
+                    }
+                    break;
+
+                case Arch.Trace.Event.SyscallArgs:
+                    pendingArg3[LookupThread(tid)] = a0;
+                    break;
+
+                case Arch.Trace.Event.Map:
+                    /* Mappings made by exec() on behalf of the process tid */
+                    {
+                        var thr = GetScratchThread((int)tid);
+                        if (thr == null)
+                            break;
+
+                        thr.Parent.Space.AddMapping(a2, 0, null, 0, 0, new Pointer(a0), (int)a1);
+                        replayedCalls++;
+                    }
+                    break;
+
+                case Arch.Trace.Event.SyscallExit:
+                    {
+                        var t = LookupThread(tid);
+                        if (pendingCall[t] == (int)a0)
+                            ReplaySyscall(t, (int)a1);
+
+                        pendingCall[t] = -1;
+                    }
+                    break;
+
+                case Arch.Trace.Event.PageFault:
+                    /* a3 is the page shift of the resolved fault, or 0 if it failed */
+                    if (a3 != 0)
+                    {
+                        var thr = GetScratchThread(threadPids[LookupThread(tid)]);
+                        if (thr == null)
+                            break;
+
+                        Pointer physicalPage;
+                        uint permission;
+                        Pager.HandlePageFault(thr.Parent, a2, new Pointer(a0), new Pointer(a1), out physicalPage, out permission);
+                        replayedFaults++;
+                    }
+                    break;
+            }
+        }
+
+        private static void ReplaySyscall(int t, int ret)
+        {
+            if (ret < 0 && ret >= -MaxErrno)
+                return;
+
+            var thr = GetScratchThread(threadPids[t]);
+            if (thr == null)
+                return;
+
+            var space = thr.Parent.Space;
+            switch (pendingCall[t])
+            {
+                case __NR_mmap2:
+                    Memory.mmap2(thr, new UserPtr(ret), (int)pendingArg1[t], (int)pendingArg2[t],
+                        Memory.MAP_FIXED | Memory.MAP_PRIVATE | Memory.MAP_ANONYMOUS | ((int)pendingArg3[t] & Memory.MAP_POPULATE), -1, 0);
+                    break;
+
+                case __NR_munmap:
+                    Memory.munmap(thr, new UserPtr(pendingArg0[t]), (int)pendingArg1[t]);
+                    break;
+
+                case __NR_mprotect:
+                    Memory.mprotect(thr, new UserPtr(pendingArg0[t]), (int)pendingArg1[t], (int)pendingArg2[t]);
+                    break;
+
+                case __NR_madvise:
+                    Memory.madvise(thr, pendingArg0[t], (int)pendingArg1[t], (int)pendingArg2[t]);
+                    break;
+
+                case __NR_brk:
+                    /* The first brk() reveals the start of the heap */
+                    if (space.StartBrk == 0)
+                        space.Brk = space.StartBrk = (uint)ret;
+                    else
+                        Memory.Brk(thr, (uint)ret);
+                    break;
+
+                default:
+                    return;
+            }
+            replayedCalls++;
+        }
+
+        private static int LookupThread(uint tid)
+        {
+            for (var i = 0; i < threadCount; ++i)
+            {
+                if (threadIds[i] == tid)
+                    return i;
+            }
+
+            if (threadCount == threadIds.Length)
+                GrowThreads();
+
+            /* Threads created before the recording started form their own process */
+            var slot = threadCount++;
+            threadIds[slot] = tid;
+            threadPids[slot] = (int)tid;
+            pendingCall[slot] = -1;
+            return slot;
+        }
+
+        private static void GrowThreads()
+        {
+            var size = threadIds.Length * 2;
+            threadIds = Grow(threadIds, size);
+            threadPids = Grow(threadPids, size);
+            pendingCall = Grow(pendingCall, size);
+            pendingArg0 = Grow(pendingArg0, size);
+            pendingArg1 = Grow(pendingArg1, size);
+            pendingArg2 = Grow(pendingArg2, size);
+            pendingArg3 = Grow(pendingArg3, size);
+        }
+
+        private static uint[] Grow(uint[] table, int size)
+        {
+            var r = new uint[size];
+            for (var i = 0; i < table.Length; ++i)
+                r[i] = table[i];
+
+            return r;
+        }
+
+        private static int[] Grow(int[] table, int size)
+        {
+            var r = new int[size];
+            for (var i = 0; i < table.Length; ++i)
+                r[i] = table[i];
+
+            return r;
+        }
+
+        private static Thread GetScratchThread(int pid)
+        {
+            var free = -1;
+            for (var i = 0; i < MaxProcesses; ++i)
+            {
+                if (processThreads[i] == null)
+                {
+                    if (free == -1)
+                        free = i;
+                }
+                else if (processPids[i] == pid)
+                {
+                    return processThreads[i];
+                }
+            }
+
+            if (free == -1)
+                return null;
+
+            var appInfo = new AndroidApplicationInfo();
+            appInfo.PackageName = "replay";
+            appInfo.DataDir = "/data/data/replay";
+
+            var proc = new Process(new ASCIIString("replay"), appInfo);
+            if (proc.Space.impl._value.isInvalid)
+                return null;
+
+            var thr = Thread.Create(proc);
+            if (thr == null)
+            {
+                proc.Exit();
+                return null;
+            }
+
+            processPids[free] = pid;
+            processThreads[free] = thr;
+            return thr;
+        }
+    }
+}
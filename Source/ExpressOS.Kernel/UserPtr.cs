@@ -130,7 +130,7 @@ namespace ExpressOS.Kernel
                 }
 
                 var off = Arch.ArchDefinition.PageOffset(src.ToUInt32());
-                var virtualAddr = process.Space.UserToVirt(new UserPtr(src));
+                var virtualAddr = process.Space.UserToVirtForWrite(new UserPtr(src));
 
                 if (virtualAddr == Pointer.Zero)
                 {
@@ -141,6 +141,8 @@ namespace ExpressOS.Kernel
 
                     if (virtualAddr == Pointer.Zero)
                         break;
+
+                    Globals.PageReclaimer.MarkDirty(Pager.PageIndex(virtualAddr));
                 }
 
                 var virtual_page = Arch.ArchDefinition.PageIndex(virtualAddr.ToUInt32());
@@ -283,6 +285,15 @@ namespace ExpressOS.Kernel
             return r;
         }
 
+        internal unsafe int Read(Thread current, out socketcall_args val, int nargs)
+        {
+            Contract.Requires(nargs >= 0 && nargs <= socketcall_args.MaxArgs);
+            socketcall_args v = new socketcall_args();
+            var r = Read(current, &v, nargs * sizeof(int));
+            val = v;
+            return r;
+        }
+
         internal unsafe int Read(Thread current, out timeval val)
         {
             timeval v;
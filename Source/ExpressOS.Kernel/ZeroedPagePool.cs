@@ -0,0 +1,113 @@
+﻿namespace ExpressOS.Kernel
+{
+    /*
+     * Pages zeroed ahead of time, so that anonymous faults and the cache
+     * of the secure file system do not clear pages synchronously.
+     *
+     * The server loop refills the pool once no message has arrived for
+     * RefillDelay, up to Watermark pages, which the boot manifest can
+     * change. The pool counts as free memory: the PageReclaimer drains it
+     * before it evicts any page. The pages are
+     * cleared with non-temporal stores to leave the cache alone. Refills
+     * stop once the free memory drops to the high watermark of the
+     * PageReclaimer, so the pool never causes reclaim.
+     *
+     * The free pages are chained through their first word, which is
+     * cleared when a page is taken.
+     */
+    public class ZeroedPagePool
+    {
+        private const int RefillBatch = 16;
+
+        /* Idle time in microseconds before a batch is zeroed */
+        public const uint RefillDelay = 100;
+
+        private FreeListPageAllocator allocator;
+        private Pointer head;
+        private int count;
+
+        public int Watermark;
+        public int Hits;
+        public int Misses;
+
+        public void Initialize(FreeListPageAllocator allocator)
+        {
+            this.allocator = allocator;
+            this.head = Pointer.Zero;
+            this.count = 0;
+            this.Watermark = 256;
+        }
+
+        public bool NeedsRefill
+        {
+            get { return count < Watermark && allocator.FreePageCount > Globals.PageReclaimer.HighWatermark + RefillBatch; }
+        }
+
+        /* Returns a zeroed page, or an empty buffer if the pool is empty */
+        internal ByteBufferRef Take()
+        {
+            if (count == 0)
+            {
+                ++Misses;
+                return ByteBufferRef.Empty;
+            }
+
+            var buf = new ByteBufferRef(head.ToIntPtr(), Arch.ArchDefinition.PageSize);
+            head = new Pointer(Deserializer.ReadUInt(buf, 0));
+            Deserializer.WriteUInt(0, buf, 0);
+            --count;
+            ++Hits;
+            return buf;
+        }
+
+        /* Give up to pages pages back to the allocator. Returns how many */
+        internal int Drain(int pages)
+        {
+            var n = 0;
+            while (n < pages && count > 0)
+            {
+                var buf = new ByteBufferRef(head.ToIntPtr(), Arch.ArchDefinition.PageSize);
+                var page = head;
+                head = new Pointer(Deserializer.ReadUInt(buf, 0));
+                --count;
+
+                allocator.FreePage(page);
+                ++n;
+            }
+
+            return n;
+        }
+
+        /* Called from the idle server loop, zeroes a small batch of pages */
+        public void Refill()
+        {
+            for (var i = 0; i < RefillBatch && count < Watermark; ++i)
+            {
+                var page = allocator.AllocPageRaw();
+                if (!page.isValid)
+                    return;
+
+                allocator.ClearPage(page);
+                Deserializer.WriteUInt(head.ToUInt32(), page, 0);
+                head = new Pointer(page.Location);
+                ++count;
+            }
+        }
+
+        /*
+         * Dump in CSV as
+         *
+         *   zeroed,pool_pages,hits,misses
+         */
+        public void Dump()
+        {
+            Arch.LinuxConsole.Write("zeroed,");
+            Arch.LinuxConsole.Write(count);
+            Arch.LinuxConsole.Write(",");
+            Arch.LinuxConsole.Write(Hits);
+            Arch.LinuxConsole.Write(",");
+            Arch.LinuxConsole.Write(Misses);
+            Arch.LinuxConsole.WriteLine();
+        }
+    }
+}
@@ -12,6 +12,10 @@ namespace ExpressOS.Kernel.Arch
             EXPRESSOS_CMD_ENABLE_PROFILER,
             EXPRESSOS_CMD_DISABLE_PROFILER,
             EXPRESSOS_CMD_FLUSH_CONSOLE,
+            EXPRESSOS_CMD_ENABLE_TRACE,
+            EXPRESSOS_CMD_DISABLE_TRACE,
+            EXPRESSOS_CMD_DRAIN_TRACE,
+            EXPRESSOS_CMD_REPLAY_TRACE,
         }
 
         //
@@ -40,16 +44,29 @@ namespace ExpressOS.Kernel.Arch
                 while (timeout == Timeout.RecvZero)
                 {
                     var thr = Globals.TimeoutQueue.Take();
+                    Trace.Log(Trace.Event.TimerExpire, (uint)thr.Tid, 0, 0);
                     thr.ResumeFromTimeout();
                     timeout = Globals.TimeoutQueue.NextRecvTimeout();
                 }
 
+                Globals.PageReclaimer.Balance();
+                MmuGather.Finish();
+
+                /*
+                 * Wake up every TimePage.UpdateInterval so that the time
+                 * page keeps advancing, and after a short while only when
+                 * the pool of zeroed pages runs low, to refill it if
+                 * nothing has arrived by then.
+                 */
+                var refill = Globals.ZeroedPages.NeedsRefill && NativeMethods.linux_pending_reply_count() == 0;
+                var waitTimeout = Globals.TimeoutQueue.NextRecvTimeout(refill ? ZeroedPagePool.RefillDelay : TimePage.UpdateInterval);
+
                 while (do_wait && !timeouted)
                 {
                     if (NativeMethods.linux_pending_reply_count() > 0)
-                        tag = NativeMethods.l4api_ipc_send_and_wait(linux_server_tid, u, pullTag, out src, timeout);
+                        tag = NativeMethods.l4api_ipc_send_and_wait(linux_server_tid, u, pullTag, out src, waitTimeout);
                     else
-                        tag = NativeMethods.l4api_ipc_wait(u, out src, timeout);
+                        tag = NativeMethods.l4api_ipc_wait(u, out src, waitTimeout);
                 
                     do_wait = tag.HasError;
                    
@@ -61,12 +78,21 @@ namespace ExpressOS.Kernel.Arch
                 }
 
                 if (timeouted)
+                {
+                    TimePage.Update();
+                    Sched.EndYields();
+                    if (refill)
+                        Globals.ZeroedPages.Refill();
+
                     continue;
+                }
 
                 // Get rid of permission mask
                 src._value = (src._value >> L4Handle.L4_CAP_SHIFT) << L4Handle.L4_CAP_SHIFT;
 
+                TimePage.Update();
                 HandleMessage(src, ref tag, ref *NativeMethods.l4api_utcb_exc(), ref *mr);
+                MmuGather.Finish();
                 do_wait = true;
             }
         }
@@ -79,11 +105,14 @@ namespace ExpressOS.Kernel.Arch
                 thr = Globals.Threads.Lookup(src);
                 if (thr == null)
                 {
-                    Console.Write("HandleMessage: Unknown thread ");
-                    Console.Write(src._value);
-                    Console.Write(" tag=");
-                    Console.Write(tag.raw);
-                    Console.WriteLine();
+                    if (Console.RateLimit())
+                    {
+                        Console.Write("HandleMessage: Unknown thread ");
+                        Console.Write(src._value);
+                        Console.Write(" tag=");
+                        Console.Write(tag.raw);
+                        Console.WriteLine();
+                    }
                     return REPLY_DEFERRED;
                 }
 
@@ -118,6 +147,18 @@ namespace ExpressOS.Kernel.Arch
                     case IPCCommand.EXPRESSOS_CMD_FLUSH_CONSOLE:
                         Console.Flush();
                         break;
+                    case IPCCommand.EXPRESSOS_CMD_ENABLE_TRACE:
+                        Trace.Enable = true;
+                        break;
+                    case IPCCommand.EXPRESSOS_CMD_DISABLE_TRACE:
+                        Trace.Enable = false;
+                        break;
+                    case IPCCommand.EXPRESSOS_CMD_DRAIN_TRACE:
+                        Trace.Drain();
+                        break;
+                    case IPCCommand.EXPRESSOS_CMD_REPLAY_TRACE:
+                        TraceReplayer.Replay(Globals.LinuxIPCBuffer);
+                        break;
                 }
                 return REPLY_DEFERRED;
             }
@@ -147,7 +188,10 @@ namespace ExpressOS.Kernel.Arch
 
             Pointer physicalPage;
             uint permssion;
-            Pager.HandlePageFault(thr.Parent, faultType, new Pointer(pfa), new Pointer(pc), out physicalPage, out permssion);
+            int pageShift;
+            Pager.HandlePageFault(thr, faultType, new Pointer(pfa), new Pointer(pc), out physicalPage, out permssion, out pageShift);
+            MmuGather.Finish();
+            Trace.Log(Trace.Event.PageFault, (uint)thr.Tid, pfa, pc, faultType, physicalPage == Pointer.Zero ? 0 : (uint)pageShift);
 
             if (thr.AsyncReturn)
                 return REPLY_DEFERRED;
@@ -156,20 +200,17 @@ namespace ExpressOS.Kernel.Arch
             {
                 // We got an error, don't reply
                 // thr.Parent.Space.Regions.DumpAll();
-                Console.Write("Unhandled page fault ");
-                Console.Write(pfa);
-                Console.Write("@");
-                Console.Write(pc);
-                Console.Write(" thr=");
-                Console.Write(thr.Tid);
-                Console.WriteLine();
-
-                thr.Parent.Space.DumpAll();
+                if (Console.RateLimit())
+                {
+                    Console.WriteFormat("Unhandled page fault %#x@%#x thr=%d\n", pfa, pc, (uint)thr.Tid, 0);
+                    thr.Parent.Space.DumpAll();
+                    Console.Flush();
+                }
 
                 return REPLY_DEFERRED;
             }
 
-            ArchAPI.ReturnFromPageFault(src, out tag, ref mr, pfa, physicalPage, permssion);
+            ArchAPI.ReturnFromPageFault(src, out tag, ref mr, pfa, physicalPage, permssion, pageShift);
             return REPLY_IMMEDIATELY;
         }
 
@@ -182,14 +223,16 @@ namespace ExpressOS.Kernel.Arch
             ExceptionRegisters exc = pt_regs;
             var scno = exc.eax;
 
-            SyscallProfiler.EnterSyscall(scno);
+            SyscallProfiler.EnterSyscall(thr, scno);
             var ret = SyscallDispatcher.Dispatch(thr, ref exc);
+            MmuGather.Finish();
 
             if (thr.AsyncReturn)
                 return REPLY_DEFERRED;
 
             ArchAPI.ReturnFromSyscall(src, ref exc, ret);
-            SyscallProfiler.ExitSyscall(scno);
+            Trace.Log(Trace.Event.SyscallExit, (uint)thr.Tid, (uint)scno, (uint)ret);
+            SyscallProfiler.ExitSyscall(thr);
 
             return REPLY_DEFERRED;
         }
@@ -205,11 +248,15 @@ namespace ExpressOS.Kernel.Arch
             int arg5 = (int)mr.mr6;
 
             var e = Globals.CompletionQueue.Take(handle);
+            Trace.Log(Trace.Event.Completion, handle, (uint)asyncCallType, (uint)arg1, (uint)arg2, (uint)arg3);
             if (e == null)
             {
-                Console.Write("HandleAsyncCall: cannot find completion for handle ");
-                Console.Write(handle);
-                Console.WriteLine();
+                if (Console.RateLimit())
+                {
+                    Console.Write("HandleAsyncCall: cannot find completion for handle ");
+                    Console.Write(handle);
+                    Console.WriteLine();
+                }
                 return;
             }
 
@@ -11,6 +11,18 @@ namespace ExpressOS.Kernel.Arch
             ArchAPI.GetSyscallParameters(regs, out scno, out arg0, out arg1, out arg2, out arg3, out arg4, out arg5);
 
             current.AsyncReturn = false;
+            ExpressOS.Kernel.Sched.EndYield(current);
+            ExpressOS.Kernel.BootManifest.EnterSyscall(current);
+
+            // The first trap of a forked child returns from its parent's fork()
+            if (current.ResumeForkedChild())
+                return 0;
+
+            if (Trace.Enable)
+            {
+                Trace.Log(Trace.Event.SyscallEnter, (uint)current.Tid, (uint)scno, (uint)arg0, (uint)arg1, (uint)arg2);
+                Trace.Log(Trace.Event.SyscallArgs, (uint)current.Tid, (uint)arg3, (uint)arg4, (uint)arg5, 0);
+            }
 
             int retval = 0;
 
@@ -20,7 +32,7 @@ namespace ExpressOS.Kernel.Arch
                     Console.Write("Thread ");
                     Console.Write(current.Tid);
                     Console.WriteLine(" Exited");
-                    current.Exit();
+                    current.Exit(ref regs);
                     current.AsyncReturn = true;
                     break;
 
@@ -60,6 +72,11 @@ namespace ExpressOS.Kernel.Arch
                     retval = FileSystem.Mkdir(current, new UserPtr(arg0), arg1);
                     break;
 
+                case __NR_fork:
+                case __NR_vfork:
+                    retval = ExpressOS.Kernel.Exec.Fork(current, ref regs);
+                    break;
+
                 case __NR_clone:
                     retval = ExpressOS.Kernel.Exec.Clone(current, (uint)arg0, new UserPtr(arg1), new UserPtr(arg2), new UserPtr(arg3), ref regs);
                     break;
@@ -109,8 +126,6 @@ namespace ExpressOS.Kernel.Arch
                 case __NR_flock:
                 case __NR_sigaction:
                 case __NR_sigprocmask:
-                case __NR_sched_setscheduler:
-                case __NR_setpriority:
                 case __NR_fsync:
 
                     //Console.Write("Mock syscall ");
@@ -145,7 +160,15 @@ namespace ExpressOS.Kernel.Arch
                     break;
 
                 case __NR_getpriority:
-                    retval = ExpressOS.Kernel.Misc.Getpriority(current, arg0, arg1);
+                    retval = ExpressOS.Kernel.Sched.Getpriority(current, arg0, arg1);
+                    break;
+
+                case __NR_setpriority:
+                    retval = ExpressOS.Kernel.Sched.Setpriority(current, arg0, arg1, arg2);
+                    break;
+
+                case __NR_sched_setscheduler:
+                    retval = ExpressOS.Kernel.Sched.SchedSetscheduler(current, arg0, arg1, new UserPtr(arg2));
                     break;
 
                 case __NR_pread64:
@@ -186,13 +209,33 @@ namespace ExpressOS.Kernel.Arch
                     break;
 
                 case __NR_sched_yield:
-                    retval = ExpressOS.Kernel.Misc.Yield(current, ref regs);
+                    retval = ExpressOS.Kernel.Sched.Yield(current);
                     break;
 
                 case __NR_poll:
                     retval = ExpressOS.Kernel.Net.Poll(current, ref regs, new UserPtr(arg0), arg1, arg2);
                     break;
 
+                case __NR_epoll_create:
+                    retval = ExpressOS.Kernel.EventPoll.Create(current, arg0);
+                    break;
+
+                case __NR_epoll_ctl:
+                    retval = ExpressOS.Kernel.EventPoll.Ctl(current, arg0, arg1, arg2, new UserPtr(arg3));
+                    break;
+
+                case __NR_epoll_wait:
+                    retval = ExpressOS.Kernel.EventPoll.Wait(current, ref regs, arg0, new UserPtr(arg1), arg2, arg3);
+                    break;
+
+                case __NR_recvmmsg:
+                    retval = ExpressOS.Kernel.Net.Recvmmsg(current, ref regs, arg0, new UserPtr(arg1), arg2, arg3, new UserPtr(arg4));
+                    break;
+
+                case __NR_sendmmsg:
+                    retval = ExpressOS.Kernel.Net.Sendmmsg(current, ref regs, arg0, new UserPtr(arg1), arg2, arg3);
+                    break;
+
                 case __NR_set_thread_area:
                     retval = ExpressOS.Kernel.TLS.SetThreadArea(current, new UserPtr(arg0));
                     break;
@@ -207,6 +250,7 @@ namespace ExpressOS.Kernel.Arch
 
                     //Misc.DumpStackTrace(current, new UserPtr(pt_regs->ebp));
                     //current.Parent.Space.Regions.DumpAll();
+                    current.Parent.Exit();
                     current.AsyncReturn = true;
                     break;
 
@@ -552,6 +596,8 @@ namespace ExpressOS.Kernel.Arch
         public const int __NR_timerfd = 322;
         public const int __NR_eventfd = 323;
         public const int __NR_fallocate = 324;
+        public const int __NR_recvmmsg = 337;
+        public const int __NR_sendmmsg = 345;
         #endregion
 
         public const int __NR_vbinder = 512;
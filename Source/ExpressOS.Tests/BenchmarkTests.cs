@@ -0,0 +1,296 @@
+﻿using System;
+using System.Diagnostics;
+using System.Runtime.InteropServices;
+using ExpressOS.Kernel;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+namespace ExpressOS.Tests
+{
+    /*
+     * Throughput of the code that runs on the host without the glue
+     * layer. Each benchmark checks a known answer first, runs a fixed
+     * workload, checks its result and logs "bench,<name>,<bytes>,<ms>" to
+     * the test context so that the numbers can be tracked across versions.
+     *
+     * The kernel structures that touch neither Arch.NativeMethods nor
+     * IPCStubs run as they are. AddressSpace is not among them, as its
+     * constructor maps the TimePage.
+     */
+    [TestClass]
+    public class BenchmarkTest
+    {
+        private const int PageSize = 4096;
+        private const int WorkloadPages = 1024;
+
+        public TestContext TestContext { get; set; }
+
+        [ClassInitialize]
+        public static void Initialize(TestContext context)
+        {
+            AESManaged.Initialize();
+            SHA1Managed.Initialize();
+        }
+
+        private void Report(string name, long bytes, Stopwatch watch)
+        {
+            TestContext.WriteLine("bench,{0},{1},{2}", name, bytes, watch.ElapsedMilliseconds);
+        }
+
+        private static byte[] Hex(string s)
+        {
+            var r = new byte[s.Length / 2];
+            for (var i = 0; i < r.Length; ++i)
+                r[i] = Convert.ToByte(s.Substring(2 * i, 2), 16);
+            return r;
+        }
+
+        private static ByteBufferRef Block(GCHandle page, int i)
+        {
+            var p = IntPtr.Add(page.AddrOfPinnedObject(), i * AESManaged.AES_BLOCK_SIZE);
+            return new ByteBufferRef(p, AESManaged.AES_BLOCK_SIZE);
+        }
+
+        private static byte[] Sequence(int length)
+        {
+            var r = new byte[length];
+            for (var i = 0; i < length; ++i)
+                r[i] = (byte)i;
+            return r;
+        }
+
+        [TestMethod]
+        [TestCategory("Benchmark")]
+        public void AESPageThroughput()
+        {
+            var key = Sequence(16);
+            var page = Sequence(PageSize);
+            var handle = GCHandle.Alloc(page, GCHandleType.Pinned);
+            try
+            {
+                var block = Block(handle, 0);
+
+                /* FIPS-197, appendix C.1 */
+                var plain = Hex("00112233445566778899aabbccddeeff");
+                for (var i = 0; i < plain.Length; ++i)
+                    block.Set(i, plain[i]);
+
+                var enc = new AESManaged();
+                enc.SetEncryptKey(key, 128);
+                enc.Encrypt(block, block);
+                var cipher = Hex("69c4e0d86a7b0430d8cdb78070b4c55a");
+                for (var i = 0; i < cipher.Length; ++i)
+                    Assert.AreEqual<byte>(cipher[i], block.Get(i));
+
+                var dec = new AESManaged();
+                dec.SetDecryptKey(key, 128);
+                var watch = Stopwatch.StartNew();
+                for (var n = 0; n < WorkloadPages; ++n)
+                {
+                    for (var i = 0; i < PageSize / AESManaged.AES_BLOCK_SIZE; ++i)
+                    {
+                        var b = Block(handle, i);
+                        enc.Encrypt(b, b);
+                    }
+                    for (var i = 0; i < PageSize / AESManaged.AES_BLOCK_SIZE; ++i)
+                    {
+                        var b = Block(handle, i);
+                        dec.Decrypt(b, b);
+                    }
+                }
+                watch.Stop();
+                Report("aes-page-roundtrip", (long)WorkloadPages * PageSize, watch);
+
+                /* The round trips leave the page unchanged */
+                for (var i = 0; i < plain.Length; ++i)
+                    Assert.AreEqual<byte>(cipher[i], page[i]);
+                for (var i = AESManaged.AES_BLOCK_SIZE; i < PageSize; ++i)
+                    Assert.AreEqual<byte>((byte)i, page[i]);
+            }
+            finally
+            {
+                handle.Free();
+            }
+        }
+
+        [TestMethod]
+        [TestCategory("Benchmark")]
+        public void SHA1PageThroughput()
+        {
+            /* FIPS 180-2, appendix A.1 */
+            var sha1 = new SHA1Managed();
+            sha1.Input(new byte[] { (byte)'a', (byte)'b', (byte)'c' });
+            var digest = sha1.GetResult();
+            var expected = Hex("a9993e364706816aba3e25717850c26c9cd0d89d");
+            for (var i = 0; i < expected.Length; ++i)
+                Assert.AreEqual<byte>(expected[i], digest[i]);
+
+            var page = Sequence(PageSize);
+            var watch = Stopwatch.StartNew();
+            for (var n = 0; n < WorkloadPages; ++n)
+            {
+                sha1 = new SHA1Managed();
+                sha1.Input(page);
+                digest = sha1.GetResult();
+            }
+            watch.Stop();
+            Report("sha1-page", (long)WorkloadPages * PageSize, watch);
+
+            /* SHA-1 of the bytes 0, 1, ..., 255 repeated over a page */
+            expected = Hex("e9dded8c84614e894501965af60c2525794a8c7d");
+            for (var i = 0; i < expected.Length; ++i)
+                Assert.AreEqual<byte>(expected[i], digest[i]);
+        }
+
+        [TestMethod]
+        [TestCategory("Benchmark")]
+        public void BitVectorScan()
+        {
+            const int Bits = 1 << 16;
+            const int Rounds = 64;
+            var bv = new FixedSizeBitVector(Bits);
+            for (var i = 0; i < Bits; i += 97)
+                bv.Set(i);
+
+            var watch = Stopwatch.StartNew();
+            var found = 0;
+            for (var n = 0; n < Rounds; ++n)
+            {
+                for (var b = bv.FindNextOne(-1); b != -1; b = bv.FindNextOne(b))
+                    ++found;
+            }
+            watch.Stop();
+            Report("bitvector-scan", (long)Rounds * Bits / 8, watch);
+
+            Assert.AreEqual<int>(Rounds * ((Bits + 96) / 97), found);
+        }
+
+        /*
+         * The working set of a fault storm: every page of a sparse heap is
+         * added, looked up, scanned and evicted again.
+         */
+        [TestMethod]
+        [TestCategory("Benchmark")]
+        public void TableWorkingSetFaults()
+        {
+            const int Pages = 1 << 14;
+            const int Rounds = 16;
+            const uint Base = 0x40000000;
+            var found = 0;
+
+            var watch = Stopwatch.StartNew();
+            for (var n = 0; n < Rounds; ++n)
+            {
+                var ws = new TableWorkingSet();
+                for (var i = 0; i < Pages; ++i)
+                    ws.Add(new UserPtr(Base + ((uint)i << 13)), new Pointer(((uint)i + 1) << 12));
+
+                for (var i = 0; i < Pages; ++i)
+                    Assert.AreEqual<uint>(((uint)i + 1) << 12, ws.UserToVirt(new UserPtr(Base + ((uint)i << 13))).ToUInt32());
+
+                var page = new UserPtr(Base);
+                var end = new UserPtr(Base + ((uint)Pages << 13));
+                Pointer entry;
+                while (ws.NextEntry(ref page, end, out entry))
+                {
+                    ++found;
+                    page += PageSize;
+                }
+
+                for (var i = 0; i < Pages; ++i)
+                    ws.Evict(new UserPtr(Base + ((uint)i << 13)));
+
+                Assert.AreEqual<int>(0, ws.Size);
+            }
+            watch.Stop();
+            Report("workingset-faults", (long)Rounds * Pages, watch);
+
+            Assert.AreEqual<int>(Rounds * Pages, found);
+        }
+
+        /*
+         * Timeouts are kept sorted by an insertion walk. Queue them in a
+         * scattered order and take them all.
+         */
+        [TestMethod]
+        [TestCategory("Benchmark")]
+        public void TimerQueueInsert()
+        {
+            const int Timers = 1024;
+            const int Rounds = 16;
+            var nodes = new TimerQueueNode[Timers];
+
+            var watch = Stopwatch.StartNew();
+            for (var n = 0; n < Rounds; ++n)
+            {
+                var queue = new TimerQueue();
+                for (var i = 0; i < Timers; ++i)
+                    nodes[i] = queue.EnqueueAt((ulong)(i * 7919 % Timers) + 1, null);
+
+                // The node due first follows the sentinel, which is due at 0
+                var head = nodes[0];
+                while (head.prev.clock != 0)
+                    head = head.prev;
+
+                var count = 0;
+                for (var r = head; r != null; r = r.next)
+                {
+                    Assert.AreEqual<ulong>((ulong)count + 1, r.clock);
+                    ++count;
+                }
+                Assert.AreEqual<int>(Timers, count);
+
+                for (var i = 0; i < Timers; ++i)
+                    queue.Take();
+
+                for (var i = 0; i < Timers; ++i)
+                    Assert.IsTrue(nodes[i].prev == null && nodes[i].next == null);
+            }
+            watch.Stop();
+            Report("timer-insert", (long)Rounds * Timers, watch);
+        }
+
+        private sealed class PendingEntry : GenericCompletionEntry
+        {
+            public readonly uint Handle;
+
+            public PendingEntry(uint handle)
+                : base(Kind.SleepCompletionKind, handle)
+            {
+                this.Handle = handle;
+            }
+        }
+
+        /*
+         * Completions are taken by the handle of their thread. Take them in
+         * the order they were queued, which is the worst case of the list.
+         */
+        [TestMethod]
+        [TestCategory("Benchmark")]
+        public void CompletionQueueTake()
+        {
+            const int Pending = 256;
+            const int Rounds = 64;
+            var queue = new CompletionQueue();
+            var taken = 0;
+
+            var watch = Stopwatch.StartNew();
+            for (var n = 0; n < Rounds; ++n)
+            {
+                for (var i = 0; i < Pending; ++i)
+                    queue.Enqueue(new PendingEntry((uint)(i + 1) << 12));
+
+                for (var i = 0; i < Pending; ++i)
+                {
+                    var e = (PendingEntry)queue.Take((uint)(i + 1) << 12);
+                    Assert.AreEqual<uint>((uint)(i + 1) << 12, e.Handle);
+                    ++taken;
+                }
+            }
+            watch.Stop();
+            Report("completion-take", (long)Rounds * Pending, watch);
+
+            Assert.AreEqual<int>(Rounds * Pending, taken);
+            Assert.IsTrue(queue.Take(1 << 12) == null);
+        }
+    }
+}
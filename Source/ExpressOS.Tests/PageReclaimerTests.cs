@@ -0,0 +1,57 @@
+﻿using System;
+using ExpressOS.Kernel;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+namespace ExpressOS.Tests
+{
+    [TestClass]
+    public class PageReclaimerTest
+    {
+        [TestMethod]
+        public void CleanPageDroppedTest()
+        {
+            var s = PageReclaimer.Tracked(false);
+            Assert.AreEqual<int>(PageReclaimer.SweepAged, PageReclaimer.Sweep(ref s));
+            Assert.AreEqual<int>(PageReclaimer.SweepDrop, PageReclaimer.Sweep(ref s));
+        }
+
+        [TestMethod]
+        public void DirtiedPageCompressedTest()
+        {
+            var s = PageReclaimer.Tracked(false);
+            s = PageReclaimer.Dirtied(s);
+            Assert.AreEqual<int>(PageReclaimer.SweepAged, PageReclaimer.Sweep(ref s));
+            Assert.AreEqual<int>(PageReclaimer.SweepCompress, PageReclaimer.Sweep(ref s));
+        }
+
+        [TestMethod]
+        public void DirtiedAfterAgingTest()
+        {
+            var s = PageReclaimer.Tracked(false);
+            Assert.AreEqual<int>(PageReclaimer.SweepAged, PageReclaimer.Sweep(ref s));
+            s = PageReclaimer.Dirtied(s);
+            Assert.AreEqual<int>(PageReclaimer.SweepAged, PageReclaimer.Sweep(ref s));
+            Assert.AreEqual<int>(PageReclaimer.SweepCompress, PageReclaimer.Sweep(ref s));
+        }
+
+        [TestMethod]
+        public void RejectedPageKeptUntilDirtiedTest()
+        {
+            var s = PageReclaimer.Dirtied(PageReclaimer.Tracked(false));
+            Assert.AreEqual<int>(PageReclaimer.SweepAged, PageReclaimer.Sweep(ref s));
+            Assert.AreEqual<int>(PageReclaimer.SweepCompress, PageReclaimer.Sweep(ref s));
+            s = PageReclaimer.Rejected(s);
+            Assert.AreEqual<int>(PageReclaimer.SweepKeep, PageReclaimer.Sweep(ref s));
+            Assert.AreEqual<int>(PageReclaimer.SweepKeep, PageReclaimer.Sweep(ref s));
+            s = PageReclaimer.Dirtied(s);
+            Assert.AreEqual<int>(PageReclaimer.SweepAged, PageReclaimer.Sweep(ref s));
+            Assert.AreEqual<int>(PageReclaimer.SweepCompress, PageReclaimer.Sweep(ref s));
+        }
+
+        [TestMethod]
+        public void UntrackedPageStaysUntrackedTest()
+        {
+            Assert.AreEqual<byte>(0, PageReclaimer.Dirtied(0));
+        }
+    }
+}
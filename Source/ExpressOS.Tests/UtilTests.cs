@@ -40,5 +40,18 @@ namespace ExpressOS.Tests
             b = bv.FindNextOne(b);
             Assert.AreEqual<int>(-1, b);
         }
+
+        [TestMethod]
+        public void FixBVIsSetTest()
+        {
+            var bv = new FixedSizeBitVector(32);
+            bv.Set(1);
+            bv.Set(9);
+            Assert.IsTrue(bv.IsSet(9));
+            Assert.IsFalse(bv.IsSet(8));
+            Assert.IsFalse(bv.IsSet(32));
+            bv.Clear();
+            Assert.AreEqual<int>(-1, bv.FindNextOne(-1));
+        }
     }
 }
@@ -1,10 +1,18 @@
+#include "expressos/string.h"
+
 #include <l4/re/c/log.h>
 
+#include <stdarg.h>
+#include <stddef.h>
+
 #define CON_BUF_SIZE 4096
+#define CON_FORMAT_SIZE 256
 
 static char con_buf[CON_BUF_SIZE];
 static unsigned con_cursor = 0;
 
+int vsnprintk(char *str, size_t size, const char *fmt, va_list ap);
+
 void console_flush(void)
 {
         l4re_log_printn(con_buf, con_cursor);
@@ -21,3 +29,55 @@ int console_putchar(int c)
         return c;
 }
 
+void console_write(const char *s, int len)
+{
+        while (len > 0) {
+                int n = CON_BUF_SIZE - 1 - con_cursor;
+                if (n == 0) {
+                        console_flush();
+                        continue;
+                }
+
+                if (n > len)
+                        n = len;
+
+                memcpy(con_buf + con_cursor, s, n);
+                con_cursor += n;
+                s += n;
+                len -= n;
+        }
+}
+
+static int console_vformat(const char *fmt, ...)
+{
+        char outbuf[CON_FORMAT_SIZE];
+        va_list ap;
+        int r;
+
+        va_start(ap, fmt);
+        r = vsnprintk(outbuf, sizeof(outbuf), fmt, ap);
+        va_end(ap);
+
+        /* r is the untruncated length, outbuf holds one byte less for the NUL */
+        if (r > (int)sizeof(outbuf) - 1)
+                r = sizeof(outbuf) - 1;
+
+        if (r > 0)
+                console_write(outbuf, r);
+
+        return r;
+}
+
+/*
+ * Formatted write for the managed code, which cannot call variadic
+ * functions. The conversions of fmt can consume up to four word-sized
+ * arguments.
+ */
+int console_format(const char *fmt, unsigned long a0, unsigned long a1,
+                   unsigned long a2, unsigned long a3)
+{
+        if (fmt == NULL)
+                return 0;
+
+        return console_vformat(fmt, a0, a1, a2, a3);
+}
@@ -6,6 +6,11 @@
  */
 
 #include "expressos/mm.h"
+#include "expressos/string.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 typedef unsigned long word_t;
 typedef void*         addr_t;
@@ -18,6 +23,9 @@ struct sel4_alloc {
 struct sel4_alloc * sel4_alloc_new(void * start, void * end);
 void sel4_alloc_free (struct sel4_alloc *this_, void * address, word_t size);
 void * sel4_alloc_alloc (struct sel4_alloc *this_, word_t size);
+void * sel4_alloc_alloc_raw (struct sel4_alloc *this_, word_t size);
+void sel4_clear_pages (void * address, word_t size);
+static void * alloc_chunk (struct sel4_alloc *this_, word_t size, int zero);
 
 #define CHUNK_SIZE 4096
 
@@ -50,6 +58,20 @@ void sel4_alloc_free(struct sel4_alloc *this_, void * address, word_t size)
 }
 
 void * sel4_alloc_alloc(struct sel4_alloc *this_, word_t size)
+{
+	return alloc_chunk(this_, size, 1);
+}
+
+/*
+ * Same as sel4_alloc_alloc(), but the contents of the chunk are left
+ * undefined, for callers that overwrite it anyway.
+ */
+void * sel4_alloc_alloc_raw(struct sel4_alloc *this_, word_t size)
+{
+	return alloc_chunk(this_, size, 0);
+}
+
+static void * alloc_chunk(struct sel4_alloc *this_, word_t size, int zero)
 {
 	word_t* prev;
 	word_t* curr;
@@ -76,6 +98,8 @@ void * sel4_alloc_alloc(struct sel4_alloc *this_, word_t size)
 			if (tmp)
 			{
 				*prev = (word_t) tmp;
+				if (!zero)
+					return curr;
 				for (i = 0; i < (size / sizeof(word_t)); i++)
 					curr[i] = 0;
 				return curr;
@@ -84,3 +108,27 @@ void * sel4_alloc_alloc(struct sel4_alloc *this_, word_t size)
 	}
 	return 0;
 }
+
+/*
+ * Zero whole pages with non-temporal stores, which bypass the cache.
+ * It suits pages that are cleared ahead of time, as they would
+ * otherwise evict the working set of the kernel.
+ */
+void sel4_clear_pages(void *address, word_t size)
+{
+#ifdef __SSE2__
+	__m128i zero = _mm_setzero_si128();
+	__m128i *p = (__m128i *) address;
+	__m128i *end = (__m128i *) ((char *) address + size);
+
+	for (; p < end; p += 4) {
+		_mm_stream_si128(p, zero);
+		_mm_stream_si128(p + 1, zero);
+		_mm_stream_si128(p + 2, zero);
+		_mm_stream_si128(p + 3, zero);
+	}
+	_mm_sfence();
+#else
+	memset(address, 0, size);
+#endif
+}
@@ -117,6 +117,21 @@ int l4api_delete_thread(struct l4api_thread_info thr)
         return 0;
 }
 
+/*
+ * Delete a task together with all of its mappings at once, which is much
+ * cheaper than unmapping its regions one by one before.
+ */
+int l4api_delete_task(l4_cap_idx_t task)
+{
+        if (l4api_task_delete_obj(task)) {
+                printk("Failed to delete task %lx\n", task);
+                return -1;
+        }
+
+        l4re_util_cap_free(task);
+        return 0;
+}
+
 int l4api_set_priority(l4_cap_idx_t thread, int priority)
 {
         l4_sched_param_t l4sp = l4_sched_param(priority, 0);
@@ -168,6 +183,148 @@ static size_t split_region(unsigned long *start, unsigned long end, unsigned lon
         return ret;
 }
 
+/*
+ * Gather of the flushes of one task, see MmuGather in the kernel. The
+ * ranges are merged when they touch and revoke the same rights, and are
+ * split into naturally aligned fpages only when the gather is finished,
+ * so that the fpages are as large and as few as possible.
+ */
+#define GATHER_RANGES 64
+#define GATHER_FPAGES (L4_UTCB_GENERIC_DATA_SIZE - 2)
+
+struct flush_range {
+        unsigned long start;
+        unsigned long end;
+        unsigned long rights;
+};
+
+static struct flush_range gather_ranges[GATHER_RANGES];
+static int gather_nr_ranges;
+static l4_cap_idx_t gather_task = L4_INVALID_CAP;
+
+void l4api_gather_finish(void);
+
+void l4api_gather_flush(l4_cap_idx_t task,
+                        unsigned long vaddr_start,
+                        unsigned long vaddr_end,
+                        unsigned long flush_rights)
+{
+        static const size_t PAGE_MASK = ~4095;
+        int i;
+
+        if (l4_is_invalid_cap(task))
+                return;
+
+        vaddr_start &= PAGE_MASK;
+        vaddr_end &= PAGE_MASK;
+        if (vaddr_start >= vaddr_end)
+                return;
+
+        if (gather_nr_ranges && task != gather_task)
+                l4api_gather_finish();
+
+        gather_task = task;
+        for (i = 0; i < gather_nr_ranges; ++i) {
+                struct flush_range *r = &gather_ranges[i];
+                if (r->rights == flush_rights && vaddr_start <= r->end && r->start <= vaddr_end) {
+                        if (vaddr_start < r->start)
+                                r->start = vaddr_start;
+                        if (vaddr_end > r->end)
+                                r->end = vaddr_end;
+                        return;
+                }
+        }
+
+        if (gather_nr_ranges == GATHER_RANGES) {
+                l4api_gather_finish();
+                gather_task = task;
+        }
+
+        gather_ranges[gather_nr_ranges].start = vaddr_start;
+        gather_ranges[gather_nr_ranges].end = vaddr_end;
+        gather_ranges[gather_nr_ranges].rights = flush_rights;
+        ++gather_nr_ranges;
+}
+
+void l4api_gather_finish(void)
+{
+        l4_fpage_t fpages[GATHER_FPAGES];
+        size_t num_pages = 0;
+        int i, j, n;
+
+        if (!gather_nr_ranges)
+                return;
+
+        /* Sort by start, and merge the ranges that have grown together */
+        for (i = 1; i < gather_nr_ranges; ++i) {
+                struct flush_range r = gather_ranges[i];
+                for (j = i; j > 0 && gather_ranges[j - 1].start > r.start; --j)
+                        gather_ranges[j] = gather_ranges[j - 1];
+                gather_ranges[j] = r;
+        }
+
+        for (i = 1, n = 1; i < gather_nr_ranges; ++i) {
+                struct flush_range *last = &gather_ranges[n - 1];
+                if (gather_ranges[i].rights == last->rights && gather_ranges[i].start <= last->end) {
+                        if (gather_ranges[i].end > last->end)
+                                last->end = gather_ranges[i].end;
+                } else {
+                        gather_ranges[n++] = gather_ranges[i];
+                }
+        }
+
+        for (i = 0; i < n; ++i) {
+                unsigned long start = gather_ranges[i].start;
+                while (start < gather_ranges[i].end) {
+                        num_pages += split_region(&start, gather_ranges[i].end, gather_ranges[i].rights,
+                                                  fpages + num_pages, GATHER_FPAGES - num_pages);
+                        if (num_pages == GATHER_FPAGES) {
+                                l4_task_unmap_batch(gather_task, fpages, num_pages, L4_FP_ALL_SPACES);
+                                num_pages = 0;
+                        }
+                }
+        }
+
+        if (num_pages)
+                l4_task_unmap_batch(gather_task, fpages, num_pages, L4_FP_ALL_SPACES);
+
+        gather_nr_ranges = 0;
+        gather_task = L4_INVALID_CAP;
+}
+
+/*
+ * Map size bytes at kernel_start into task at user_start ahead of the
+ * faults, see Pager.Populate() in the kernel. Each fpage is the largest
+ * one that is naturally aligned in both address spaces.
+ */
+void l4api_map_range(l4_cap_idx_t task,
+                     unsigned long kernel_start,
+                     unsigned long user_start,
+                     unsigned long size,
+                     unsigned long rights)
+{
+        unsigned long off = 0;
+
+        if (l4_is_invalid_cap(task))
+                return;
+
+        while (off < size) {
+                int p = __builtin_ffs(kernel_start + off);
+                int q = __builtin_ffs(user_start + off);
+                int r = fls(size - off);
+
+                if (p < r)
+                        r = p;
+                if (q < r)
+                        r = q;
+
+                l4_task_map(task, L4RE_THIS_TASK_CAP,
+                            l4_fpage(kernel_start + off, r - 1, rights),
+                            l4_map_control(user_start + off, 0, L4_MAP_ITEM_MAP));
+                off += 1UL << (r - 1);
+        }
+}
+
 void l4api_flush_regions(l4_cap_idx_t task,
                        unsigned long vaddr_start,
                        unsigned long vaddr_end,
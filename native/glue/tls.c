@@ -15,23 +15,33 @@ static inline void native_load_tls(l4_cap_idx_t thread_id, struct desc_struct *
 
 static int l4api_fiasco_gdt_entry_offset;
 
+/*
+ * The TLS arrays come from a slab. It starts with one static page, and
+ * grows with the pages that the kernel hands over through
+ * l4api_tls_slab_grow() once it runs out.
+ */
 static char slab_tls_array[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
 static struct desc_struct *slab_tls_head;
 
-#define TLS_SLAB_SIZE 256
+#define TLS_ARRAY_SIZE (sizeof(struct desc_struct) * GDT_ENTRY_TLS_ENTRIES)
+#define TLS_SLAB_SIZE 32
 
-static void slab_init(void)
+static void slab_add_page(char *page)
 {
-        memset(slab_tls_array, 0, sizeof(slab_tls_array));
-        slab_tls_head = (struct desc_struct *)slab_tls_array;
-
-        char *start = slab_tls_array;
-        while (start < slab_tls_array + sizeof(slab_tls_array)) {
-                *(struct desc_struct**)start = (struct desc_struct *)(start + TLS_SLAB_SIZE);
+        char *start = page;
+        while (start + TLS_SLAB_SIZE <= page + PAGE_SIZE) {
+                *(struct desc_struct **)start = slab_tls_head;
+                slab_tls_head = (struct desc_struct *)start;
                 start += TLS_SLAB_SIZE;
         }
 }
 
+static void slab_init(void)
+{
+        slab_tls_head = NULL;
+        slab_add_page(slab_tls_array);
+}
+
 static struct desc_struct *slab_tls_malloc(void)
 {
         if (!slab_tls_head)
@@ -56,10 +66,19 @@ int init_l4api_tls(void)
         return 0;
 }
 
+void l4api_tls_slab_grow(void *page)
+{
+        slab_add_page(page);
+}
+
+/*
+ * Returns NULL when the slab is exhausted.
+ */
 struct desc_struct * l4api_tls_array_alloc(void)
 {
         struct desc_struct *r = slab_tls_malloc();
-        memset(r, 0, sizeof(struct desc_struct) * GDT_ENTRY_TLS_ENTRIES);
+        if (r)
+                memset(r, 0, TLS_ARRAY_SIZE);
         return r;
 }
 
@@ -68,6 +87,23 @@ void l4api_tls_array_free(struct desc_struct *ptr)
         slab_tls_free(ptr);
 }
 
+/*
+ * Give a forked thread a copy of the TLS descriptors of its parent. The
+ * array is overwritten as a whole, so it is not cleared first. Returns
+ * NULL when the slab is exhausted.
+ */
+struct desc_struct * l4api_tls_array_clone(l4_cap_idx_t thread_id,
+                                           const struct desc_struct *src)
+{
+        struct desc_struct *dst = slab_tls_malloc();
+        if (!dst)
+                return NULL;
+
+        memcpy(dst, src, TLS_ARRAY_SIZE);
+        native_load_tls(thread_id, dst);
+        return dst;
+}
+
 int l4api_set_thread_area(l4_cap_idx_t thread_id, struct desc_struct * tls_array,
                         int idx, struct user_desc * info,
                         int can_allocate)
@@ -0,0 +1,65 @@
+#include "expressos/expressos-native.h"
+#include "expressos/trace.h"
+#include "expressos/string.h"
+
+/*
+ * The trace ring. The managed kernel runs on a single thread, which is
+ * the only writer, so no locking is needed. The oldest records are
+ * overwritten when the ring is full.
+ */
+#define TRACE_RING_SIZE 8192
+
+static struct expressos_trace_record trace_ring[TRACE_RING_SIZE];
+static unsigned int trace_head;
+static unsigned int trace_tail;
+static unsigned int trace_lost;
+
+l4_cpu_time_t l4api_get_system_clock(void);
+
+void trace_event(int event, unsigned int thread, unsigned int a0,
+                 unsigned int a1, unsigned int a2, unsigned int a3)
+{
+        struct expressos_trace_record *r = &trace_ring[trace_head % TRACE_RING_SIZE];
+        r->timestamp = l4api_get_system_clock();
+        r->event = event;
+        r->reserved = 0;
+        r->thread = thread;
+        r->args[0] = a0;
+        r->args[1] = a1;
+        r->args[2] = a2;
+        r->args[3] = a3;
+        ++trace_head;
+}
+
+/*
+ * Copy the oldest records into the synchronous IPC buffer, and publish
+ * the number of records in the control block. Linux repeats the command
+ * until no record is left. Returns the number of records drained.
+ */
+int trace_drain(void)
+{
+        struct expressos_trace_header *hdr = (struct expressos_trace_header *)g_expressos_ipc_shm_buf;
+        struct expressos_trace_record *dst = (struct expressos_trace_record *)(hdr + 1);
+        unsigned int max = (EXPRESSOS_IPC_SYNC_CALL_BUF_SIZE - sizeof(*hdr)) / sizeof(*dst);
+        unsigned int count = 0;
+
+        if (trace_head - trace_tail > TRACE_RING_SIZE) {
+                trace_lost += trace_head - trace_tail - TRACE_RING_SIZE;
+                trace_tail = trace_head - TRACE_RING_SIZE;
+        }
+
+        while (trace_tail != trace_head && count < max) {
+                memcpy(&dst[count], &trace_ring[trace_tail % TRACE_RING_SIZE], sizeof(*dst));
+                ++trace_tail;
+                ++count;
+        }
+
+        hdr->magic = EXPRESSOS_TRACE_MAGIC;
+        hdr->record_size = sizeof(*dst);
+        hdr->count = count;
+        hdr->lost = trace_lost;
+        trace_lost = 0;
+
+        g_expressos_control_block->trace_records = count;
+        return count;
+}
@@ -0,0 +1,175 @@
+#include "expressos/expressos-native.h"
+#include "expressos/string.h"
+
+/*
+ * Codec of the compressed page store of the kernel. It is an LZ77
+ * variant in the block format of LZ4: a sequence is a token, whose high
+ * nibble is the number of literals and whose low nibble is the match
+ * length minus 4, the literals, and a 16-bit little-endian offset of the
+ * match. Lengths of 15 continue in the following bytes. The last
+ * sequence has literals only.
+ *
+ * The input is always a single page, so offsets never overflow.
+ */
+
+int zpage_compress(const unsigned char *src, unsigned char *dst, int dst_len);
+int zpage_decompress(const unsigned char *src, int src_len, unsigned char *dst);
+
+#define MIN_MATCH 4
+#define HASH_LOG 10
+
+/* The kernel is single threaded */
+static unsigned short hash_table[1 << HASH_LOG];
+
+static inline unsigned read32(const unsigned char *p)
+{
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+static inline unsigned hash(unsigned v)
+{
+        return (v * 2654435761u) >> (32 - HASH_LOG);
+}
+
+static int put_length(unsigned char *dst, int op, int dst_len, int len)
+{
+        while (len >= 255) {
+                if (op >= dst_len)
+                        return -1;
+                dst[op++] = 255;
+                len -= 255;
+        }
+        if (op >= dst_len)
+                return -1;
+        dst[op++] = len;
+        return op;
+}
+
+static int put_sequence(unsigned char *dst, int op, int dst_len,
+                        const unsigned char *lit, int lit_len, int offset, int match_len)
+{
+        int token = op++;
+        if (token >= dst_len)
+                return -1;
+
+        dst[token] = (lit_len < 15 ? lit_len : 15) << 4;
+        if (lit_len >= 15 && (op = put_length(dst, op, dst_len, lit_len - 15)) < 0)
+                return -1;
+
+        if (op + lit_len > dst_len)
+                return -1;
+        memcpy(dst + op, lit, lit_len);
+        op += lit_len;
+
+        if (!match_len)
+                return op;
+
+        if (op + 2 > dst_len)
+                return -1;
+        dst[op++] = offset & 0xff;
+        dst[op++] = offset >> 8;
+
+        match_len -= MIN_MATCH;
+        dst[token] |= match_len < 15 ? match_len : 15;
+        if (match_len >= 15 && (op = put_length(dst, op, dst_len, match_len - 15)) < 0)
+                return -1;
+
+        return op;
+}
+
+/*
+ * Compress a page into dst. Returns the compressed size, or -1 if it
+ * does not fit into dst_len bytes.
+ */
+int zpage_compress(const unsigned char *src, unsigned char *dst, int dst_len)
+{
+        int ip = 0, anchor = 0, op = 0;
+
+        memset(hash_table, 0, sizeof(hash_table));
+
+        while (ip + MIN_MATCH <= PAGE_SIZE) {
+                unsigned seq = read32(src + ip);
+                unsigned h = hash(seq);
+                int ref = hash_table[h] - 1;
+                int len;
+
+                hash_table[h] = ip + 1;
+                if (ref < 0 || read32(src + ref) != seq) {
+                        ++ip;
+                        continue;
+                }
+
+                len = MIN_MATCH;
+                while (ip + len < PAGE_SIZE && src[ref + len] == src[ip + len])
+                        ++len;
+
+                op = put_sequence(dst, op, dst_len, src + anchor, ip - anchor, ip - ref, len);
+                if (op < 0)
+                        return -1;
+
+                ip += len;
+                anchor = ip;
+        }
+
+        return put_sequence(dst, op, dst_len, src + anchor, PAGE_SIZE - anchor, 0, 0);
+}
+
+static int get_length(const unsigned char *src, int *sp, int src_len, int len)
+{
+        unsigned char b;
+        if (len != 15)
+                return len;
+
+        do {
+                if (*sp >= src_len)
+                        return -1;
+                b = src[(*sp)++];
+                len += b;
+        } while (b == 255);
+
+        return len;
+}
+
+/*
+ * Decompress src into a page. Returns PAGE_SIZE, or -1 if the data is
+ * corrupted.
+ */
+int zpage_decompress(const unsigned char *src, int src_len, unsigned char *dst)
+{
+        int sp = 0, op = 0;
+
+        while (sp < src_len) {
+                int token = src[sp++];
+                int lit_len = get_length(src, &sp, src_len, token >> 4);
+                int offset, match_len;
+
+                if (lit_len < 0 || sp + lit_len > src_len || op + lit_len > PAGE_SIZE)
+                        return -1;
+
+                memcpy(dst + op, src + sp, lit_len);
+                sp += lit_len;
+                op += lit_len;
+
+                if (sp == src_len)
+                        break;
+
+                if (sp + 2 > src_len)
+                        return -1;
+                offset = src[sp] | (src[sp + 1] << 8);
+                sp += 2;
+
+                match_len = get_length(src, &sp, src_len, token & 15);
+                if (match_len < 0)
+                        return -1;
+                match_len += MIN_MATCH;
+
+                if (offset == 0 || offset > op || op + match_len > PAGE_SIZE)
+                        return -1;
+
+                /* The match may overlap the output, copy byte by byte */
+                for (; match_len > 0; --match_len, ++op)
+                        dst[op] = dst[op - offset];
+        }
+
+        return op == PAGE_SIZE ? op : -1;
+}
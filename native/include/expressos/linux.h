@@ -28,6 +28,8 @@
  */
 struct expressos_control_block {
         unsigned int pending_reply_count;
+        /* Number of trace records drained by the last EXPRESSOS_CMD_DRAIN_TRACE */
+        unsigned int trace_records;
 };
 
 /* Keep in sync with the definition of managed environment */
@@ -48,6 +50,10 @@ enum {
         EXPRESSOS_CMD_ENABLE_PROFILER,
         EXPRESSOS_CMD_DISABLE_PROFILER,
         EXPRESSOS_CMD_FLUSH_CONSOLE,
+        EXPRESSOS_CMD_ENABLE_TRACE,
+        EXPRESSOS_CMD_DISABLE_TRACE,
+        EXPRESSOS_CMD_DRAIN_TRACE,
+        EXPRESSOS_CMD_REPLAY_TRACE,
 };
 
 enum {
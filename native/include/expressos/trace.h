@@ -0,0 +1,48 @@
+#ifndef EXPRESSOS_TRACE_H_
+#define EXPRESSOS_TRACE_H_
+
+#include <l4/sys/types.h>
+
+/*
+ * Binary trace of kernel events. Keep the event ids in sync with
+ * Arch.Trace.Event of the managed environment.
+ */
+enum {
+        EXPRESSOS_TRACE_SYSCALL_ENTER = 1,
+        EXPRESSOS_TRACE_SYSCALL_EXIT,
+        EXPRESSOS_TRACE_PAGE_FAULT,
+        EXPRESSOS_TRACE_COMPLETION,
+        EXPRESSOS_TRACE_IPC_SEND,
+        EXPRESSOS_TRACE_IPC_CALL,
+        EXPRESSOS_TRACE_TIMER_EXPIRE,
+        EXPRESSOS_TRACE_SYSCALL_ARGS,
+        EXPRESSOS_TRACE_THREAD_CREATE,
+        EXPRESSOS_TRACE_MAP,
+};
+
+struct expressos_trace_record {
+        l4_cpu_time_t timestamp;
+        unsigned short event;
+        unsigned short reserved;
+        unsigned int thread;
+        unsigned int args[4];
+};
+
+/*
+ * A drained batch in the synchronous IPC buffer is a header followed
+ * by the records, oldest first.
+ */
+#define EXPRESSOS_TRACE_MAGIC 0x45435254
+
+struct expressos_trace_header {
+        unsigned int magic;
+        unsigned int record_size;
+        unsigned int count;
+        unsigned int lost;
+};
+
+void trace_event(int event, unsigned int thread, unsigned int a0,
+                 unsigned int a1, unsigned int a2, unsigned int a3);
+int trace_drain(void);
+
+#endif